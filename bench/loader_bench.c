@@ -0,0 +1,136 @@
+#include <SDL2/SDL.h>
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+
+// Logging
+#include <log.h>
+
+#define SYNTHETIC_SIZE 2048
+#define SYNTHETIC_FILENAME "synthetic_2048.tmj"
+
+/**
+ * Loader benchmark
+ *
+ * Compares the streaming map loader against building a cJSON tree and copying
+ * the tile data out of it, which is how maps were loaded before.
+ *
+ * Usage: loader_bench [assets directory]
+ */
+
+// Reference loader, builds the full cJSON tree and walks it like map_load used to
+static size_t bench_cjson_load(const char * filename) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        log_error("Failed to open map file %s", filename);
+        exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *string = malloc(fsize + 1);
+    fread(string, fsize, 1, fp);
+    fclose(fp);
+    string[fsize] = 0;
+
+    size_t tiles = 0;
+    cJSON *map_json = cJSON_Parse(string);
+    const cJSON *j_layers = cJSON_GetObjectItemCaseSensitive(map_json, "layers");
+    const cJSON *j_layer;
+    cJSON_ArrayForEach(j_layer, j_layers) {
+        const cJSON *j_width = cJSON_GetObjectItemCaseSensitive(j_layer, "width");
+        const cJSON *j_height = cJSON_GetObjectItemCaseSensitive(j_layer, "height");
+        const cJSON *j_data = cJSON_GetObjectItemCaseSensitive(j_layer, "data");
+        if (!cJSON_IsArray(j_data) || !cJSON_IsNumber(j_width) || !cJSON_IsNumber(j_height)) {
+            continue;
+        }
+        uint32_t *data = calloc(j_width->valueint * j_height->valueint, sizeof(uint32_t));
+        int data_index = 0;
+        const cJSON *j_gid;
+        cJSON_ArrayForEach(j_gid, j_data) {
+            data[data_index++] = j_gid->valueint;
+        }
+        tiles += data_index;
+        free(data);
+    }
+    cJSON_Delete(map_json);
+    free(string);
+    return tiles;
+}
+
+static size_t bench_stream_load(const char * filename) {
+    Map map = {0};
+    map_load_tmj(&map, filename);
+    size_t tiles = 0;
+    for (uint32_t i = 0; i < map.layer_count; i++) {
+        tiles += (size_t)map.layers[i].width * map.layers[i].height;
+    }
+    map_free(&map);
+    return tiles;
+}
+
+static void bench_write_synthetic_map(const char * filename) {
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL) {
+        log_error("Failed to write %s", filename);
+        exit(1);
+    }
+    fprintf(fp, "{ \"compressionlevel\":-1,\n \"height\":%d,\n \"infinite\":false,\n \"layers\":[\n", SYNTHETIC_SIZE);
+    for (int layer = 0; layer < 2; layer++) {
+        fprintf(fp, "        {\n         \"data\":[");
+        uint32_t seed = 12345 + layer;
+        for (int i = 0; i < SYNTHETIC_SIZE * SYNTHETIC_SIZE; i++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t gid = layer == 0 ? 1 + (seed >> 16) % 104 : ((seed >> 16) % 8 == 0 ? 1 + (seed >> 8) % 104 : 0);
+            // Sprinkle in flipped tiles
+            if ((seed >> 4) % 16 == 0) {
+                gid |= FLIPPED_HORIZONTALLY_FLAG;
+            }
+            fprintf(fp, i == 0 ? "%u" : (i % SYNTHETIC_SIZE == 0 ? ",\n            %u" : ", %u"), gid);
+        }
+        fprintf(fp, "],\n         \"height\":%d,\n         \"id\":%d,\n         \"name\":\"Layer %d\",\n         \"opacity\":1,\n         \"type\":\"tilelayer\",\n         \"visible\":true,\n         \"width\":%d,\n         \"x\":0,\n         \"y\":0\n        }%s\n",
+            SYNTHETIC_SIZE, layer + 1, layer + 1, SYNTHETIC_SIZE, layer == 0 ? "," : "");
+    }
+    fprintf(fp, "],\n \"nextlayerid\":3,\n \"nextobjectid\":1,\n \"orientation\":\"orthogonal\",\n \"renderorder\":\"right-down\",\n \"tileheight\":32,\n \"tilewidth\":32,\n \"type\":\"map\",\n \"width\":%d\n}\n", SYNTHETIC_SIZE);
+    fclose(fp);
+}
+
+static double bench_run(size_t (*load)(const char *), const char * filename, int iterations, size_t * tiles) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; i++) {
+        *tiles = load(filename);
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+    return (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency() / iterations;
+}
+
+static void bench_map(const char * label, const char * filename, int iterations) {
+    size_t cjson_tiles = 0;
+    size_t stream_tiles = 0;
+    double cjson_ms = bench_run(bench_cjson_load, filename, iterations, &cjson_tiles);
+    double stream_ms = bench_run(bench_stream_load, filename, iterations, &stream_tiles);
+    printf("%-20s %10zu %12.3f %12.3f %8.2fx\n", label, stream_tiles, cjson_ms, stream_ms, cjson_ms / stream_ms);
+    if (cjson_tiles != stream_tiles) {
+        log_error("Tile count mismatch for %s: %zu != %zu", label, cjson_tiles, stream_tiles);
+        exit(1);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char * assets = argc > 1 ? argv[1] : "../assets";
+    char filename[MAX_FILENAME_LENGTH];
+    log_set_quiet(true);
+
+    printf("%-20s %10s %12s %12s %9s\n", "map", "tiles", "cjson ms", "stream ms", "speedup");
+    snprintf(filename, sizeof(filename), "%s/home.tmj", assets);
+    bench_map("home.tmj", filename, 200);
+    snprintf(filename, sizeof(filename), "%s/house.tmj", assets);
+    bench_map("house.tmj", filename, 200);
+
+    bench_write_synthetic_map(SYNTHETIC_FILENAME);
+    bench_map("synthetic 2048x2048", SYNTHETIC_FILENAME, 3);
+    remove(SYNTHETIC_FILENAME);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "assets.h"
+#include "atlas.h"
+#include "draw.h"
+#include "map.h"
+#include "render_cache.h"
+#include "render_queue.h"
+#include "tileset_cache.h"
+
+// Logging
+#include <log.h>
+
+#define BENCH_FRAMES 600
+#define BENCH_CAMERA_WIDTH 1280
+#define BENCH_CAMERA_HEIGHT 720
+
+/**
+ * Render benchmark
+ *
+ * Pans a 1280x720 camera over home.tmj, once drawing every tile and once through
+ * the render cache, and prints the draw calls per frame. Rendering happens with
+ * the software renderer so no window is needed. Like the game it needs
+ * assets.json in the working directory to find the tileset images.
+ *
+ * Usage: render_bench [assets directory]
+ */
+
+static void bench_draw(const char * label, App * app, Map * map, bool cached) {
+    Camera * camera = app->camera;
+    int range_x = SDL_max(map->width * map->tilewidth - camera->width, 1);
+    int range_y = SDL_max(map->height * map->tileheight - camera->height, 1);
+    render_cache_set_enabled(cached);
+    draw_take_call_count();
+    long calls = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        // Pan back and forth so chunks move in and out of view
+        int step = frame * 4;
+        camera->x = abs(step % (range_x * 2) - range_x);
+        camera->y = abs(step / 2 % (range_y * 2) - range_y);
+        tileset_cache_update_animations(frame * 16);
+        draw_prepare_scene(app, camera->target);
+        map_draw(app, map);
+        render_queue_flush(app->renderer);
+        calls += draw_take_call_count();
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+    double ms = (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+    printf("%-20s %16.1f %12.3f\n", label, (double)calls / BENCH_FRAMES, ms);
+}
+
+int main(int argc, char* argv[]) {
+    const char * assets = argc > 1 ? argv[1] : "../assets";
+    char filename[MAX_FILENAME_LENGTH];
+    log_set_quiet(true);
+
+    if (SDL_Init(0) < 0 || IMG_Init(IMG_INIT_PNG) == 0) {
+        log_error("Couldn't initialize SDL: %s", SDL_GetError());
+        return 1;
+    }
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, BENCH_CAMERA_WIDTH + CAMERA_BORDER * 2, BENCH_CAMERA_HEIGHT + CAMERA_BORDER * 2, 32, SDL_PIXELFORMAT_RGBA32);
+    App app = {0};
+    app.renderer = SDL_CreateSoftwareRenderer(surface);
+    if (app.renderer == NULL) {
+        log_error("Couldn't create renderer: %s", SDL_GetError());
+        return 1;
+    }
+    if (asset_init() != 0) {
+        return 1;
+    }
+    tileset_cache_init(&app);
+    Camera camera = make_camera(&app, BENCH_CAMERA_WIDTH, BENCH_CAMERA_HEIGHT);
+    app.camera = &camera;
+
+    Map map = {0};
+    snprintf(filename, sizeof(filename), "%s/home.tmj", assets);
+    map_init(&map, filename);
+
+    printf("%-20s %16s %12s\n", "home.tmj", "draw calls/frame", "ms/frame");
+    bench_draw("every tile", &app, &map, false);
+    bench_draw("render cache", &app, &map, true);
+
+    map_free(&map);
+    SDL_DestroyTexture(camera.target);
+    tileset_cache_quit();
+    atlas_quit();
+    render_queue_free();
+    asset_free();
+    SDL_DestroyRenderer(app.renderer);
+    SDL_FreeSurface(surface);
+    IMG_Quit();
+    SDL_Quit();
+    return 0;
+}
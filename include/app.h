@@ -2,6 +2,7 @@
 #define APP_H
 
 #include <SDL2/SDL.h>
+#include <stdbool.h>
 #include "defs.h"
 
 typedef struct
@@ -12,10 +13,12 @@ typedef struct
     int width;
     int height;
 
-    int target_width;
+    int target_width; // World pixels the target holds
     int target_height;
+    float scale; // Target pixels per world pixel
 
     float x, y;
+    float previous_x, previous_y; // Position at the previous simulation tick
 } Camera;
 typedef struct
 {
@@ -28,6 +31,9 @@ typedef struct
     int key_pressed;
     int num_keys_pressed;
     const char *assets_path;
+    uint64_t ticks; // Simulation clock in milliseconds, advanced by every simulation tick
+    uint32_t frame_ticks; // Milliseconds since the previous simulation tick
+    bool quit; // The window was closed, the main loop ends after the frame
 } App;
 
 #endif
\ No newline at end of file
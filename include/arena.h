@@ -0,0 +1,31 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Region allocator
+ *
+ * Hands out zeroed memory from large blocks. Allocations are never freed one
+ * by one, everything an arena owns goes at once with arena_free(). An arena
+ * holds no pointers into itself, so structs embedding one can be moved by
+ * value.
+ */
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena
+{
+    ArenaBlock *blocks; // Block allocations are made from, followed by the full ones
+    size_t size; // Bytes of all blocks
+} Arena;
+
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *arena, const char *string);
+void arena_free(Arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,53 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SDL2/SDL.h>
+
+/**
+ * Runtime texture atlas
+ *
+ * Tileset images are packed into a few large page textures with a skyline
+ * packer, so map tiles and sprites of different tilesets share a texture and
+ * the render queue can draw them in one batch. Every image is surrounded by
+ * ATLAS_PADDING transparent pixels so neighbors never bleed into each other.
+ * The space of a released image is reused for later images that fit in it, a
+ * page is destroyed when its last image is released. Images larger than a
+ * page get a page of their own.
+ *
+ *   SDL_Rect rect;
+ *   SDL_Texture * texture = atlas_add(renderer, surface, &rect);
+ *   ...
+ *   atlas_release(texture, &rect);
+ */
+
+#define ATLAS_PAGE_SIZE 2048
+#define ATLAS_PADDING 1
+
+typedef struct AtlasSkyline
+{
+    int x;
+    int y; // Top of the free space above the segment
+    int width;
+} AtlasSkyline;
+
+typedef struct AtlasPage
+{
+    SDL_Texture *texture;
+    int width;
+    int height;
+    AtlasSkyline *skyline; // Left to right, covers the whole width
+    int skyline_count;
+    int skyline_capacity;
+    SDL_Rect *free_rects; // Space of released images below the skyline
+    int free_count;
+    int free_capacity;
+    int images; // Images packed and not released yet
+} AtlasPage;
+
+bool atlas_page_pack(AtlasPage *page, int width, int height, SDL_Rect *rect);
+void atlas_page_free(AtlasPage *page, const SDL_Rect *rect);
+SDL_Texture *atlas_add(SDL_Renderer *renderer, SDL_Surface *surface, SDL_Rect *rect);
+void atlas_release(SDL_Texture *texture, const SDL_Rect *rect);
+void atlas_quit(void);
+
+#endif // ATLAS_H
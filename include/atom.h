@@ -0,0 +1,45 @@
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <stdint.h>
+
+/**
+ * String interning
+ *
+ * Names, types and classes from map and tileset files are interned into atoms
+ * when they are loaded, so they are compared as integers and every distinct
+ * string is stored once. Atoms stay valid until atom_quit(). Interning is safe
+ * from the loader thread.
+ */
+
+typedef uint32_t Atom;
+
+// Strings the engine looks for, they always have these atoms
+enum
+{
+    ATOM_NONE, // NULL or a missing string
+    ATOM_TILELAYER,
+    ATOM_OBJECTGROUP,
+    ATOM_IMAGELAYER,
+    ATOM_GROUP,
+    ATOM_STRING,
+    ATOM_INT,
+    ATOM_FLOAT,
+    ATOM_BOOL,
+    ATOM_COLOR,
+    ATOM_FILE,
+    ATOM_OBJECT,
+    ATOM_CLASS,
+    ATOM_SOLID,
+    ATOM_WARP,
+    ATOM_COLLISION_BOX,
+    ATOM_WATER,
+    ATOM_TRIGGER,
+    ATOM_BUILTIN_COUNT
+};
+
+Atom atom_intern(const char *string);
+const char *atom_name(Atom atom);
+void atom_quit(void);
+
+#endif // ATOM_H
@@ -0,0 +1,13 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Upper bound of the decoded size of length base64 characters
+#define BASE64_DECODED_SIZE(length) (((length) + 3) / 4 * 3)
+
+bool base64_decode(const char *in, size_t length, uint8_t *out, size_t capacity, size_t *written);
+
+#endif // BASE64_H
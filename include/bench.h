@@ -0,0 +1,37 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include "app.h"
+
+/**
+ * Headless benchmark mode
+ *
+ * `zuul --bench` runs on SDL's dummy video driver with the software renderer
+ * and without a frame cap, so it works on machines without a display or GPU.
+ * The player walks a scripted path over the start map for a fixed number of
+ * frames, then frames per second, frame time percentiles and the time spent
+ * in every profile stage of the frame are written as JSON.
+ *
+ *   zuul --bench [--map home.tmj] [--frames 1000] [--path R180,D120,L180,U120] [--output bench.json] [--profile frames.csv] [--resolution dynamic]
+ *
+ * The path is a comma separated list of a direction (U, D, L, R or S to stand
+ * still) and the number of frames to hold it, it repeats until the run ends.
+ * Every frame runs exactly one simulation tick on the main thread instead of
+ * the simulation thread and the resolution is fixed unless --resolution
+ * dynamic is given, so runs are reproducible. The JSON holds the average
+ * resolution scale of the frames.
+ */
+
+#define BENCH_DEFAULT_FRAMES 1000
+#define BENCH_DEFAULT_MAP "home.tmj"
+#define BENCH_DEFAULT_PATH "R180,D120,L180,U120"
+
+bool bench_init(int argc, char *argv[]);
+char *bench_map(void);
+bool bench_frame_begin(App *app);
+void bench_frame_end(void);
+void bench_write(void);
+void bench_quit(void);
+
+#endif // BENCH_H
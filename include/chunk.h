@@ -0,0 +1,27 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdint.h>
+#include "app.h"
+#include "arena.h"
+#include "map.h"
+
+/**
+ * Chunk streaming for infinite maps
+ *
+ * Every chunk keeps its tile data compressed in memory. Only the chunks within
+ * map->chunk_radius chunks of the camera view are decoded, chunks that leave
+ * that area are evicted again. Chunks are looked up by their position on the
+ * chunk grid through the layer chunk table.
+ */
+
+void chunk_pack(Arena *arena, Layer *layer, Chunk *chunk, uint32_t *gids);
+void chunk_table_build(Layer *layer);
+Chunk *chunk_find(Layer *layer, int chunk_col, int chunk_row);
+uint32_t *chunk_data(Layer *layer, Chunk *chunk);
+uint32_t chunk_get_tile_id(Layer *layer, int col, int row);
+void chunk_stream(Map *map, Camera *camera);
+void chunk_free(Layer *layer);
+int chunk_floor_div(int value, int size);
+
+#endif // CHUNK_H
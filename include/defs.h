@@ -4,8 +4,22 @@
 #define SPRITE_WIDTH 128
 #define SPRITE_HEIGHT 128
 
-#define PLAYER_SPEED 2
+#define PLAYER_SPEED 2 // Pixels per simulation tick
+
+#define SIMULATION_RATE 60 // Simulation ticks per second
+#define SIMULATION_MAX_STEPS 5 // Ticks a single frame may catch up on, the game slows down below that
 
 #define MAX_FILENAME_LENGTH 256
 
+#define MAP_CHUNK_RADIUS 1
+
+#define WORLD_LOAD_DISTANCE 640
+#define WORLD_MEMORY_BUDGET (64 * 1024 * 1024)
+
+#define MAP_CACHE_BUDGET (32 * 1024 * 1024)
+
+#define RENDER_CACHE_CHUNK_SIZE 512
+
+#define IMAGE_CACHE_BUDGET (16 * 1024 * 1024)
+
 #define MAX_KEYBOARD_KEYS 350
\ No newline at end of file
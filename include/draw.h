@@ -8,6 +8,14 @@
 
 Camera make_camera(App *app, int width, int height);
 void draw_prepare_scene(App *app, SDL_Texture *target);
+void draw_prepare_camera(App *app, Camera *camera);
 void draw_camera_to_screen(App *app, Camera *camera);
-void camera_update(Camera * camera, struct Entity * player, int map_width, int map_height);
+void camera_update(Camera * camera, struct Entity * player, SDL_Rect * bounds);
+void camera_save_state(Camera *camera);
+void camera_interpolate(Camera *view, const Camera *camera, float alpha);
+void draw_texture(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect *dest, SDL_RendererFlip flip);
+void draw_geometry(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Vertex *vertices, int vertex_count, const int *indices, int index_count);
+int draw_take_call_count(void);
+void draw_mark_dirty(void);
+bool draw_take_dirty(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app.h"
+
+/**
+ * Streamed images of image collection tilesets
+ *
+ * Every tile of an image collection tileset has an image file of its own.
+ * Nothing is loaded with the tileset: the first time a tile is drawn its image
+ * is decoded on a worker thread and the tile draws a placeholder until
+ * image_cache_update() turns it into a texture on the render thread. Textures
+ * are kept within a byte budget, the least recently drawn ones are destroyed
+ * first and streamed in again when they are drawn again. Only frames that
+ * redraw the scene count, images are never evicted while the camera target
+ * still shows them. Without image_cache_init(), as in tools and tests,
+ * streamed tiles are not drawn.
+ *
+ *   image_cache_init(app, IMAGE_CACHE_BUDGET);
+ *   while (running) {
+ *       image_cache_update(app);
+ *       if (redraw) {
+ *           image_cache_redraw();
+ *           SDL_Texture * texture = image_cache_texture(image, &src);
+ *           ...
+ *       }
+ *   }
+ *   image_cache_quit();
+ */
+
+typedef struct TileImage
+{
+    char *path; // Image file, owned by the tileset
+    int width;
+    int height;
+    SDL_Texture *texture; // NULL while the image is not resident
+    uint64_t drawn; // Frame the texture was last drawn on
+    bool failed; // The image could not be loaded, it is not requested again
+    struct ImageJob *job; // Pending decode
+    struct TileImage *newer; // Resident images, most recently drawn first
+    struct TileImage *older;
+} TileImage;
+
+void image_cache_init(App *app, size_t budget);
+void image_cache_quit(void);
+void image_cache_update(App *app);
+void image_cache_redraw(void);
+SDL_Texture *image_cache_texture(TileImage *image, SDL_Rect *src);
+void image_cache_forget(TileImage *image);
+
+#endif // IMAGE_CACHE_H
@@ -3,6 +3,6 @@
 
 #include "structs.h"
 
-void init_sdl(App *app);
+void init_sdl(App *app, bool headless);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "atom.h"
+
+/**
+ * Single pass streaming JSON reader
+ *
+ * Reads JSON in place from a mutable buffer without building a tree. Strings
+ * are unescaped and NUL-terminated inside the buffer, so returned strings stay
+ * valid as long as the buffer does. Values the caller is not interested in are
+ * skipped with json_skip().
+ *
+ * The buffer must be followed by JSON_PADDING zero bytes, json_read_file()
+ * takes care of that.
+ *
+ * Copies and arrays the reader allocates come from reader.arena when it is
+ * set and from the heap otherwise.
+ *
+ *   JsonReader reader;
+ *   json_reader_init(&reader, buffer, size);
+ *   const char * key;
+ *   json_object_begin(&reader);
+ *   while (json_object_next(&reader, &key)) {
+ *       if (strcmp(key, "width") == 0) {
+ *           json_read_int(&reader, &width);
+ *       } else {
+ *           json_skip(&reader);
+ *       }
+ *   }
+ *   if (reader.error) ...
+ */
+
+#define JSON_PADDING 32
+
+typedef enum JsonType
+{
+    JSON_TYPE_NONE,
+    JSON_TYPE_OBJECT,
+    JSON_TYPE_ARRAY,
+    JSON_TYPE_STRING,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NULL
+} JsonType;
+
+typedef struct JsonReader
+{
+    char *cursor;
+    char *end;
+    bool error;
+    Arena *arena; // Owner of copied strings and arrays, NULL for the heap
+} JsonReader;
+
+char *json_read_file(const char *filename, size_t *size);
+void json_reader_init(JsonReader *reader, char *buffer, size_t size);
+JsonType json_peek(JsonReader *reader);
+bool json_object_begin(JsonReader *reader);
+bool json_object_next(JsonReader *reader, const char **key);
+bool json_array_begin(JsonReader *reader);
+bool json_array_next(JsonReader *reader);
+bool json_read_string(JsonReader *reader, char **value);
+bool json_read_string_copy(JsonReader *reader, char **value);
+bool json_read_atom(JsonReader *reader, Atom *value);
+bool json_read_number(JsonReader *reader, double *value);
+bool json_read_int(JsonReader *reader, int *value);
+bool json_read_bool(JsonReader *reader, bool *value);
+size_t json_read_uint32_array(JsonReader *reader, uint32_t **values, size_t *capacity);
+bool json_skip(JsonReader *reader);
+void *json_array_push(Arena *arena, void **array, size_t *count, size_t *capacity, size_t element_size);
+
+#endif // JSON_H
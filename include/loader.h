@@ -0,0 +1,39 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <SDL2/SDL.h>
+#include "map.h"
+
+/**
+ * Background map loader
+ *
+ * Maps are loaded on a single worker thread in request order. Map loading does
+ * not touch the renderer, the caller sets the tileset once it takes the map.
+ * Maps that are no longer needed can be freed on the worker with loader_free().
+ *
+ *   LoaderJob * job = loader_request(path);
+ *   ...
+ *   if (loader_done(job)) {
+ *       loader_take(job, &map);
+ *   }
+ */
+
+typedef struct LoaderJob
+{
+    char filename[MAX_FILENAME_LENGTH];
+    Map map;
+    bool done;
+    bool cancelled;
+    bool release; // Free the map instead of loading it
+    struct LoaderJob *next;
+} LoaderJob;
+
+void loader_init(void);
+void loader_quit(void);
+LoaderJob *loader_request(const char *filename);
+bool loader_done(LoaderJob *job);
+void loader_take(LoaderJob *job, Map *map);
+void loader_cancel(LoaderJob *job);
+void loader_free(Map *map);
+
+#endif // LOADER_H
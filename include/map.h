@@ -2,12 +2,30 @@
 #define MAP_H
 
 #include <stdint.h>
+#include "arena.h"
 #include "structs.h"
 #include "tileset.h"
 
+typedef struct MapTileset
+{
+    uint32_t first_gid;
+    char *source; // Tileset file, relative to the map
+    Tileset *tileset; // Shared tileset, NULL until map_attach_tilesets()
+} MapTileset;
+
+// Collision channels of the map cells, a cell takes them from its topmost tile that has tileset data
+typedef enum MapCollision
+{
+    MAP_COLLISION_SOLID, // Tiles with a solid property
+    MAP_COLLISION_WATER, // Tiles with a water property
+    MAP_COLLISION_TRIGGER, // Tiles with a trigger property
+    MAP_COLLISION_COUNT
+} MapCollision;
+
+#define MAP_COLLISION_BIT(channel) (1u << (channel))
+
 typedef struct Map
 {
-    Tileset *tileset;
     int width;
     int height;
     char *backgroundcolor; // Hex-formatted color (#RRGGBB or #AARRGGBB) (optional)
@@ -28,19 +46,44 @@ typedef struct Map
     char *staggerindex; // odd or even (staggered / hexagonal maps only)
     char *tiledversion; // The Tiled version used to save the file
     int tileheight; // Map grid height
-    Tileset *tilesets; // Array of Tilesets
+    MapTileset *tilesets; // Array of MapTilesets, sorted by first_gid
+    uint32_t tileset_count;
+    uint16_t *gid_tilesets; // Index into tilesets for every gid, MAP_NO_TILESET for gids without one
+    uint32_t gid_count;
+    uint64_t *collision; // Bit per cell for every MapCollision channel, channel by channel with every row starting at a new word
+    uint32_t collision_words; // Words per row
+    SDL_Point tile_overhang; // Cells image collection tiles reach right of and above their cell
+    SDL_Rect collision_area; // Cells the collision grid covers, reaches left and above the map for chunks at negative positions
     int tilewidth; // Map grid width
     char *type; // map (since 1.0)
     char *version; // The JSON format version (previously a number, saved as string since 1.6)
+    char filename[MAX_FILENAME_LENGTH]; // File the map was loaded from
+    SDL_Rect bounds; // Pixel area the player and camera are kept in, the map itself unless it is part of a world
+    int chunk_radius; // Chunks kept decoded around the camera view (infinite maps only)
+    void *mapping; // Mapped .zmap file backing the layer data (compiled maps only)
+    size_t mapping_size;
+    Arena arena; // Owns the layers, objects, properties, strings and tile data
+    struct RenderCache *render_cache; // Baked layer textures, only touched on the render thread
 } Map;
 
-void map_init(Map *map, Tileset *tileset, const char *filename);
+#define MAP_NO_TILESET 0xffff
+
+void map_init(Map *map, const char *filename);
+void map_attach_tilesets(Map *map);
+void map_detach_tilesets(Map *map);
+Tileset *map_resolve_gid(Map *map, uint32_t *gid);
+void map_build_occupancy(Map *map);
 void map_draw(App *app, Map *map);
 void map_free(Map *map);
+size_t map_memory_size(Map *map);
 int map_load(Map * map, const char *filename);
-uint32_t map_get_tile_id_at_x_y(Map * map, int layer_index, int x, int y);
-uint32_t map_get_tile_id_at_row_col(Map * map, int layer_index, int row, int col) ;
+int map_load_tmj(Map * map, const char *filename);
+void map_decode_tile_data(const char * encoded, const char * compression, uint32_t * data, size_t count);
+void map_decompress_tile_data(const uint8_t * compressed, size_t compressed_size, const char * compression, uint32_t * data, size_t count);
+uint32_t map_get_tile_id_at_x_y(Map * map, uint32_t layer_index, int x, int y);
+uint32_t map_get_tile_id_at_row_col(Map * map, uint32_t layer_index, int row, int col) ;
 Tile * map_get_tile_at(Map * map, int x, int y);
 bool map_check_tile_collision(Map * map, int col, int row, SDL_Rect * bb_rect, SDL_Rect * intersection);
-bool map_check_object_collisions(Map * map, const char * name, SDL_Rect * player_rect, void (*collision_callback)(Property * property, void * data), void* data) ;
+bool map_check_box_collision(Map *map, uint32_t channels, const SDL_Rect *box, SDL_Rect *intersection);
+bool map_check_object_collisions(Map * map, Atom name, SDL_Rect * player_rect, void (*collision_callback)(Property * property, void * data), void* data) ;
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef MAP_CACHE_H
+#define MAP_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "map.h"
+
+/**
+ * Cache of loaded maps that are not in use, keyed by map path
+ *
+ * Maps move in and out of the cache, a map is either in the cache or owned by
+ * its user. Maps given back with map_cache_put() stay loaded with their
+ * tilesets attached until the cache grows past its byte budget, then the least
+ * recently used ones are freed on the next map_cache_update().
+ * Maps that are taken prefetch their warp targets in the background. A map
+ * that is in use is never loaded a second time.
+ *
+ *   map_cache_request(path);
+ *   ...
+ *   if (map_cache_take(path, &map)) {
+ *       ...
+ *       map_cache_put(&map);
+ *   }
+ */
+
+void map_cache_init(size_t budget);
+void map_cache_quit(void);
+void map_cache_update(void);
+void map_cache_prefetch(const char *filename);
+void map_cache_prefetch_warps(Map *map);
+void map_cache_request(const char *filename);
+void map_cache_cancel(const char *filename);
+bool map_cache_take(const char *filename, Map *map);
+void map_cache_load(const char *filename, Map *map);
+void map_cache_put(Map *map);
+
+#endif // MAP_CACHE_H
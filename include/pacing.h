@@ -0,0 +1,39 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+/**
+ * Frame pacing
+ *
+ * Decides when the next frame starts. FRAME_PACING_VSYNC leaves it to the
+ * display, FRAME_PACING_UNCAPPED starts frames right away and
+ * FRAME_PACING_TARGET sleeps until shortly before the frame is due and spins
+ * for the rest, SDL_Delay() alone is only accurate to a millisecond or worse.
+ * The simulation does not depend on the frame rate, it runs at
+ * SIMULATION_RATE ticks per second whatever the pacing.
+ *
+ *   pacing_init(renderer);
+ *   while (running) {
+ *       double elapsed = pacing_wait();
+ *       ...
+ *   }
+ */
+
+#define PACING_SPIN_MS 2 // Spin instead of sleeping this close to the deadline
+#define PACING_DEFAULT_RATE 60 // Frame rate aimed for when the display does not tell or frames are uncapped
+
+typedef enum FramePacing
+{
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_UNCAPPED,
+    FRAME_PACING_TARGET
+} FramePacing;
+
+bool pacing_parse(const char *value);
+void pacing_init(SDL_Renderer *renderer);
+double pacing_wait(void);
+double pacing_frame_ms(void);
+
+#endif // PACING_H
@@ -13,6 +13,9 @@
 
 int player_init(App *app, Tileset *tileset);
 void player_handle(App *app, Map *map, Camera * camera);
+void player_save_state(void);
+int player_tile_id(const struct Entity *entity);
+void player_interpolate(const struct Entity *entity, int tile, float alpha);
 void player_draw(App *app);
 void player_free();
 void player_move(Map *map);
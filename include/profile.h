@@ -0,0 +1,58 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <SDL2/SDL.h>
+#include "app.h"
+
+/**
+ * Frame profiler and performance HUD
+ *
+ * Every frame is split into stages timed with SDL_GetPerformanceCounter(),
+ * ending a stage adds the time since the previous stage ended. The stage times
+ * of the last PROFILE_HISTORY frames are kept in a ring buffer. PROFILE_HUD_KEY
+ * toggles an overlay with the average and worst time of every stage over that
+ * window, the frame rate, the resolution scale and a graph of the frame
+ * times. With --profile the frames still in the ring buffer are written as
+ * CSV on exit.
+ *
+ *   profile_frame_begin();
+ *   input_handle(app);
+ *   profile_stage(PROFILE_STAGE_INPUT);
+ *   ...
+ *   profile_frame_end();
+ */
+
+#define PROFILE_HISTORY 240
+#define PROFILE_HUD_KEY SDL_SCANCODE_F3
+#define PROFILE_HUD_FONT "DejaVuSansMono.ttf"
+#define PROFILE_HUD_FONT_SIZE 14
+#define PROFILE_HUD_REFRESH_MS 250 // The text is rendered again this often
+
+typedef enum ProfileStage
+{
+    PROFILE_STAGE_UPDATE, // Animations, map cache, warps and world streaming, and waiting for the simulation lock
+    PROFILE_STAGE_INPUT,
+    PROFILE_STAGE_PLAYER, // Simulation ticks, only when they run on the main thread in the benchmark
+    PROFILE_STAGE_MAP, // Queueing the visible tiles of every map
+    PROFILE_STAGE_SPRITES,
+    PROFILE_STAGE_FLUSH, // Drawing the render queue into the camera target
+    PROFILE_STAGE_CAMERA,
+    PROFILE_STAGE_SCREEN, // Copying the camera target to the screen
+    PROFILE_STAGE_HUD,
+    PROFILE_STAGE_PRESENT,
+    PROFILE_STAGE_COUNT
+} ProfileStage;
+
+void profile_init(App *app);
+void profile_quit(void);
+void profile_set_output(const char *filename);
+void profile_frame_begin(void);
+void profile_stage(ProfileStage stage);
+void profile_frame_end(void);
+void profile_handle(App *app);
+void profile_draw_hud(App *app);
+const char *profile_stage_name(ProfileStage stage);
+double profile_stage_total(ProfileStage stage);
+float profile_last_frame_ms(void);
+
+#endif // PROFILE_H
@@ -0,0 +1,47 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app.h"
+#include "map.h"
+
+/**
+ * Static layer render cache
+ *
+ * The tiles of a layer that are not animated are drawn once into textures of
+ * RENDER_CACHE_CHUNK_SIZE pixels square, a chunk is baked the first time it
+ * comes into view. Every frame draws the visible chunk textures followed by the
+ * animated tiles of the layer. Tiles of image collections are streamed in
+ * and out, so they are drawn one by one like the animated ones. Textures
+ * belong to the renderer, so the cache has to be freed on the render thread
+ * before a map is handed to the loader.
+ */
+
+typedef struct RenderChunk
+{
+    SDL_Texture *texture; // NULL when the chunk has no static tiles
+    bool baked;
+} RenderChunk;
+
+typedef struct RenderLayer
+{
+    int columns; // Chunks
+    int rows;
+    RenderChunk *chunks;
+    uint32_t *animated; // Tile indices of the animated and streamed tiles
+    size_t animated_count;
+} RenderLayer;
+
+typedef struct RenderCache
+{
+    RenderLayer *layers; // One per map layer, built when the layer is first drawn
+    uint32_t layer_count;
+} RenderCache;
+
+void render_cache_draw_layer(App *app, Map *map, uint32_t layer_index);
+void render_cache_free(Map *map);
+void render_cache_set_enabled(bool enabled);
+bool render_cache_enabled(void);
+
+#endif // RENDER_CACHE_H
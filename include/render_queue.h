@@ -0,0 +1,34 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "draw.h"
+
+/**
+ * Sorted render queue
+ *
+ * Tiles and sprites are pushed as textured quads instead of being drawn right
+ * away. render_queue_flush() sorts them by layer, texture and y and draws every
+ * run of quads that share a texture with a single SDL_RenderGeometry call.
+ * Layers whose quads overlap, like sprites and image collection tiles, sort
+ * by y before texture so they are still drawn back to front. Quads with the
+ * same key keep the order they were pushed in. Flips only change the texture
+ * coordinates, flipped quads batch like any other.
+ *
+ *   render_queue_push(texture, &src, &dest, flip, layer, dest.y + dest.h);
+ *   ...
+ *   render_queue_flush(renderer);
+ */
+
+// Or'ed into the layer of quads that can overlap, every quad of the layer has to set it
+#define RENDER_QUEUE_OVERLAP 0x4000
+// Layer of sprites, above every map layer
+#define RENDER_QUEUE_SPRITE_LAYER (0x8000 | RENDER_QUEUE_OVERLAP)
+
+void render_queue_push(SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect *dest, DrawFlip flip, uint16_t layer, int y);
+void render_queue_draw(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect *dest, DrawFlip flip);
+void render_queue_flush(SDL_Renderer *renderer);
+void render_queue_free(void);
+
+#endif // RENDER_QUEUE_H
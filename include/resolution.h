@@ -0,0 +1,40 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <stdbool.h>
+#include "app.h"
+
+/**
+ * Dynamic resolution of the camera target
+ *
+ * The camera always shows the same part of the world, only the number of
+ * target pixels it is drawn into changes. Every level has a target created up
+ * front, the scene is drawn into it with the renderer scaled by the level and
+ * stretched to the screen as before. The time of every frame that redraws the
+ * scene is averaged over RESOLUTION_WINDOW frames: when the average misses the
+ * frame budget of the pacing the next smaller target is used, when the larger
+ * one is expected to fit in RESOLUTION_HEADROOM of the budget, assuming the
+ * frame time grows with the number of pixels, it goes back up.
+ *
+ *   resolution_init(app, &camera);
+ *   while (running) {
+ *       camera_interpolate(&view, &camera, alpha);
+ *       resolution_apply(&view);
+ *       ...
+ *       resolution_frame(profile_last_frame_ms());
+ *   }
+ *   resolution_quit();
+ */
+
+#define RESOLUTION_LEVEL_COUNT 5
+#define RESOLUTION_WINDOW 30 // Frames averaged before the scale changes
+#define RESOLUTION_HEADROOM 0.75f // Part of the budget the next larger target may be expected to take
+
+bool resolution_parse(const char *value);
+void resolution_init(App *app, Camera *camera);
+void resolution_quit(void);
+void resolution_apply(Camera *view);
+void resolution_frame(float ms);
+float resolution_scale(void);
+
+#endif // RESOLUTION_H
@@ -0,0 +1,65 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include "app.h"
+#include "structs.h"
+#include "world.h"
+
+/**
+ * Simulation thread and scene snapshots
+ *
+ * The player and the camera are simulated at SIMULATION_RATE on their own
+ * thread while the main thread renders. Every tick publishes a SceneSnapshot
+ * into a triple buffer, the renderer takes the newest one without waiting, so
+ * a frame takes as long as the slower of the two instead of their sum.
+ *
+ * SDL only allows rendering, events and textures on the main thread. World
+ * streaming, warps, the map cache and tile animations create and free textures,
+ * so they stay on the main thread. The simulation only reads the map the player
+ * is on and writes the player and the camera. simulation_lock() guards them,
+ * the simulation holds it for a tick and the main thread while it hands over
+ * input, applies warps and map changes and takes the newest snapshot. The
+ * snapshot carries everything the frame is drawn from, so streaming, queueing
+ * the tiles and drawing run unlocked.
+ *
+ *   simulation_init(app, world, camera, true);
+ *   while (running) {
+ *       simulation_lock();
+ *       simulation_input(app);
+ *       world_enter(world, camera, player_get());
+ *       const SceneSnapshot * scene = simulation_latest(world);
+ *       simulation_unlock();
+ *       world_stream(world, &scene->camera);
+ *       world_draw(app, world, scene->map);
+ *       ...
+ *   }
+ *   simulation_quit();
+ *
+ * Without a thread simulation_step() runs a tick on the calling thread, the
+ * benchmark does that once a frame to stay reproducible.
+ */
+
+typedef struct SceneSnapshot
+{
+    uint64_t tick; // Simulation ticks before this one
+    Uint64 time; // Performance counter when the tick ran
+    uint64_t ticks; // Simulation clock in milliseconds
+    Map *map; // Map the coordinates are local to
+    SDL_Point origin; // World position of that map
+    Camera camera;
+    struct Entity player;
+    int player_tile; // Player tile of the tick, animation frame resolved
+} SceneSnapshot;
+
+void simulation_init(App *app, World *world, Camera *camera, bool threaded);
+void simulation_quit(void);
+void simulation_lock(void);
+void simulation_unlock(void);
+void simulation_input(App *app);
+void simulation_step(void);
+const SceneSnapshot *simulation_latest(World *world);
+float simulation_alpha(const SceneSnapshot *scene);
+
+#endif // SIMULATION_H
@@ -11,6 +11,8 @@ struct Entity
 {
     int x;
     int y;
+    int previous_x; // Position at the previous simulation tick
+    int previous_y;
     int x_abs;
     int y_abs;
     int width;
@@ -20,6 +22,7 @@ struct Entity
     int health;
     int facing;
     int move_speed;
+    uint64_t animation_ticks; // Own animation clock, only runs while the entity moves
     Tileset *tileset;
     struct Entity *next;
 };
@@ -7,6 +7,9 @@
 
 #include "defs.h"
 #include "app.h"
+#include "arena.h"
+#include "atom.h"
+#include "image_cache.h"
 
 // Bits on the far end of the 32-bit global tile ID are used for tile flags
 #define FLIPPED_HORIZONTALLY_FLAG 0x80000000
@@ -16,6 +19,15 @@
 #define TILE_FLAG_MASK 0xf0000000
 #define TILE_ID_MASK 0x0fffffff
 
+// Flips of a tile as Tiled stores them, the diagonal flip swaps x and y before the others are applied
+typedef enum DrawFlip
+{
+    DRAW_FLIP_NONE = SDL_FLIP_NONE,
+    DRAW_FLIP_HORIZONTAL = SDL_FLIP_HORIZONTAL,
+    DRAW_FLIP_VERTICAL = SDL_FLIP_VERTICAL,
+    DRAW_FLIP_DIAGONAL = 4
+} DrawFlip;
+
 /**
  * https://doc.mapeditor.org/en/stable/reference/json-map-format
  */
@@ -55,11 +67,26 @@ typedef struct AtlasImage
     SDL_Texture *texture;
 } AtlasImage;
 
+typedef enum PropertyType
+{
+    PROPERTY_TYPE_STRING,
+    PROPERTY_TYPE_INT,
+    PROPERTY_TYPE_FLOAT,
+    PROPERTY_TYPE_BOOL,
+    PROPERTY_TYPE_COLOR,
+    PROPERTY_TYPE_FILE,
+    PROPERTY_TYPE_OBJECT,
+    PROPERTY_TYPE_CLASS
+} PropertyType;
+
+// Bit of a property name in the property_mask of its owner
+#define PROPERTY_BIT(name) ((uint64_t)1 << ((name) & 63))
+
 typedef struct Property
 {
-    char *name;
-    char *propertytype;
-    char *type;
+    Atom name;
+    Atom propertytype; // Custom type of class properties
+    PropertyType type; // Decides which member of the value is valid
     union
     {
         char *string_value;
@@ -73,11 +100,13 @@ typedef struct Property
 
 typedef struct Chunk
 {
-    uint32_t* data; // Array of unsigned int (GIDs) or base64-encoded data
+    uint32_t* data; // Array of unsigned int (GIDs), NULL while the chunk is evicted
     int height; // Height in tiles
     int width; // Width in tiles
     int x; // X coordinate in tiles
     int y; // Y coordinate in tiles
+    uint8_t* packed; // Compressed GIDs the chunk is decoded from
+    size_t packed_size;
 } Chunk;
 
 typedef struct Point
@@ -106,19 +135,20 @@ typedef struct Text
 typedef struct Object
 {
     bool ellipse; // Used to mark an object as an ellipse
-    int gid; // Global tile ID, only if object represents a tile
+    uint32_t gid; // Global tile ID, only if object represents a tile
     double height; // Height in pixels
     int id; // Incremental ID, unique across all objects
-    char* name; // String assigned to name field in editor
+    Atom name; // String assigned to name field in editor
     bool point; // Used to mark an object as a point
     Point* polygon; // Array of Points, in case the object is a polygon
     Point* polyline; // Array of Points, in case the object is a polyline
     size_t property_count; // Number of Properties
     Property* properties; // Array of Properties
+    uint64_t property_mask; // PROPERTY_BIT of every property name
     double rotation; // Angle in degrees clockwise
     char* template; // Reference to a template file, in case object is a template instance
     Text* text; // Only used for text objects
-    char* type; // The class of the object (was saved as class in 1.9, optional)
+    Atom type; // The class of the object (was saved as class in 1.9, optional)
     bool visible; // Whether object is shown in editor
     double width; // Width in pixels
     double x; // X coordinate in pixels
@@ -136,9 +166,17 @@ typedef struct Layer
     // Additional fields
     Chunk* array; // Array of chunks optional
     uint32_t array_count; // Array of chunks optional
-    char* class;
+    struct hashmap* chunk_table; // Chunk grid position to chunk (infinite maps only)
+    int chunkwidth; // Width of every chunk in tiles
+    int chunkheight; // Height of every chunk in tiles
+    SDL_Rect resident; // Chunk grid area that is currently decoded
+    Atom class;
     char* compression;
     uint32_t* data;
+    uint64_t* occupancy; // Bit per tile that is not empty, every row starts at a new word (layers with data only)
+    uint32_t occupancy_words; // Words per row
+    bool empty; // Tile layer without a single tile
+    bool overlapping; // Has image collection tiles that reach into other cells, set while the tilesets are attached
     char* draworder;
     char* encoding;
     int height;
@@ -146,7 +184,7 @@ typedef struct Layer
     bool locked;
     struct Layer *layers; // Array of Layers
     uint32_t layer_count;
-    char* name;
+    Atom name;
     size_t object_count;
     Object* objects;
     double offsetx;
@@ -161,7 +199,7 @@ typedef struct Layer
     int starty;
     char* tintcolor;
     char* transparentcolor;
-    char* type;
+    Atom type; // tilelayer, objectgroup, imagelayer or group
     bool visible;
     int width;
 } Layer;
@@ -187,16 +225,44 @@ typedef struct Tile
     Layer *objectgroup; // Optional
     size_t objectgroup_count;
 
-    uint32_t current_animation_frame;
-    uint32_t last_tick;
-
     int terrain[4]; // Optional
-    char *type;     // Optional
+    Atom type;     // Optional
 
     size_t property_count;
     Property *properties;
+    uint64_t property_mask; // PROPERTY_BIT of every property name
 } Tile;
 
+// Flags of a tile in the lookup table of its tileset
+#define TILE_INFO_SOLID (1 << 0) // Has a solid property that is true
+#define TILE_INFO_ANIMATED (1 << 1) // animation indexes the animations of the tileset
+#define TILE_INFO_HITBOX (1 << 2) // hitbox holds a collision_box object
+#define TILE_INFO_WATER (1 << 3) // Has a water property that is true
+#define TILE_INFO_TRIGGER (1 << 4) // Has a trigger property that is true
+
+typedef struct TileAnimation
+{
+    Frame *frames;
+    uint32_t frame_count;
+    uint32_t *ends; // Milliseconds from the start of the animation to the end of every frame
+    uint32_t duration; // Length of one loop, 0 shows the first frame forever
+    uint32_t tileid; // Frame shown at the last tileset_update_animations()
+} TileAnimation;
+
+/**
+ * Everything needed to draw or collide with a tile, built when the tileset is
+ * loaded so per-tile lookups are an array index.
+ */
+typedef struct TileInfo
+{
+    Tile *tile; // NULL when the tileset file has no data for the tile
+    SDL_Rect src; // Position in the tileset texture, the size of the image of streamed tiles
+    TileImage *image; // Own image of tiles of image collection tilesets, NULL otherwise
+    SDL_Rect hitbox; // Relative to the top left of the tile
+    uint32_t animation;
+    uint32_t flags;
+} TileInfo;
+
 typedef struct Tileset
 {
     uint32_t first_gid;
@@ -214,11 +280,35 @@ typedef struct Tileset
 
     Tile *tiles;
     uint32_t tile_count;
-    SDL_Texture *texture;
+    TileInfo *info; // Indexed by local id, num_tiles entries
+    TileAnimation *animations;
+    uint32_t animation_count;
+    SDL_Texture *texture; // Atlas page the tileset image was packed into, NULL for image collections
+    SDL_Rect image; // Position of the tileset image on the atlas page
+    Arena arena; // Owns the tiles and everything they point to
 } Tileset;
 
+// A tile resolved for a map cell, see tileset_place_tile()
+typedef struct TilePlacement
+{
+    TileInfo *info; // Animation frame drawn
+    DrawFlip flip;
+    SDL_Rect dest; // Area the tile covers
+} TilePlacement;
+
 Tileset * tileset_load(App * app, const char * filename);
 void tileset_free(Tileset *tiles);
 void tileset_render_tile(App * app, Tileset * tileset, int tileid,bool local_tile_id, int x, int y, bool animated);
+bool tileset_place_tile(Tileset *tileset, int tile_id, bool local_tile_id, int x, int y, int cell_height, TilePlacement *placement);
+void tileset_queue_placement(Tileset *tileset, const TilePlacement *placement, uint16_t layer);
+void tileset_queue_tile(Tileset * tileset, int tile_id, bool local_tile_id, int x, int y, bool animated, uint16_t layer);
 Tile * tileset_get_tile_by_id(Tileset * tileset, int tile_id, bool local);
+TileInfo * tileset_get_info(Tileset * tileset, uint32_t tile_id, bool local);
+bool tileset_update_animations(Tileset * tileset, uint64_t ticks);
+uint32_t tileset_animation_frame(Tileset * tileset, uint32_t tile_id, uint64_t ticks);
+bool property_has_string(const Property * property);
+PropertyType property_type_from_atom(Atom type);
+Atom property_type_atom(PropertyType type);
+uint64_t property_mask_build(const Property * properties, size_t count);
+Property * property_find(Property * properties, size_t count, uint64_t mask, Atom name);
 #endif
\ No newline at end of file
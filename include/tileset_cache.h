@@ -0,0 +1,27 @@
+#ifndef TILESET_CACHE_H
+#define TILESET_CACHE_H
+
+#include "app.h"
+#include "tileset.h"
+
+/**
+ * Shared tilesets, keyed by .tsj path
+ *
+ * Every map that references a tileset file holds a reference to the same
+ * parsed tileset and texture. A tileset is loaded on the first acquire and
+ * freed when its last reference is released. Textures belong to the renderer,
+ * so the cache is only used on the render thread. Without tileset_cache_init(),
+ * as in tools and tests, nothing is loaded and acquire returns NULL.
+ *
+ *   Tileset * tileset = tileset_cache_acquire(path);
+ *   ...
+ *   tileset_cache_release(tileset);
+ */
+
+void tileset_cache_init(App *app);
+void tileset_cache_quit(void);
+Tileset *tileset_cache_acquire(const char *filename);
+void tileset_cache_release(Tileset *tileset);
+bool tileset_cache_update_animations(uint64_t ticks);
+
+#endif // TILESET_CACHE_H
@@ -0,0 +1,32 @@
+#ifndef WARP_H
+#define WARP_H
+
+#include <stdbool.h>
+#include "app.h"
+#include "map.h"
+#include "structs.h"
+
+#define WARP_FADE_MS 200
+
+/**
+ * Asynchronous warps between maps
+ *
+ * warp_start() records the destination, warp_prepare() requests it from the
+ * map cache on the main thread and takes it once it is loaded. The current map
+ * keeps rendering behind a fade out until warp_finish(), called at the start
+ * of every frame, swaps the loaded map in and moves the player. Maps that
+ * are already in use are not loaded again, their user switches to them and
+ * calls warp_arrive() instead.
+ */
+
+void warp_start(const char *filename, int x, int y);
+bool warp_pending(void);
+bool warp_fading(void);
+const char *warp_destination(void);
+void warp_arrive(struct Entity *player);
+void warp_prepare(void);
+bool warp_finish(Map *map, struct Entity *player);
+void warp_draw(App *app);
+void warp_cancel(void);
+
+#endif // WARP_H
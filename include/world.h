@@ -0,0 +1,55 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <SDL2/SDL.h>
+#include "app.h"
+#include "map.h"
+#include "structs.h"
+
+/**
+ * Tiled world (.world) streaming
+ *
+ * The map the player is on is always loaded. Neighboring maps are requested
+ * from the map cache once they come within load_distance pixels of the camera
+ * and unloaded when they are more than twice that away, or when the loaded
+ * maps use more than memory_budget bytes. Player and camera coordinates stay
+ * local to the current map, neighbors are drawn at their world offset. Warps
+ * to a loaded map switch over to it in world_warp().
+ */
+
+typedef enum WorldMapState
+{
+    WORLD_MAP_UNLOADED,
+    WORLD_MAP_LOADING,
+    WORLD_MAP_LOADED
+} WorldMapState;
+
+typedef struct WorldMap
+{
+    char path[MAX_FILENAME_LENGTH]; // Map file, relative to the world file
+    SDL_Rect rect; // Position and size in world pixels
+    WorldMapState state;
+    Map map;
+    size_t memory_size; // Memory used the last time the map was loaded
+} WorldMap;
+
+typedef struct World
+{
+    WorldMap *maps;
+    size_t map_count;
+    WorldMap *current; // Map the player is on
+    int load_distance; // Pixels around the camera in which neighboring maps are loaded
+    size_t memory_budget; // Bytes the loaded maps may use
+    size_t memory_used;
+} World;
+
+int world_load(World *world, const char *filename, const char *start_map);
+Map *world_get_map(World *world);
+bool world_warp(World *world, struct Entity *player);
+void world_enter(World *world, Camera *camera, struct Entity *player);
+void world_stream(World *world, const Camera *camera);
+void world_update(World *world, Camera *camera, struct Entity *player);
+void world_draw(App *app, World *world, Map *map);
+void world_free(World *world);
+
+#endif // WORLD_H
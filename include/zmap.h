@@ -0,0 +1,122 @@
+#ifndef ZMAP_H
+#define ZMAP_H
+
+#include <stdint.h>
+#include "map.h"
+
+/**
+ * Compiled binary map format (.zmap)
+ *
+ * A .zmap file is a little-endian image of a loaded Map that can be mmapped
+ * and used in place. It starts with a ZmapHeader followed by a section table,
+ * every section is aligned to ZMAP_ALIGNMENT bytes:
+ *
+ *   ZmapHeader
+ *   ZmapSection[section_count]
+ *   ZMAP_SECTION_LAYERS     ZmapLayer[layer_count]
+ *   ZMAP_SECTION_OBJECTS    ZmapObject[]
+ *   ZMAP_SECTION_PROPERTIES ZmapProperty[]
+ *   ZMAP_SECTION_STRINGS    NUL terminated strings, referenced by byte offset
+ *   ZMAP_SECTION_GIDS       uint32_t gids, one flat width*height array per tile layer
+ *   ZMAP_SECTION_TILESETS   ZmapTileset[], sorted by first gid
+ *
+ * Use tmj2zmap to convert a .tmj map into a .zmap file.
+ */
+
+#define ZMAP_MAGIC 0x50414d5a // "ZMAP"
+#define ZMAP_VERSION 2
+#define ZMAP_ALIGNMENT 64
+#define ZMAP_NO_STRING 0xffffffff
+#define ZMAP_EXTENSION ".zmap"
+
+#define ZMAP_FLAG_INFINITE 0x1
+
+typedef enum ZmapSectionType
+{
+    ZMAP_SECTION_LAYERS = 1,
+    ZMAP_SECTION_OBJECTS,
+    ZMAP_SECTION_PROPERTIES,
+    ZMAP_SECTION_STRINGS,
+    ZMAP_SECTION_GIDS,
+    ZMAP_SECTION_TILESETS,
+    ZMAP_SECTION_COUNT = ZMAP_SECTION_TILESETS
+} ZmapSectionType;
+
+typedef enum ZmapPropertyKind
+{
+    ZMAP_PROPERTY_NONE,
+    ZMAP_PROPERTY_STRING,
+    ZMAP_PROPERTY_NUMBER,
+    ZMAP_PROPERTY_BOOL
+} ZmapPropertyKind;
+
+typedef struct ZmapHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t section_count;
+    uint32_t flags;
+    uint32_t width; // Map width in tiles
+    uint32_t height; // Map height in tiles
+    uint32_t tilewidth;
+    uint32_t tileheight;
+    uint32_t layer_count;
+} ZmapHeader;
+
+typedef struct ZmapSection
+{
+    uint32_t type; // ZmapSectionType
+    uint32_t count; // Number of entries in the section
+    uint64_t offset; // Offset from the start of the file in bytes
+    uint64_t size; // Size in bytes
+} ZmapSection;
+
+typedef struct ZmapLayer
+{
+    uint32_t id;
+    uint32_t type; // String offset
+    uint32_t name; // String offset
+    uint32_t width;
+    uint32_t height;
+    uint32_t gid_offset; // Index of the first gid in the gid section
+    uint32_t object_first; // Index of the first object in the object section
+    uint32_t object_count;
+} ZmapLayer;
+
+typedef struct ZmapObject
+{
+    double x;
+    double y;
+    double width;
+    double height;
+    uint32_t id;
+    uint32_t gid;
+    uint32_t name; // String offset
+    uint32_t type; // String offset
+    uint32_t property_first; // Index of the first property in the property section
+    uint32_t property_count;
+} ZmapObject;
+
+typedef struct ZmapProperty
+{
+    double number_value;
+    uint32_t name; // String offset
+    uint32_t type; // String offset
+    uint32_t propertytype; // String offset
+    uint32_t string_value; // String offset
+    uint32_t kind; // ZmapPropertyKind
+    uint32_t reserved;
+} ZmapProperty;
+
+typedef struct ZmapTileset
+{
+    uint32_t first_gid;
+    uint32_t source; // String offset
+} ZmapTileset;
+
+int zmap_load(Map *map, const char *filename);
+int zmap_write(Map *map, const char *filename);
+void zmap_unload(Map *map);
+bool zmap_find_compiled(const char *filename, char *compiled, size_t size);
+
+#endif // ZMAP_H
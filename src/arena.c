@@ -0,0 +1,122 @@
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// Logging
+#include <log.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t capacity;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+static ArenaBlock * arena_block_new(Arena * arena, size_t capacity) {
+    ArenaBlock * block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL) {
+        log_error("Failed to allocate arena block of %zu bytes", capacity);
+        exit(1);
+    }
+    block->capacity = capacity;
+    block->used = 0;
+    arena->size += sizeof(ArenaBlock) + capacity;
+    return block;
+}
+
+void arena_init(Arena * arena) {
+    arena->blocks = NULL;
+    arena->size = 0;
+}
+
+/**
+ * @brief Allocate zeroed memory owned by the arena
+ *
+ * @param arena
+ * @param size Bytes, 0 returns NULL
+ * @return void* Memory aligned for any type, valid until the arena is freed
+ */
+void * arena_alloc(Arena * arena, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    size = ARENA_ALIGN(size);
+    ArenaBlock * block = arena->blocks;
+    if (block == NULL || block->capacity - block->used < size) {
+        if (size > ARENA_BLOCK_SIZE / 4 && block != NULL) {
+            // Large allocations get a block of their own, the current block stays in use
+            ArenaBlock * large = arena_block_new(arena, size);
+            large->next = block->next;
+            block->next = large;
+            large->used = size;
+            memset(large->data, 0, size);
+            return large->data;
+        }
+        block = arena_block_new(arena, size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    void * ptr = block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/**
+ * @brief Resize an allocation, in place when it is the last one of the current block
+ *
+ * Shrinking the last allocation gives the bytes back to the arena, so a worst
+ * case buffer can be trimmed once its real size is known.
+ *
+ * @param arena
+ * @param ptr Allocation of old_size bytes or NULL
+ * @param old_size
+ * @param new_size
+ * @return void* The resized allocation, the part past old_size is zeroed
+ */
+void * arena_realloc(Arena * arena, void * ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL) {
+        return arena_alloc(arena, new_size);
+    }
+    ArenaBlock * block = arena->blocks;
+    uintptr_t offset = (uintptr_t)ptr - (uintptr_t)block->data;
+    if (offset + ARENA_ALIGN(old_size) == block->used && block->capacity - offset >= ARENA_ALIGN(new_size)) {
+        block->used = offset + ARENA_ALIGN(new_size);
+        if (new_size > old_size) {
+            memset((unsigned char *)ptr + old_size, 0, new_size - old_size);
+        }
+        return ptr;
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+    void * grown = arena_alloc(arena, new_size);
+    memcpy(grown, ptr, old_size);
+    return grown;
+}
+
+char * arena_strdup(Arena * arena, const char * string) {
+    size_t length = strlen(string);
+    char * copy = arena_alloc(arena, length + 1);
+    memcpy(copy, string, length);
+    return copy;
+}
+
+/**
+ * @brief Free everything allocated from the arena, it can be used again afterwards
+ */
+void arena_free(Arena * arena) {
+    ArenaBlock * block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock * next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "assets.h"
 #include "log.h"
 
@@ -21,6 +22,21 @@
 // struct hashmap *asset_map;
 static struct asset * asset_map;
 static size_t asset_count = 0;
+// Holds assets.json and its cJSON tree while it is parsed
+static Arena asset_scratch;
+
+static void * asset_json_malloc(size_t size) {
+    return arena_alloc(&asset_scratch, size);
+}
+
+// Nodes are freed all at once with the scratch arena
+static void asset_json_free(void * ptr) {
+}
+
+static void asset_json_done(void) {
+    cJSON_InitHooks(NULL);
+    arena_free(&asset_scratch);
+}
 
 int asset_init() {
 //    asset_map = hashmap_new(sizeof(struct asset), 0, 0, 0, 
@@ -34,15 +50,19 @@ int asset_init() {
     fseek(file, 0, SEEK_END);
     long size = ftell(file);
     fseek(file, 0, SEEK_SET);
-    char * buffer = malloc(size);
+    arena_init(&asset_scratch);
+    cJSON_InitHooks(&(cJSON_Hooks){.malloc_fn = asset_json_malloc, .free_fn = asset_json_free});
+    char * buffer = arena_alloc(&asset_scratch, size + 1);
     fread(buffer, 1, size, file);
     fclose(file);
     cJSON * json = cJSON_Parse(buffer);
     if (json == NULL) {
+        asset_json_done();
         return -1;
     }
     cJSON * assets = cJSON_GetObjectItem(json, "assets");
     if (assets == NULL) {
+        asset_json_done();
         return -1;
     }
     cJSON * asset = NULL;
@@ -66,17 +86,17 @@ int asset_init() {
         if (!access(a->filename, F_OK) == 0) {
             // file does not exists
             log_error("Asset file does not exist: %s", a->filename);
-            cJSON_Delete(json);
+            asset_json_done();
             exit(1);
         } 
         asset_index++;
     }
-    cJSON_Delete(json);
+    asset_json_done();
     return 0;
 }
 
 char * asset_path(char * filename) {
-    log_debug("Looking for asset: %s in total of %d assets", filename, asset_count);
+    log_debug("Looking for asset: %s in total of %zu assets", filename, asset_count);
     for (size_t i = 0; i < asset_count; i++)
     {
         if (strcmp(asset_map[i].name, filename) == 0) {
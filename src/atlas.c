@@ -0,0 +1,293 @@
+#include <SDL2/SDL.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+
+// Logging
+#include <log.h>
+
+static AtlasPage * atlas_pages;
+static size_t atlas_page_count;
+static size_t atlas_page_capacity;
+
+// Top of a rectangle placed at a skyline segment, -1 when it does not fit there
+static int atlas_skyline_fit(AtlasPage * page, int index, int width, int height) {
+    if (page->skyline[index].x + width > page->width) {
+        return -1;
+    }
+    int y = 0;
+    int remaining = width;
+    for (int i = index; remaining > 0; i++) {
+        y = SDL_max(y, page->skyline[i].y);
+        if (y + height > page->height) {
+            return -1;
+        }
+        remaining -= page->skyline[i].width;
+    }
+    return y;
+}
+
+static void atlas_skyline_insert(AtlasPage * page, int index, AtlasSkyline segment) {
+    if (page->skyline_count == page->skyline_capacity) {
+        page->skyline_capacity = page->skyline_capacity ? page->skyline_capacity * 2 : 16;
+        page->skyline = realloc(page->skyline, page->skyline_capacity * sizeof(AtlasSkyline));
+        if (page->skyline == NULL) {
+            log_error("Failed to allocate atlas skyline");
+            exit(1);
+        }
+    }
+    memmove(&page->skyline[index + 1], &page->skyline[index], (page->skyline_count - index) * sizeof(AtlasSkyline));
+    page->skyline[index] = segment;
+    page->skyline_count++;
+}
+
+static void atlas_skyline_remove(AtlasPage * page, int index) {
+    memmove(&page->skyline[index], &page->skyline[index + 1], (page->skyline_count - index - 1) * sizeof(AtlasSkyline));
+    page->skyline_count--;
+}
+
+static void atlas_free_insert(AtlasPage * page, SDL_Rect rect) {
+    if (rect.w <= 0 || rect.h <= 0) {
+        return;
+    }
+    if (page->free_count == page->free_capacity) {
+        page->free_capacity = page->free_capacity ? page->free_capacity * 2 : 8;
+        page->free_rects = realloc(page->free_rects, page->free_capacity * sizeof(SDL_Rect));
+        if (page->free_rects == NULL) {
+            log_error("Failed to allocate atlas free space");
+            exit(1);
+        }
+    }
+    page->free_rects[page->free_count++] = rect;
+}
+
+// Place a rectangle in the smallest released space it fits in, the rest of the space stays free
+static bool atlas_free_pack(AtlasPage * page, int width, int height, SDL_Rect * rect) {
+    int best = -1;
+    for (int i = 0; i < page->free_count; i++) {
+        SDL_Rect * space = &page->free_rects[i];
+        if (space->w >= width && space->h >= height && (best < 0 || space->w * space->h < page->free_rects[best].w * page->free_rects[best].h)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    SDL_Rect space = page->free_rects[best];
+    page->free_rects[best] = page->free_rects[--page->free_count];
+    // Split off the part right of the rectangle and the part below it
+    atlas_free_insert(page, (SDL_Rect){space.x + width, space.y, space.w - width, height});
+    atlas_free_insert(page, (SDL_Rect){space.x, space.y + height, space.w, space.h - height});
+    *rect = (SDL_Rect){space.x, space.y, width, height};
+    return true;
+}
+
+/**
+ * @brief Find room for a rectangle on a page, bottom left first
+ *
+ * Space of released images is used first. Otherwise picks the skyline segment
+ * where the rectangle ends up lowest, ties go to the narrowest segment to keep
+ * wide gaps for wide images.
+ *
+ * @param page
+ * @param width
+ * @param height
+ * @param rect Receives the position of the rectangle
+ * @return true The rectangle was placed, false when the page is full
+ */
+bool atlas_page_pack(AtlasPage * page, int width, int height, SDL_Rect * rect) {
+    if (atlas_free_pack(page, width, height, rect)) {
+        page->images++;
+        return true;
+    }
+    if (page->skyline_count == 0) {
+        atlas_skyline_insert(page, 0, (AtlasSkyline){0, 0, page->width});
+    }
+    int best = -1;
+    int best_y = 0;
+    int best_bottom = INT_MAX;
+    int best_width = INT_MAX;
+    for (int i = 0; i < page->skyline_count; i++) {
+        int y = atlas_skyline_fit(page, i, width, height);
+        if (y < 0) {
+            continue;
+        }
+        if (y + height < best_bottom || (y + height == best_bottom && page->skyline[i].width < best_width)) {
+            best = i;
+            best_y = y;
+            best_bottom = y + height;
+            best_width = page->skyline[i].width;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    int x = page->skyline[best].x;
+    atlas_skyline_insert(page, best, (AtlasSkyline){x, best_bottom, width});
+
+    // The new segment covers the segments to its right, cut them back
+    for (int i = best + 1; i < page->skyline_count; i++) {
+        int right = page->skyline[i - 1].x + page->skyline[i - 1].width;
+        if (page->skyline[i].x >= right) {
+            break;
+        }
+        int overlap = right - page->skyline[i].x;
+        page->skyline[i].x += overlap;
+        page->skyline[i].width -= overlap;
+        if (page->skyline[i].width > 0) {
+            break;
+        }
+        atlas_skyline_remove(page, i--);
+    }
+    // Merge neighbors at the same height
+    for (int i = 0; i + 1 < page->skyline_count; i++) {
+        if (page->skyline[i].y == page->skyline[i + 1].y) {
+            page->skyline[i].width += page->skyline[i + 1].width;
+            atlas_skyline_remove(page, i + 1);
+            i--;
+        }
+    }
+    *rect = (SDL_Rect){x, best_y, width, height};
+    page->images++;
+    return true;
+}
+
+/**
+ * @brief Give the space of a packed rectangle back to a page
+ *
+ * Released space next to other released space of the same height or width is
+ * merged, so a page that is emptied bit by bit can fit large images again.
+ *
+ * @param page
+ * @param rect Rectangle from atlas_page_pack()
+ */
+void atlas_page_free(AtlasPage * page, const SDL_Rect * rect) {
+    page->images--;
+    SDL_Rect space = *rect;
+    for (int i = 0; i < page->free_count; i++) {
+        SDL_Rect * other = &page->free_rects[i];
+        bool row = other->y == space.y && other->h == space.h && (other->x + other->w == space.x || space.x + space.w == other->x);
+        bool column = other->x == space.x && other->w == space.w && (other->y + other->h == space.y || space.y + space.h == other->y);
+        if (row || column) {
+            // The grown space may line up with space that was checked already
+            SDL_UnionRect(other, &space, &space);
+            page->free_rects[i] = page->free_rects[--page->free_count];
+            i = -1;
+        }
+    }
+    atlas_free_insert(page, space);
+}
+
+static AtlasPage * atlas_page_new(SDL_Renderer * renderer, int width, int height) {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        // Zero means the renderer has no limit
+        int max_width = info.max_texture_width ? info.max_texture_width : INT_MAX;
+        int max_height = info.max_texture_height ? info.max_texture_height : INT_MAX;
+        if (width > max_width || height > max_height) {
+            log_error("Atlas image of %dx%d is larger than the largest texture", width, height);
+            exit(1);
+        }
+        width = SDL_max(SDL_min(ATLAS_PAGE_SIZE, max_width), width);
+        height = SDL_max(SDL_min(ATLAS_PAGE_SIZE, max_height), height);
+    }
+    if (atlas_page_count == atlas_page_capacity) {
+        atlas_page_capacity = atlas_page_capacity ? atlas_page_capacity * 2 : 4;
+        atlas_pages = realloc(atlas_pages, atlas_page_capacity * sizeof(AtlasPage));
+        if (atlas_pages == NULL) {
+            log_error("Failed to allocate atlas pages");
+            exit(1);
+        }
+    }
+    AtlasPage * page = &atlas_pages[atlas_page_count++];
+    *page = (AtlasPage){.width = width, .height = height};
+    page->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
+    if (page->texture == NULL) {
+        log_error("Failed to create atlas page: %s", SDL_GetError());
+        exit(1);
+    }
+    SDL_SetTextureBlendMode(page->texture, SDL_BLENDMODE_BLEND);
+    log_debug("Created atlas page %zu of %dx%d", atlas_page_count - 1, width, height);
+    return page;
+}
+
+/**
+ * @brief Copy an image into an atlas page
+ *
+ * @param renderer Renderer the page textures are created with
+ * @param surface Image, any pixel format
+ * @param rect Receives the position of the image on the page
+ * @return SDL_Texture* Page texture, release it with atlas_release()
+ */
+SDL_Texture * atlas_add(SDL_Renderer * renderer, SDL_Surface * surface, SDL_Rect * rect) {
+    // Copy the image into the middle of a transparent border
+    SDL_Surface * padded = SDL_CreateRGBSurfaceWithFormat(0, surface->w + ATLAS_PADDING * 2, surface->h + ATLAS_PADDING * 2, 32, SDL_PIXELFORMAT_RGBA32);
+    if (padded == NULL) {
+        log_error("Failed to create atlas image: %s", SDL_GetError());
+        exit(1);
+    }
+    SDL_Rect inner = {ATLAS_PADDING, ATLAS_PADDING, surface->w, surface->h};
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(surface, NULL, padded, &inner);
+
+    AtlasPage * page = NULL;
+    SDL_Rect packed;
+    for (size_t i = 0; i < atlas_page_count && page == NULL; i++) {
+        if (atlas_page_pack(&atlas_pages[i], padded->w, padded->h, &packed)) {
+            page = &atlas_pages[i];
+        }
+    }
+    if (page == NULL) {
+        page = atlas_page_new(renderer, padded->w, padded->h);
+        atlas_page_pack(page, padded->w, padded->h, &packed);
+    }
+    if (SDL_UpdateTexture(page->texture, &packed, padded->pixels, padded->pitch) != 0) {
+        log_error("Failed to upload atlas image: %s", SDL_GetError());
+        exit(1);
+    }
+    SDL_FreeSurface(padded);
+    *rect = (SDL_Rect){packed.x + ATLAS_PADDING, packed.y + ATLAS_PADDING, surface->w, surface->h};
+    return page->texture;
+}
+
+/**
+ * @brief Drop an image, its space is reused and the last image of a page destroys the page
+ *
+ * @param texture Page texture from atlas_add(), NULL is ignored
+ * @param rect Position of the image from atlas_add()
+ */
+void atlas_release(SDL_Texture * texture, const SDL_Rect * rect) {
+    if (texture == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < atlas_page_count; i++) {
+        AtlasPage * page = &atlas_pages[i];
+        if (page->texture != texture) {
+            continue;
+        }
+        SDL_Rect packed = {rect->x - ATLAS_PADDING, rect->y - ATLAS_PADDING, rect->w + ATLAS_PADDING * 2, rect->h + ATLAS_PADDING * 2};
+        atlas_page_free(page, &packed);
+        if (page->images == 0) {
+            SDL_DestroyTexture(page->texture);
+            free(page->skyline);
+            free(page->free_rects);
+            *page = atlas_pages[--atlas_page_count];
+        }
+        return;
+    }
+    log_warn("Released a texture that is not an atlas page");
+}
+
+void atlas_quit(void) {
+    for (size_t i = 0; i < atlas_page_count; i++) {
+        log_warn("Atlas page %zu still has %d images", i, atlas_pages[i].images);
+        SDL_DestroyTexture(atlas_pages[i].texture);
+        free(atlas_pages[i].skyline);
+        free(atlas_pages[i].free_rects);
+    }
+    free(atlas_pages);
+    atlas_pages = NULL;
+    atlas_page_count = 0;
+    atlas_page_capacity = 0;
+}
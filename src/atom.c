@@ -0,0 +1,141 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hashmap.h>
+#include "arena.h"
+#include "atom.h"
+
+// Logging
+#include <log.h>
+
+typedef struct AtomEntry
+{
+    const char *name;
+    Atom atom;
+} AtomEntry;
+
+static const char * atom_builtin_names[ATOM_BUILTIN_COUNT] = {
+    [ATOM_NONE] = NULL,
+    [ATOM_TILELAYER] = "tilelayer",
+    [ATOM_OBJECTGROUP] = "objectgroup",
+    [ATOM_IMAGELAYER] = "imagelayer",
+    [ATOM_GROUP] = "group",
+    [ATOM_STRING] = "string",
+    [ATOM_INT] = "int",
+    [ATOM_FLOAT] = "float",
+    [ATOM_BOOL] = "bool",
+    [ATOM_COLOR] = "color",
+    [ATOM_FILE] = "file",
+    [ATOM_OBJECT] = "object",
+    [ATOM_CLASS] = "class",
+    [ATOM_SOLID] = "solid",
+    [ATOM_WARP] = "warp",
+    [ATOM_COLLISION_BOX] = "collision_box",
+    [ATOM_WATER] = "water",
+    [ATOM_TRIGGER] = "trigger",
+};
+
+static SDL_SpinLock atom_lock;
+static struct hashmap * atom_table;
+static const char ** atom_names; // Name of every atom, indexed by atom
+static size_t atom_count;
+static size_t atom_capacity;
+static Arena atom_arena; // Owns the names
+
+static uint64_t atom_entry_hash(const void * item, uint64_t seed0, uint64_t seed1) {
+    const AtomEntry * entry = item;
+    return hashmap_sip(entry->name, strlen(entry->name), seed0, seed1);
+}
+
+static int atom_entry_compare(const void * a, const void * b, void * udata) {
+    const AtomEntry * entry_a = a;
+    const AtomEntry * entry_b = b;
+    return strcmp(entry_a->name, entry_b->name);
+}
+
+static Atom atom_add(const char * string) {
+    if (atom_count == atom_capacity) {
+        atom_capacity = atom_capacity ? atom_capacity * 2 : 256;
+        atom_names = realloc(atom_names, atom_capacity * sizeof(const char *));
+        if (atom_names == NULL) {
+            log_error("Failed to allocate atom names");
+            exit(1);
+        }
+    }
+    AtomEntry entry = {.atom = atom_count};
+    if (string != NULL) {
+        entry.name = arena_strdup(&atom_arena, string);
+        if (hashmap_set(atom_table, &entry) == NULL && hashmap_oom(atom_table)) {
+            log_error("Failed to allocate atom table");
+            exit(1);
+        }
+    }
+    atom_names[atom_count++] = entry.name;
+    return entry.atom;
+}
+
+// Called with the lock held
+static void atom_init(void) {
+    atom_table = hashmap_new(sizeof(AtomEntry), 256, 0, 0, atom_entry_hash, atom_entry_compare, NULL, NULL);
+    if (atom_table == NULL) {
+        log_error("Failed to allocate atom table");
+        exit(1);
+    }
+    arena_init(&atom_arena);
+    for (int i = 0; i < ATOM_BUILTIN_COUNT; i++) {
+        atom_add(atom_builtin_names[i]);
+    }
+}
+
+/**
+ * @brief Get the atom of a string, adding it when it was not seen before
+ *
+ * @param string String to intern, NULL gives ATOM_NONE
+ * @return Atom
+ */
+Atom atom_intern(const char * string) {
+    if (string == NULL) {
+        return ATOM_NONE;
+    }
+    SDL_AtomicLock(&atom_lock);
+    if (atom_table == NULL) {
+        atom_init();
+    }
+    const AtomEntry * entry = hashmap_get(atom_table, &(AtomEntry){.name = string});
+    Atom atom = entry != NULL ? entry->atom : atom_add(string);
+    SDL_AtomicUnlock(&atom_lock);
+    return atom;
+}
+
+/**
+ * @brief Get the string of an atom
+ *
+ * @param atom
+ * @return const char* Interned string, NULL for ATOM_NONE
+ */
+const char * atom_name(Atom atom) {
+    if (atom < ATOM_BUILTIN_COUNT) {
+        return atom_builtin_names[atom];
+    }
+    SDL_AtomicLock(&atom_lock);
+    const char * name = atom < atom_count ? atom_names[atom] : NULL;
+    SDL_AtomicUnlock(&atom_lock);
+    return name;
+}
+
+/**
+ * @brief Free all interned strings, atoms handed out before are no longer valid
+ */
+void atom_quit(void) {
+    SDL_AtomicLock(&atom_lock);
+    if (atom_table != NULL) {
+        hashmap_free(atom_table);
+        atom_table = NULL;
+    }
+    free(atom_names);
+    atom_names = NULL;
+    atom_count = 0;
+    atom_capacity = 0;
+    arena_free(&atom_arena);
+    SDL_AtomicUnlock(&atom_lock);
+}
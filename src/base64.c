@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <string.h>
+#include "base64.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE64_SSSE3 1
+#endif
+
+#define BASE64_INVALID 0xff
+
+// Maps characters to their 6 bit value, BASE64_INVALID for characters outside the alphabet
+static const uint8_t base64_table[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+#ifdef BASE64_SSSE3
+/**
+ * @brief Decode 16 characters into 12 bytes per iteration
+ *
+ * Characters are mapped to their 6 bit values with range compares, then packed
+ * with two multiply-adds and a shuffle. Stops at the first block that holds a
+ * character outside the alphabet, such as padding, and leaves it to the scalar
+ * decoder. Writes 16 bytes per block, so out needs 4 bytes of slack.
+ *
+ * @return size_t Number of characters consumed, always a multiple of 16
+ */
+__attribute__((target("ssse3")))
+static size_t base64_decode_ssse3(const char * in, size_t length, uint8_t * out, size_t capacity) {
+    size_t consumed = 0;
+    while (length - consumed >= 16 && (consumed / 4) * 3 + 16 <= capacity) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + consumed));
+        // Bytes above 0x7f are negative and fall outside every range
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            break;
+        }
+        __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-65));
+        shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(-71)));
+        shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(4)));
+        shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(19)));
+        shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(16)));
+        __m128i values = _mm_add_epi8(c, shift);
+        // Pack four 6 bit values into 24 bits per 32 bit lane
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i lanes = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        __m128i bytes = _mm_shuffle_epi8(lanes, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)(out + (consumed / 4) * 3), bytes);
+        consumed += 16;
+    }
+    return consumed;
+}
+#endif
+
+/**
+ * @brief Decode base64 data
+ *
+ * @param in Base64 characters, padding is optional
+ * @param length Number of characters
+ * @param out Output buffer
+ * @param capacity Size of the output buffer in bytes
+ * @param written Number of bytes decoded
+ * @return false when the input is not valid base64 or does not fit
+ */
+bool base64_decode(const char * in, size_t length, uint8_t * out, size_t capacity, size_t * written) {
+    // Padding only ever shows up at the end
+    while (length > 0 && in[length - 1] == '=') {
+        length--;
+    }
+    if (length % 4 == 1) {
+        return false;
+    }
+    size_t consumed = 0;
+#ifdef BASE64_SSSE3
+    if (__builtin_cpu_supports("ssse3")) {
+        consumed = base64_decode_ssse3(in, length, out, capacity);
+    }
+#endif
+    size_t o = (consumed / 4) * 3;
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (size_t i = consumed; i < length; i++) {
+        uint8_t value = base64_table[(uint8_t)in[i]];
+        if (value == BASE64_INVALID) {
+            return false;
+        }
+        accumulator = (accumulator << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (o >= capacity) {
+                return false;
+            }
+            out[o++] = accumulator >> bits;
+        }
+    }
+    *written = o;
+    return true;
+}
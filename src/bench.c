@@ -0,0 +1,238 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "draw.h"
+#include "pacing.h"
+#include "profile.h"
+#include "resolution.h"
+
+// Logging
+#include <log.h>
+
+typedef struct BenchStep
+{
+    SDL_Scancode key; // SDL_SCANCODE_UNKNOWN stands still
+    int frames;
+} BenchStep;
+
+static bool bench_enabled;
+static char * bench_map_name = BENCH_DEFAULT_MAP;
+static const char * bench_output;
+static int bench_frames = BENCH_DEFAULT_FRAMES;
+static BenchStep * bench_steps;
+static size_t bench_step_count;
+static int bench_path_frames; // Length of one loop of the path
+static int bench_frame;
+static Uint64 * bench_frame_times;
+static Uint64 bench_start;
+static Uint64 bench_frame_start;
+static long bench_draw_calls;
+static double bench_scale_sum; // Resolution scale of every frame added up
+
+static void bench_parse_path(const char * path) {
+    size_t capacity = 0;
+    bench_step_count = 0;
+    while (*path != '\0') {
+        char direction;
+        int frames;
+        int length;
+        if (sscanf(path, "%c%d%n", &direction, &frames, &length) != 2 || frames <= 0) {
+            log_error("Failed to parse bench path at %s", path);
+            exit(1);
+        }
+        SDL_Scancode key;
+        switch (direction) {
+            case 'U': key = SDL_SCANCODE_UP; break;
+            case 'D': key = SDL_SCANCODE_DOWN; break;
+            case 'L': key = SDL_SCANCODE_LEFT; break;
+            case 'R': key = SDL_SCANCODE_RIGHT; break;
+            case 'S': key = SDL_SCANCODE_UNKNOWN; break;
+            default:
+                log_error("Unknown bench path direction %c", direction);
+                exit(1);
+        }
+        if (bench_step_count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            bench_steps = realloc(bench_steps, capacity * sizeof(BenchStep));
+            if (bench_steps == NULL) {
+                log_error("Failed to allocate bench path");
+                exit(1);
+            }
+        }
+        bench_steps[bench_step_count++] = (BenchStep){key, frames};
+        bench_path_frames += frames;
+        path += length;
+        if (*path == ',') {
+            path++;
+        }
+    }
+    if (bench_step_count == 0) {
+        log_error("Bench path is empty");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Read the command line, everything but --bench needs a value
+ *
+ * --profile, --pacing and --resolution work with and without --bench.
+ *
+ * @return true The game runs as a benchmark
+ */
+bool bench_init(int argc, char * argv[]) {
+    const char * path = BENCH_DEFAULT_PATH;
+    bool resolution = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench_enabled = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "--map") == 0) {
+            bench_map_name = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+            bench_frames = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--path") == 0) {
+            path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--output") == 0) {
+            bench_output = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--profile") == 0) {
+            profile_set_output(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--pacing") == 0) {
+            if (!pacing_parse(argv[++i])) {
+                log_error("Pacing %s is not vsync, uncapped or a frame rate", argv[i]);
+                exit(1);
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "--resolution") == 0) {
+            if (!resolution_parse(argv[++i])) {
+                log_error("Resolution %s is not dynamic or fixed", argv[i]);
+                exit(1);
+            }
+            resolution = true;
+        } else {
+            log_error("Unknown argument %s", argv[i]);
+            exit(1);
+        }
+    }
+    if (!bench_enabled) {
+        return false;
+    }
+    if (bench_frames <= 0) {
+        log_error("Bench needs at least one frame");
+        exit(1);
+    }
+    // Frames are never held back, the frame rate is what is measured
+    pacing_parse("uncapped");
+    // Runs are compared at the same resolution unless asked otherwise
+    if (!resolution) {
+        resolution_parse("fixed");
+    }
+    bench_parse_path(path);
+    bench_frame_times = malloc(bench_frames * sizeof(Uint64));
+    if (bench_frame_times == NULL) {
+        log_error("Failed to allocate bench frame times");
+        exit(1);
+    }
+    return true;
+}
+
+/**
+ * @brief Asset name of the map the benchmark starts on
+ */
+char * bench_map(void) {
+    return bench_map_name;
+}
+
+/**
+ * @brief Start timing a frame and press the keys of the path
+ *
+ * @param app
+ * @return true Keep running, false when every frame was measured
+ */
+bool bench_frame_begin(App * app) {
+    if (bench_frame == bench_frames) {
+        return false;
+    }
+    // Step of the path this frame falls on
+    int offset = bench_frame % bench_path_frames;
+    BenchStep * step = bench_steps;
+    while (offset >= step->frames) {
+        offset -= step->frames;
+        step++;
+    }
+    app->keyboard[SDL_SCANCODE_UP] = 0;
+    app->keyboard[SDL_SCANCODE_DOWN] = 0;
+    app->keyboard[SDL_SCANCODE_LEFT] = 0;
+    app->keyboard[SDL_SCANCODE_RIGHT] = 0;
+    app->keyboard[step->key] = step->key != SDL_SCANCODE_UNKNOWN;
+
+    bench_frame_start = SDL_GetPerformanceCounter();
+    if (bench_frame == 0) {
+        bench_start = bench_frame_start;
+        draw_take_call_count();
+    }
+    return true;
+}
+
+void bench_frame_end(void) {
+    bench_frame_times[bench_frame++] = SDL_GetPerformanceCounter() - bench_frame_start;
+    bench_draw_calls += draw_take_call_count();
+    bench_scale_sum += resolution_scale();
+}
+
+static int bench_compare_times(const void * a, const void * b) {
+    Uint64 x = *(const Uint64 *)a;
+    Uint64 y = *(const Uint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted frame times in milliseconds
+static double bench_percentile(double fraction) {
+    size_t rank = (size_t)(fraction * bench_frame + 0.5);
+    rank = SDL_clamp(rank, 1, (size_t)bench_frame);
+    return bench_frame_times[rank - 1] * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Write the results as JSON to the --output file, or stdout without one
+ */
+void bench_write(void) {
+    double frequency = SDL_GetPerformanceFrequency();
+    double seconds = (SDL_GetPerformanceCounter() - bench_start) / frequency;
+    qsort(bench_frame_times, bench_frame, sizeof(Uint64), bench_compare_times);
+
+    FILE * file = bench_output != NULL ? fopen(bench_output, "w") : stdout;
+    if (file == NULL) {
+        log_error("Failed to open bench output %s", bench_output);
+        exit(1);
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"map\": \"%s\",\n", bench_map_name);
+    fprintf(file, "  \"renderer\": \"software\",\n");
+    fprintf(file, "  \"frames\": %d,\n", bench_frame);
+    fprintf(file, "  \"seconds\": %.3f,\n", seconds);
+    fprintf(file, "  \"fps\": %.1f,\n", bench_frame / seconds);
+    fprintf(file, "  \"draw_calls_per_frame\": %.1f,\n", (double)bench_draw_calls / bench_frame);
+    fprintf(file, "  \"resolution_scale\": %.3f,\n", bench_scale_sum / bench_frame);
+    fprintf(file, "  \"frame_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            bench_percentile(0.50), bench_percentile(0.95), bench_percentile(0.99), bench_percentile(1.0));
+    fprintf(file, "  \"stage_ms\": {");
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        fprintf(file, "%s\"%s\": %.3f", i > 0 ? ", " : "", profile_stage_name(i), profile_stage_total(i));
+    }
+    fprintf(file, "}\n}\n");
+    if (file != stdout) {
+        fclose(file);
+    }
+    log_info("Bench ran %d frames at %.1f fps", bench_frame, bench_frame / seconds);
+}
+
+void bench_quit(void) {
+    free(bench_steps);
+    free(bench_frame_times);
+    bench_steps = NULL;
+    bench_frame_times = NULL;
+    bench_step_count = 0;
+    bench_path_frames = 0;
+    bench_frame = 0;
+    bench_scale_sum = 0;
+}
@@ -0,0 +1,217 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <hashmap.h>
+#include "atom.h"
+#include "chunk.h"
+
+// Logging
+#include <log.h>
+
+typedef struct ChunkEntry
+{
+    int col; // Position on the chunk grid
+    int row;
+    Chunk *chunk;
+} ChunkEntry;
+
+static uint64_t chunk_entry_hash(const void * item, uint64_t seed0, uint64_t seed1) {
+    const ChunkEntry * entry = item;
+    int position[2] = {entry->col, entry->row};
+    return hashmap_sip(position, sizeof(position), seed0, seed1);
+}
+
+static int chunk_entry_compare(const void * a, const void * b, void * udata) {
+    const ChunkEntry * entry_a = a;
+    const ChunkEntry * entry_b = b;
+    if (entry_a->col != entry_b->col) {
+        return entry_a->col < entry_b->col ? -1 : 1;
+    }
+    if (entry_a->row != entry_b->row) {
+        return entry_a->row < entry_b->row ? -1 : 1;
+    }
+    return 0;
+}
+
+// Chunks of base64 compressed layers keep the compressed data from the map file, all others are packed with zlib
+static const char * chunk_compression(Layer * layer) {
+    if (layer->compression != NULL && layer->compression[0] != '\0') {
+        return layer->compression;
+    }
+    return "zlib";
+}
+
+int chunk_floor_div(int value, int size) {
+    int quotient = value / size;
+    if (value % size != 0 && (value < 0) != (size < 0)) {
+        quotient--;
+    }
+    return quotient;
+}
+
+/**
+ * @brief Compress decoded gids into the packed chunk data
+ *
+ * @param arena Arena of the map the packed data is allocated from
+ * @param layer
+ * @param chunk
+ * @param gids width*height gids, byte swapped in place on big-endian hosts
+ */
+void chunk_pack(Arena * arena, Layer * layer, Chunk * chunk, uint32_t * gids) {
+    size_t count = (size_t)chunk->width * chunk->height;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    for (size_t i = 0; i < count; i++) {
+        gids[i] = SDL_SwapLE32(gids[i]);
+    }
+#endif
+    uLongf packed_size = compressBound(count * sizeof(uint32_t));
+    uLongf bound = packed_size;
+    chunk->packed = arena_alloc(arena, bound);
+    if (compress2(chunk->packed, &packed_size, (const Bytef *)gids, count * sizeof(uint32_t), Z_BEST_SPEED) != Z_OK) {
+        log_error("Failed to compress chunk %d,%d of layer %s", chunk->x, chunk->y, atom_name(layer->name));
+        exit(1);
+    }
+    chunk->packed = arena_realloc(arena, chunk->packed, bound, packed_size);
+    chunk->packed_size = packed_size;
+}
+
+/**
+ * @brief Index the chunks of a layer by their position on the chunk grid
+ *
+ * All chunks of a layer have the same size and are aligned to it, like Tiled writes them.
+ *
+ * @param layer
+ */
+void chunk_table_build(Layer * layer) {
+    if (layer->array_count == 0) {
+        return;
+    }
+    layer->chunkwidth = layer->array[0].width;
+    layer->chunkheight = layer->array[0].height;
+    layer->chunk_table = hashmap_new(sizeof(ChunkEntry), layer->array_count, 0, 0, chunk_entry_hash, chunk_entry_compare, NULL, NULL);
+    if (layer->chunk_table == NULL) {
+        log_error("Failed to allocate chunk table");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < layer->array_count; i++) {
+        Chunk * chunk = &layer->array[i];
+        if (chunk->width != layer->chunkwidth || chunk->height != layer->chunkheight ||
+            chunk->x % layer->chunkwidth != 0 || chunk->y % layer->chunkheight != 0) {
+            log_error("Chunk %d,%d of layer %s is not aligned to the %dx%d chunk grid", chunk->x, chunk->y, atom_name(layer->name), layer->chunkwidth, layer->chunkheight);
+            exit(1);
+        }
+        ChunkEntry entry = {
+            .col = chunk_floor_div(chunk->x, layer->chunkwidth),
+            .row = chunk_floor_div(chunk->y, layer->chunkheight),
+            .chunk = chunk,
+        };
+        if (hashmap_set(layer->chunk_table, &entry) != NULL) {
+            log_error("Duplicate chunk %d,%d in layer %s", chunk->x, chunk->y, atom_name(layer->name));
+            exit(1);
+        }
+    }
+    layer->resident = (SDL_Rect){0, 0, 0, 0};
+}
+
+Chunk * chunk_find(Layer * layer, int chunk_col, int chunk_row) {
+    if (layer->chunk_table == NULL) {
+        return NULL;
+    }
+    const ChunkEntry * entry = hashmap_get(layer->chunk_table, &(ChunkEntry){.col = chunk_col, .row = chunk_row});
+    return entry != NULL ? entry->chunk : NULL;
+}
+
+/**
+ * @brief Get the gids of a chunk, decoding it when it is not resident
+ *
+ * @param layer
+ * @param chunk
+ * @return uint32_t* width*height gids
+ */
+uint32_t * chunk_data(Layer * layer, Chunk * chunk) {
+    if (chunk->data != NULL) {
+        return chunk->data;
+    }
+    size_t count = (size_t)chunk->width * chunk->height;
+    chunk->data = malloc(count * sizeof(uint32_t));
+    if (chunk->data == NULL) {
+        log_error("Failed to allocate chunk data");
+        exit(1);
+    }
+    map_decompress_tile_data(chunk->packed, chunk->packed_size, chunk_compression(layer), chunk->data, count);
+    return chunk->data;
+}
+
+uint32_t chunk_get_tile_id(Layer * layer, int col, int row) {
+    Chunk * chunk = chunk_find(layer, chunk_floor_div(col, layer->chunkwidth), chunk_floor_div(row, layer->chunkheight));
+    if (chunk == NULL) {
+        return 0;
+    }
+    uint32_t * data = chunk_data(layer, chunk);
+    return data[(col - chunk->x) + (row - chunk->y) * chunk->width];
+}
+
+/**
+ * @brief Decode the chunks around the camera and evict the ones that moved out of range
+ *
+ * Chunks are only walked when the camera crosses into another chunk.
+ *
+ * @param map
+ * @param camera
+ */
+void chunk_stream(Map * map, Camera * camera) {
+    int first_col = floorf(camera->x / map->tilewidth);
+    int first_row = floorf(camera->y / map->tileheight);
+    int last_col = floorf((camera->x + camera->width - 1) / map->tilewidth);
+    int last_row = floorf((camera->y + camera->height - 1) / map->tileheight);
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        if (layer->chunk_table == NULL) {
+            continue;
+        }
+        SDL_Rect window;
+        window.x = chunk_floor_div(first_col, layer->chunkwidth) - map->chunk_radius;
+        window.y = chunk_floor_div(first_row, layer->chunkheight) - map->chunk_radius;
+        window.w = chunk_floor_div(last_col, layer->chunkwidth) + map->chunk_radius - window.x + 1;
+        window.h = chunk_floor_div(last_row, layer->chunkheight) + map->chunk_radius - window.y + 1;
+        if (SDL_RectEquals(&window, &layer->resident)) {
+            continue;
+        }
+        int decoded = 0;
+        int evicted = 0;
+        for (uint32_t j = 0; j < layer->array_count; j++) {
+            Chunk * chunk = &layer->array[j];
+            SDL_Point position = {chunk_floor_div(chunk->x, layer->chunkwidth), chunk_floor_div(chunk->y, layer->chunkheight)};
+            if (SDL_PointInRect(&position, &window)) {
+                if (chunk->data == NULL) {
+                    chunk_data(layer, chunk);
+                    decoded++;
+                }
+            } else if (chunk->data != NULL) {
+                free(chunk->data);
+                chunk->data = NULL;
+                evicted++;
+            }
+        }
+        layer->resident = window;
+        log_debug("Layer %s chunks decoded: %d evicted: %d", atom_name(layer->name), decoded, evicted);
+    }
+}
+
+/**
+ * @brief Free the decoded chunks and the chunk table, the chunks themselves belong to the map arena
+ *
+ * @param layer
+ */
+void chunk_free(Layer * layer) {
+    for (uint32_t i = 0; i < layer->array_count; i++) {
+        free(layer->array[i].data);
+        layer->array[i].data = NULL;
+    }
+    if (layer->chunk_table != NULL) {
+        hashmap_free(layer->chunk_table);
+        layer->chunk_table = NULL;
+    }
+}
@@ -1,9 +1,15 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <limits.h>
 #include "draw.h"
 #include "structs.h"
 #include "player.h"
 
+static int draw_calls;
+static bool draw_dirty = true;
+// Interpolated camera position the scene was last drawn at
+static SDL_Point draw_camera_drawn = {INT_MIN, INT_MIN};
+
 void draw_prepare_scene(App * app, SDL_Texture * target)
 {
 	SDL_SetRenderTarget(app->renderer, target);
@@ -11,6 +17,14 @@ void draw_prepare_scene(App * app, SDL_Texture * target)
 	SDL_RenderClear(app->renderer);
 }
 
+/**
+ * @brief Start drawing the scene into the target of a camera, in world pixels whatever its scale
+ */
+void draw_prepare_camera(App * app, Camera * camera) {
+    draw_prepare_scene(app, camera->target);
+    SDL_RenderSetScale(app->renderer, camera->scale, camera->scale);
+}
+
 Camera make_camera(App *app, int width, int height) {
     Camera camera = {
         .renderer = app->renderer,
@@ -20,6 +34,7 @@ Camera make_camera(App *app, int width, int height) {
         .height = height,
         .target_width = width + CAMERA_BORDER * 2,
         .target_height = height + CAMERA_BORDER * 2,
+        .scale = 1.0f,
     };
     camera.target = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET,
                                       camera.target_width, camera.target_height);
@@ -37,31 +52,111 @@ void draw_camera_to_screen(App *app, Camera *camera) {
         float correction_x = (int)camera->x - camera->x;
         float correction_y = (int)camera->y - camera->y;
 
+        // A scaled down target is rounded up to whole pixels, stretch all of them
+        int width, height;
+        SDL_QueryTexture(camera->target, NULL, NULL, &width, &height);
         SDL_Rect dst;
         dst.x = correction_x * pixel_h - pixel_h * CAMERA_BORDER;
         dst.y = correction_y * pixel_h - pixel_h * CAMERA_BORDER;
-        dst.w = camera->target_width * pixel_h;
-        dst.h = camera->target_height * pixel_h;
+        dst.w = width / camera->scale * pixel_h;
+        dst.h = height / camera->scale * pixel_h;
 
         SDL_RenderCopy(app->renderer, camera->target, NULL, &dst);
-		SDL_RenderPresent(app->renderer);
 }
 
-void camera_update(Camera * camera, struct Entity * player, int map_width, int map_height) {
+void camera_update(Camera * camera, struct Entity * player, SDL_Rect * bounds) {
     // Center camera on map
     camera->x = player->x - (camera->width / 2) + (player->width/2);
     camera->y = player->y - (camera->height / 2) + (player->height/2);
     // Prevent camera from moving outside of map
-    if (camera->x < 0) {
-        camera->x = 0;
+    if (camera->x < bounds->x) {
+        camera->x = bounds->x;
+    }
+    if (camera->y < bounds->y) {
+        camera->y = bounds->y;
+    }
+    if (camera->x > bounds->x + bounds->w - camera->width) {
+        camera->x = bounds->x + bounds->w - camera->width;
     }
-    if (camera->y < 0) {
-        camera->y = 0;
+    if (camera->y > bounds->y + bounds->h - camera->height) {
+        camera->y = bounds->y + bounds->h - camera->height;
     }
-    if (camera->x > map_width - camera->width) {
-        camera->x = map_width - camera->width;
+}
+
+/**
+ * @brief Remember the position of the camera before a simulation tick moves it
+ */
+void camera_save_state(Camera * camera) {
+    camera->previous_x = camera->x;
+    camera->previous_y = camera->y;
+}
+
+/**
+ * @brief Place a copy of the camera between its previous and current tick
+ *
+ * Marks the scene dirty when the view moved onto another pixel, the sub pixel
+ * part is applied when the camera target is copied to the screen.
+ *
+ * @param view Receives the camera to draw with
+ * @param camera
+ * @param alpha Fraction of a tick since the current tick, 0 to 1
+ */
+void camera_interpolate(Camera * view, const Camera * camera, float alpha) {
+    *view = *camera;
+    view->x = camera->previous_x + (camera->x - camera->previous_x) * alpha;
+    view->y = camera->previous_y + (camera->y - camera->previous_y) * alpha;
+    SDL_Point drawn = {(int)view->x, (int)view->y};
+    if (drawn.x != draw_camera_drawn.x || drawn.y != draw_camera_drawn.y) {
+        draw_camera_drawn = drawn;
+        draw_mark_dirty();
     }
-    if (camera->y > map_height - camera->height) {
-        camera->y = map_height - camera->height;
+}
+
+/**
+ * @brief Have the camera target redrawn on the next frame
+ *
+ * Call whenever something in view changes: the camera, an entity, a tile or the
+ * current frame of an animation. Frames without changes present the old target.
+ */
+void draw_mark_dirty(void) {
+    draw_dirty = true;
+}
+
+/**
+ * @brief Check whether the scene has to be redrawn and reset the flag
+ */
+bool draw_take_dirty(void) {
+    bool dirty = draw_dirty;
+    draw_dirty = false;
+    return dirty;
+}
+
+/**
+ * @brief Copy a texture to the current render target, counting the draw call
+ */
+void draw_texture(SDL_Renderer * renderer, SDL_Texture * texture, const SDL_Rect * src, const SDL_Rect * dest, SDL_RendererFlip flip) {
+    draw_calls++;
+    // The software renderer copies unflipped textures much faster without the Ex path
+    if (flip == SDL_FLIP_NONE) {
+        SDL_RenderCopy(renderer, texture, src, dest);
+    } else {
+        SDL_RenderCopyEx(renderer, texture, src, dest, 0, NULL, flip);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Draw triangles from a texture to the current render target, counting the draw call
+ */
+void draw_geometry(SDL_Renderer * renderer, SDL_Texture * texture, const SDL_Vertex * vertices, int vertex_count, const int * indices, int index_count) {
+    draw_calls++;
+    SDL_RenderGeometry(renderer, texture, vertices, vertex_count, indices, index_count);
+}
+
+/**
+ * @brief Get the number of draw calls since the last call
+ */
+int draw_take_call_count(void) {
+    int count = draw_calls;
+    draw_calls = 0;
+    return count;
+}
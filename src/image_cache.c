@@ -0,0 +1,284 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "image_cache.h"
+
+// Logging
+#include <log.h>
+
+typedef struct ImageJob
+{
+    char path[MAX_FILENAME_LENGTH];
+    TileImage *image;
+    SDL_Surface *surface; // NULL when decoding failed
+    bool cancelled; // The tileset was freed, drop the surface
+    struct ImageJob *next;
+} ImageJob;
+
+static bool image_cache_ready;
+static size_t image_cache_budget;
+static size_t image_cache_used; // Bytes of the resident textures
+static uint64_t image_cache_frame; // Frames that redrew the scene, idle frames draw no images
+static SDL_Texture * image_cache_placeholder;
+static TileImage * image_cache_newest;
+static TileImage * image_cache_oldest;
+
+static SDL_Thread * image_cache_thread;
+static SDL_mutex * image_cache_mutex;
+static SDL_cond * image_cache_queued;
+static ImageJob * image_cache_queue;
+static ImageJob * image_cache_queue_tail;
+static ImageJob * image_cache_done;
+static bool image_cache_running;
+
+static int image_cache_run(void * data) {
+    SDL_LockMutex(image_cache_mutex);
+    while (true) {
+        while (image_cache_running && image_cache_queue == NULL) {
+            SDL_CondWait(image_cache_queued, image_cache_mutex);
+        }
+        if (!image_cache_running) {
+            break;
+        }
+        ImageJob * job = image_cache_queue;
+        image_cache_queue = job->next;
+        if (image_cache_queue == NULL) {
+            image_cache_queue_tail = NULL;
+        }
+        if (job->cancelled) {
+            free(job);
+            continue;
+        }
+        SDL_UnlockMutex(image_cache_mutex);
+
+        job->surface = IMG_Load(job->path);
+        if (job->surface == NULL) {
+            log_warn("Failed to load tile image %s: %s", job->path, IMG_GetError());
+        }
+
+        SDL_LockMutex(image_cache_mutex);
+        job->next = image_cache_done;
+        image_cache_done = job;
+    }
+    SDL_UnlockMutex(image_cache_mutex);
+    return 0;
+}
+
+static void image_cache_unlink(TileImage * image) {
+    if (image->newer != NULL) {
+        image->newer->older = image->older;
+    } else {
+        image_cache_newest = image->older;
+    }
+    if (image->older != NULL) {
+        image->older->newer = image->newer;
+    } else {
+        image_cache_oldest = image->newer;
+    }
+    image->newer = NULL;
+    image->older = NULL;
+}
+
+static void image_cache_link_newest(TileImage * image) {
+    image->older = image_cache_newest;
+    image->newer = NULL;
+    if (image_cache_newest != NULL) {
+        image_cache_newest->newer = image;
+    } else {
+        image_cache_oldest = image;
+    }
+    image_cache_newest = image;
+}
+
+static void image_cache_evict(TileImage * image) {
+    image_cache_unlink(image);
+    SDL_DestroyTexture(image->texture);
+    image->texture = NULL;
+    image_cache_used -= (size_t)image->width * image->height * 4;
+}
+
+/**
+ * @brief Start the decoding thread and create the placeholder
+ *
+ * @param app
+ * @param budget Bytes the resident textures may use
+ */
+void image_cache_init(App * app, size_t budget) {
+    image_cache_budget = budget;
+    image_cache_mutex = SDL_CreateMutex();
+    image_cache_queued = SDL_CreateCond();
+    if (image_cache_mutex == NULL || image_cache_queued == NULL) {
+        log_error("Failed to create image cache lock: %s", SDL_GetError());
+        exit(1);
+    }
+    // A faint box in the size of the tile
+    Uint8 pixel[4] = {255, 255, 255, 48};
+    image_cache_placeholder = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, 1, 1);
+    if (image_cache_placeholder == NULL) {
+        log_error("Failed to create image placeholder: %s", SDL_GetError());
+        exit(1);
+    }
+    SDL_UpdateTexture(image_cache_placeholder, NULL, pixel, sizeof(pixel));
+    SDL_SetTextureBlendMode(image_cache_placeholder, SDL_BLENDMODE_BLEND);
+    image_cache_running = true;
+    image_cache_thread = SDL_CreateThread(image_cache_run, "image loader", NULL);
+    if (image_cache_thread == NULL) {
+        log_error("Failed to create image loader thread: %s", SDL_GetError());
+        exit(1);
+    }
+    image_cache_ready = true;
+}
+
+/**
+ * @brief Stop the thread, the tilesets have to be freed first
+ */
+void image_cache_quit(void) {
+    if (!image_cache_ready) {
+        return;
+    }
+    SDL_LockMutex(image_cache_mutex);
+    image_cache_running = false;
+    SDL_CondSignal(image_cache_queued);
+    SDL_UnlockMutex(image_cache_mutex);
+    SDL_WaitThread(image_cache_thread, NULL);
+    image_cache_thread = NULL;
+    ImageJob * lists[2] = {image_cache_queue, image_cache_done};
+    for (int i = 0; i < 2; i++) {
+        while (lists[i] != NULL) {
+            ImageJob * job = lists[i];
+            lists[i] = job->next;
+            SDL_FreeSurface(job->surface);
+            free(job);
+        }
+    }
+    image_cache_queue = image_cache_queue_tail = image_cache_done = NULL;
+    while (image_cache_oldest != NULL) {
+        image_cache_evict(image_cache_oldest);
+    }
+    SDL_DestroyTexture(image_cache_placeholder);
+    image_cache_placeholder = NULL;
+    SDL_DestroyCond(image_cache_queued);
+    SDL_DestroyMutex(image_cache_mutex);
+    image_cache_queued = NULL;
+    image_cache_mutex = NULL;
+    image_cache_ready = false;
+}
+
+/**
+ * @brief Turn decoded images into textures and evict textures over the budget, call once per frame
+ *
+ * Images drawn by the last redraw are never evicted, idle frames still show
+ * them from the camera target. The budget can be exceeded while more of them
+ * are in view than fit.
+ *
+ * @param app
+ */
+void image_cache_update(App * app) {
+    if (!image_cache_ready) {
+        return;
+    }
+    SDL_LockMutex(image_cache_mutex);
+    ImageJob * done = image_cache_done;
+    image_cache_done = NULL;
+    SDL_UnlockMutex(image_cache_mutex);
+    while (done != NULL) {
+        ImageJob * job = done;
+        done = job->next;
+        if (!job->cancelled) {
+            TileImage * image = job->image;
+            image->job = NULL;
+            if (job->surface != NULL) {
+                image->texture = SDL_CreateTextureFromSurface(app->renderer, job->surface);
+            }
+            if (image->texture != NULL) {
+                SDL_SetTextureBlendMode(image->texture, SDL_BLENDMODE_BLEND);
+                image->width = job->surface->w;
+                image->height = job->surface->h;
+                image_cache_used += (size_t)image->width * image->height * 4;
+                // It was requested by the last redraw, count it as drawn there so it survives until the next one
+                image->drawn = image_cache_frame;
+                image_cache_link_newest(image);
+                draw_mark_dirty();
+                log_debug("Streamed in %s, %zu of %zu bytes used", image->path, image_cache_used, image_cache_budget);
+            } else {
+                image->failed = true;
+            }
+        }
+        SDL_FreeSurface(job->surface);
+        free(job);
+    }
+    while (image_cache_used > image_cache_budget && image_cache_oldest != NULL && image_cache_oldest->drawn < image_cache_frame) {
+        log_debug("Evicted %s", image_cache_oldest->path);
+        image_cache_evict(image_cache_oldest);
+    }
+}
+
+/**
+ * @brief Start a frame that redraws the scene, images it does not draw may be evicted after it
+ */
+void image_cache_redraw(void) {
+    image_cache_frame++;
+}
+
+/**
+ * @brief Get the texture to draw an image with, requesting it when it is not resident
+ *
+ * @param image
+ * @param src Receives the part of the texture to draw
+ * @return SDL_Texture* The placeholder while the image loads, NULL without image_cache_init() or when it failed to load
+ */
+SDL_Texture * image_cache_texture(TileImage * image, SDL_Rect * src) {
+    if (!image_cache_ready || image->failed) {
+        return NULL;
+    }
+    if (image->texture != NULL) {
+        if (image != image_cache_newest) {
+            image_cache_unlink(image);
+            image_cache_link_newest(image);
+        }
+        image->drawn = image_cache_frame;
+        *src = (SDL_Rect){0, 0, image->width, image->height};
+        return image->texture;
+    }
+    if (image->job == NULL) {
+        ImageJob * job = calloc(1, sizeof(ImageJob));
+        if (job == NULL) {
+            log_error("Failed to allocate image job");
+            exit(1);
+        }
+        snprintf(job->path, sizeof(job->path), "%s", image->path);
+        job->image = image;
+        image->job = job;
+        SDL_LockMutex(image_cache_mutex);
+        if (image_cache_queue_tail != NULL) {
+            image_cache_queue_tail->next = job;
+        } else {
+            image_cache_queue = job;
+        }
+        image_cache_queue_tail = job;
+        SDL_CondSignal(image_cache_queued);
+        SDL_UnlockMutex(image_cache_mutex);
+    }
+    *src = (SDL_Rect){0, 0, 1, 1};
+    return image_cache_placeholder;
+}
+
+/**
+ * @brief Drop the texture and pending decode of an image before its tileset is freed
+ */
+void image_cache_forget(TileImage * image) {
+    if (!image_cache_ready) {
+        return;
+    }
+    if (image->job != NULL) {
+        SDL_LockMutex(image_cache_mutex);
+        image->job->cancelled = true;
+        SDL_UnlockMutex(image_cache_mutex);
+        image->job = NULL;
+    }
+    if (image->texture != NULL) {
+        image_cache_evict(image);
+    }
+}
@@ -5,7 +5,14 @@
 // Logging
 #include <log.h>
 
-void init_sdl(App * app)
+/**
+ * @brief Open the window and renderer
+ *
+ * @param app
+ * @param headless Use the dummy video driver and the software renderer without vsync,
+ *                 unless SDL_VIDEODRIVER picks another driver
+ */
+void init_sdl(App * app, bool headless)
 {
 	int rendererFlags, windowFlags;
 
@@ -13,6 +20,13 @@ void init_sdl(App * app)
 
 	windowFlags = 0;
 
+	if (headless)
+	{
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+		rendererFlags = SDL_RENDERER_SOFTWARE;
+		windowFlags = SDL_WINDOW_HIDDEN;
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0)
 	{
 		log_error("Couldn't initialize SDL: %s\n", SDL_GetError());
@@ -39,7 +39,7 @@ void input_handle(App * app)
 		switch (app->event.type)
 		{
 			case SDL_QUIT:
-				exit(0);
+				app->quit = true;
 				break;
 
 			case SDL_KEYDOWN:
@@ -0,0 +1,552 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "json.h"
+
+// Logging
+#include <log.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define JSON_SWAR_DIGITS 1
+#endif
+
+/**
+ * @brief Read a whole file into a buffer that is padded for the reader
+ *
+ * @param filename
+ * @param size Size of the file in bytes, without padding
+ * @return char* Buffer owned by the caller or NULL when the file could not be read
+ */
+char * json_read_file(const char * filename, size_t * size) {
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (fsize < 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    char *buffer = malloc(fsize + JSON_PADDING);
+    if (buffer == NULL) {
+        log_error("Failed to allocate buffer for %s", filename);
+        exit(1);
+    }
+    if (fread(buffer, 1, fsize, fp) != (size_t)fsize) {
+        fclose(fp);
+        free(buffer);
+        return NULL;
+    }
+    fclose(fp);
+    memset(buffer + fsize, 0, JSON_PADDING);
+    *size = fsize;
+    return buffer;
+}
+
+void json_reader_init(JsonReader * reader, char * buffer, size_t size) {
+    reader->cursor = buffer;
+    reader->end = buffer + size;
+    reader->error = false;
+    reader->arena = NULL;
+}
+
+static inline bool json_is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static void json_skip_space(JsonReader * reader) {
+    while (reader->cursor < reader->end && json_is_space(*reader->cursor)) {
+        reader->cursor++;
+    }
+}
+
+static bool json_fail(JsonReader * reader) {
+    reader->error = true;
+    return false;
+}
+
+static bool json_expect(JsonReader * reader, char c) {
+    json_skip_space(reader);
+    if (reader->error || reader->cursor >= reader->end || *reader->cursor != c) {
+        return json_fail(reader);
+    }
+    reader->cursor++;
+    return true;
+}
+
+JsonType json_peek(JsonReader * reader) {
+    json_skip_space(reader);
+    if (reader->error || reader->cursor >= reader->end) {
+        return JSON_TYPE_NONE;
+    }
+    switch (*reader->cursor) {
+        case '{':
+            return JSON_TYPE_OBJECT;
+        case '[':
+            return JSON_TYPE_ARRAY;
+        case '"':
+            return JSON_TYPE_STRING;
+        case 't':
+        case 'f':
+            return JSON_TYPE_BOOL;
+        case 'n':
+            return JSON_TYPE_NULL;
+        case '-':
+            return JSON_TYPE_NUMBER;
+        default:
+            if (*reader->cursor >= '0' && *reader->cursor <= '9') {
+                return JSON_TYPE_NUMBER;
+            }
+            return JSON_TYPE_NONE;
+    }
+}
+
+bool json_object_begin(JsonReader * reader) {
+    return json_expect(reader, '{');
+}
+
+/**
+ * @brief Advance to the next key of the current object
+ *
+ * The value of the returned key has to be read or skipped before calling this again.
+ *
+ * @return false at the end of the object or on error
+ */
+bool json_object_next(JsonReader * reader, const char ** key) {
+    json_skip_space(reader);
+    if (reader->error) {
+        return false;
+    }
+    if (reader->cursor < reader->end && *reader->cursor == ',') {
+        reader->cursor++;
+        json_skip_space(reader);
+    }
+    if (reader->cursor < reader->end && *reader->cursor == '}') {
+        reader->cursor++;
+        return false;
+    }
+    char * k = NULL;
+    if (!json_read_string(reader, &k) || !json_expect(reader, ':')) {
+        return false;
+    }
+    *key = k;
+    return true;
+}
+
+bool json_array_begin(JsonReader * reader) {
+    return json_expect(reader, '[');
+}
+
+/**
+ * @brief Check if the current array has another element
+ *
+ * The element has to be read or skipped before calling this again.
+ *
+ * @return false at the end of the array or on error
+ */
+bool json_array_next(JsonReader * reader) {
+    json_skip_space(reader);
+    if (reader->error) {
+        return false;
+    }
+    if (reader->cursor < reader->end && *reader->cursor == ',') {
+        reader->cursor++;
+        json_skip_space(reader);
+    }
+    if (reader->cursor >= reader->end) {
+        return json_fail(reader);
+    }
+    if (*reader->cursor == ']') {
+        reader->cursor++;
+        return false;
+    }
+    return true;
+}
+
+static int json_hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool json_read_hex4(const char * p, uint32_t * value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = json_hex_value(p[i]);
+        if (digit < 0) {
+            return false;
+        }
+        *value = (*value << 4) | digit;
+    }
+    return true;
+}
+
+static char * json_write_utf8(char * out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        *out++ = codepoint;
+    } else if (codepoint < 0x800) {
+        *out++ = 0xc0 | (codepoint >> 6);
+        *out++ = 0x80 | (codepoint & 0x3f);
+    } else if (codepoint < 0x10000) {
+        *out++ = 0xe0 | (codepoint >> 12);
+        *out++ = 0x80 | ((codepoint >> 6) & 0x3f);
+        *out++ = 0x80 | (codepoint & 0x3f);
+    } else {
+        *out++ = 0xf0 | (codepoint >> 18);
+        *out++ = 0x80 | ((codepoint >> 12) & 0x3f);
+        *out++ = 0x80 | ((codepoint >> 6) & 0x3f);
+        *out++ = 0x80 | (codepoint & 0x3f);
+    }
+    return out;
+}
+
+/**
+ * @brief Read a string in place
+ *
+ * The string is unescaped and NUL-terminated inside the reader buffer.
+ */
+bool json_read_string(JsonReader * reader, char ** value) {
+    json_skip_space(reader);
+    if (reader->error || reader->cursor >= reader->end || *reader->cursor != '"') {
+        return json_fail(reader);
+    }
+    char * start = ++reader->cursor;
+    char * in = start;
+    // Strings without escapes are terminated where they are
+    while (in < reader->end && *in != '"' && *in != '\\') {
+        in++;
+    }
+    char * out = in;
+    while (in < reader->end && *in != '"') {
+        if (*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+        in++;
+        switch (*in) {
+            case '"':
+            case '\\':
+            case '/':
+                *out++ = *in;
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'u': {
+                uint32_t codepoint;
+                if (!json_read_hex4(in + 1, &codepoint)) {
+                    return json_fail(reader);
+                }
+                in += 4;
+                // Combine surrogate pairs
+                uint32_t low;
+                if (codepoint >= 0xd800 && codepoint < 0xdc00 && in[1] == '\\' && in[2] == 'u' && json_read_hex4(in + 3, &low) && low >= 0xdc00 && low < 0xe000) {
+                    codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                    in += 6;
+                }
+                out = json_write_utf8(out, codepoint);
+                break;
+            }
+            default:
+                return json_fail(reader);
+        }
+        in++;
+    }
+    if (in >= reader->end) {
+        return json_fail(reader);
+    }
+    *out = '\0';
+    reader->cursor = in + 1;
+    *value = start;
+    return true;
+}
+
+/**
+ * @brief Read a string into a newly allocated copy owned by the caller or the reader arena
+ */
+bool json_read_string_copy(JsonReader * reader, char ** value) {
+    char * string;
+    if (!json_read_string(reader, &string)) {
+        return false;
+    }
+    if (reader->arena != NULL) {
+        *value = arena_strdup(reader->arena, string);
+        return true;
+    }
+    *value = calloc(strlen(string) + 1, sizeof(char));
+    if (*value == NULL) {
+        log_error("Failed to allocate string");
+        exit(1);
+    }
+    strcpy(*value, string);
+    return true;
+}
+
+/**
+ * @brief Read a string and intern it
+ */
+bool json_read_atom(JsonReader * reader, Atom * value) {
+    char * string;
+    if (!json_read_string(reader, &string)) {
+        return false;
+    }
+    *value = atom_intern(string);
+    return true;
+}
+
+bool json_read_number(JsonReader * reader, double * value) {
+    if (json_peek(reader) != JSON_TYPE_NUMBER) {
+        return json_fail(reader);
+    }
+    char * end;
+    *value = strtod(reader->cursor, &end);
+    if (end == reader->cursor || end > reader->end) {
+        return json_fail(reader);
+    }
+    reader->cursor = end;
+    return true;
+}
+
+bool json_read_int(JsonReader * reader, int * value) {
+    double number;
+    if (!json_read_number(reader, &number)) {
+        return false;
+    }
+    *value = (int)number;
+    return true;
+}
+
+bool json_read_bool(JsonReader * reader, bool * value) {
+    json_skip_space(reader);
+    if (reader->end - reader->cursor >= 4 && strncmp(reader->cursor, "true", 4) == 0) {
+        reader->cursor += 4;
+        *value = true;
+        return true;
+    }
+    if (reader->end - reader->cursor >= 5 && strncmp(reader->cursor, "false", 5) == 0) {
+        reader->cursor += 5;
+        *value = false;
+        return true;
+    }
+    return json_fail(reader);
+}
+
+// Length of the run of ASCII digits at p, at most 16. Needs 16 readable bytes at p.
+static inline size_t json_digit_count(const char * p) {
+#ifdef __SSE2__
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i digits = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+    // Bytes are digits when they are unsigned <= 9 after subtracting '0'
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    unsigned mask = _mm_movemask_epi8(is_digit);
+    return __builtin_ctz(~mask);
+#else
+    size_t count = 0;
+    while (count < 16 && (unsigned char)(p[count] - '0') <= 9) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+#ifdef JSON_SWAR_DIGITS
+// Convert 8 ASCII digits loaded as a little-endian word in three multiplications
+static inline uint32_t json_parse_eight_digits(uint64_t chunk) {
+    const uint64_t mask = 0x000000ff000000ff;
+    const uint64_t mul1 = 0x000f424000000064; // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return chunk;
+}
+#endif
+
+static inline uint64_t json_parse_digits(const char * p, size_t count) {
+#ifdef JSON_SWAR_DIGITS
+    uint64_t chunk;
+    if (count < 8) {
+        // Left pad with '0' so the digits fill a whole word
+        memcpy(&chunk, p, sizeof(chunk));
+        chunk = (chunk << (8 * (8 - count))) | (0x3030303030303030 >> (8 * count));
+        return json_parse_eight_digits(chunk);
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < count - 8; i++) {
+        value = value * 10 + (p[i] - '0');
+    }
+    memcpy(&chunk, p + count - 8, sizeof(chunk));
+    return value * 100000000 + json_parse_eight_digits(chunk);
+#else
+    uint64_t value = 0;
+    for (size_t i = 0; i < count; i++) {
+        value = value * 10 + (p[i] - '0');
+    }
+    return value;
+#endif
+}
+
+/**
+ * @brief Decode an array of unsigned 32 bit integers straight into a buffer
+ *
+ * The full 32 bit range is kept, so gids with flip flags set survive.
+ *
+ * @param values Buffer to decode into, grown with realloc or in the reader arena when needed
+ * @param capacity Capacity of values in elements, updated when the buffer grows
+ * @return size_t Number of values read
+ */
+size_t json_read_uint32_array(JsonReader * reader, uint32_t ** values, size_t * capacity) {
+    if (!json_array_begin(reader)) {
+        return 0;
+    }
+    size_t count = 0;
+    char * p = reader->cursor;
+    char * end = reader->end;
+    while (true) {
+        while (p < end && (json_is_space(*p) || *p == ',')) {
+            p++;
+        }
+        if (p >= end) {
+            reader->cursor = p;
+            json_fail(reader);
+            return count;
+        }
+        if (*p == ']') {
+            p++;
+            break;
+        }
+        size_t digits = json_digit_count(p);
+        if (digits == 0 || digits > 10) {
+            reader->cursor = p;
+            json_fail(reader);
+            return count;
+        }
+        uint64_t value = json_parse_digits(p, digits);
+        if (value > UINT32_MAX) {
+            reader->cursor = p;
+            json_fail(reader);
+            return count;
+        }
+        if (count == *capacity) {
+            size_t old_capacity = *capacity;
+            *capacity = *capacity ? *capacity * 2 : 256;
+            if (reader->arena != NULL) {
+                *values = arena_realloc(reader->arena, *values, old_capacity * sizeof(uint32_t), *capacity * sizeof(uint32_t));
+            } else {
+                *values = realloc(*values, *capacity * sizeof(uint32_t));
+            }
+            if (*values == NULL) {
+                log_error("Failed to allocate array data");
+                exit(1);
+            }
+        }
+        (*values)[count++] = value;
+        p += digits;
+    }
+    reader->cursor = p;
+    return count;
+}
+
+/**
+ * @brief Skip the next value without decoding it
+ */
+bool json_skip(JsonReader * reader) {
+    switch (json_peek(reader)) {
+        case JSON_TYPE_OBJECT:
+        case JSON_TYPE_ARRAY: {
+            int depth = 0;
+            char * p = reader->cursor;
+            while (p < reader->end) {
+                char c = *p++;
+                if (c == '"') {
+                    while (p < reader->end && *p != '"') {
+                        p += *p == '\\' ? 2 : 1;
+                    }
+                    p++;
+                } else if (c == '{' || c == '[') {
+                    depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--depth == 0) {
+                        break;
+                    }
+                }
+            }
+            if (depth != 0 || p > reader->end) {
+                return json_fail(reader);
+            }
+            reader->cursor = p;
+            return true;
+        }
+        case JSON_TYPE_STRING: {
+            char * string;
+            return json_read_string(reader, &string);
+        }
+        case JSON_TYPE_NUMBER: {
+            double number;
+            return json_read_number(reader, &number);
+        }
+        case JSON_TYPE_BOOL: {
+            bool value;
+            return json_read_bool(reader, &value);
+        }
+        case JSON_TYPE_NULL:
+            if (reader->end - reader->cursor >= 4 && strncmp(reader->cursor, "null", 4) == 0) {
+                reader->cursor += 4;
+                return true;
+            }
+            return json_fail(reader);
+        default:
+            return json_fail(reader);
+    }
+}
+
+/**
+ * @brief Append a zeroed element to a growing array of decoded values
+ *
+ * @param arena Arena the array lives in, NULL for the heap
+ * @return void* The new element
+ */
+void * json_array_push(Arena * arena, void ** array, size_t * count, size_t * capacity, size_t element_size) {
+    if (*count == *capacity) {
+        size_t old_capacity = *capacity;
+        *capacity = *capacity ? *capacity * 2 : 4;
+        if (arena != NULL) {
+            *array = arena_realloc(arena, *array, old_capacity * element_size, *capacity * element_size);
+        } else {
+            *array = realloc(*array, *capacity * element_size);
+        }
+        if (*array == NULL) {
+            log_error("Failed to allocate array");
+            exit(1);
+        }
+    }
+    void * element = (char *)*array + *count * element_size;
+    memset(element, 0, element_size);
+    (*count)++;
+    return element;
+}
@@ -0,0 +1,187 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader.h"
+
+// Logging
+#include <log.h>
+
+static SDL_Thread * loader_thread;
+static SDL_mutex * loader_mutex;
+static SDL_cond * loader_queued;
+static SDL_cond * loader_finished;
+static LoaderJob * loader_queue;
+static bool loader_running;
+
+static int loader_run(void * data) {
+    SDL_LockMutex(loader_mutex);
+    while (true) {
+        while (loader_running && loader_queue == NULL) {
+            SDL_CondWait(loader_queued, loader_mutex);
+        }
+        if (!loader_running) {
+            break;
+        }
+        LoaderJob * job = loader_queue;
+        loader_queue = job->next;
+        SDL_UnlockMutex(loader_mutex);
+
+        if (job->release) {
+            map_free(&job->map);
+            free(job);
+            SDL_LockMutex(loader_mutex);
+            continue;
+        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        map_load(&job->map, job->filename);
+        log_debug("Loaded %s in %.2f ms", job->filename, (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+        SDL_LockMutex(loader_mutex);
+        if (job->cancelled) {
+            map_free(&job->map);
+            free(job);
+        } else {
+            job->done = true;
+            SDL_CondBroadcast(loader_finished);
+        }
+    }
+    SDL_UnlockMutex(loader_mutex);
+    return 0;
+}
+
+void loader_init(void) {
+    loader_mutex = SDL_CreateMutex();
+    loader_queued = SDL_CreateCond();
+    loader_finished = SDL_CreateCond();
+    if (loader_mutex == NULL || loader_queued == NULL || loader_finished == NULL) {
+        log_error("Failed to create loader lock: %s", SDL_GetError());
+        exit(1);
+    }
+    loader_running = true;
+    loader_thread = SDL_CreateThread(loader_run, "map loader", NULL);
+    if (loader_thread == NULL) {
+        log_error("Failed to create loader thread: %s", SDL_GetError());
+        exit(1);
+    }
+}
+
+/**
+ * @brief Stop the worker thread, jobs that did not start yet are dropped
+ *
+ * Jobs that finished but were not taken still belong to the caller.
+ */
+void loader_quit(void) {
+    SDL_LockMutex(loader_mutex);
+    loader_running = false;
+    SDL_CondSignal(loader_queued);
+    SDL_UnlockMutex(loader_mutex);
+    SDL_WaitThread(loader_thread, NULL);
+    loader_thread = NULL;
+    while (loader_queue != NULL) {
+        LoaderJob * job = loader_queue;
+        loader_queue = job->next;
+        if (job->release) {
+            map_free(&job->map);
+        }
+        free(job);
+    }
+    SDL_DestroyCond(loader_finished);
+    SDL_DestroyCond(loader_queued);
+    SDL_DestroyMutex(loader_mutex);
+}
+
+static void loader_enqueue(LoaderJob * job) {
+    SDL_LockMutex(loader_mutex);
+    LoaderJob ** tail = &loader_queue;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = job;
+    SDL_CondSignal(loader_queued);
+    SDL_UnlockMutex(loader_mutex);
+}
+
+static LoaderJob * loader_job_new(void) {
+    LoaderJob * job = calloc(1, sizeof(LoaderJob));
+    if (job == NULL) {
+        log_error("Failed to allocate loader job");
+        exit(1);
+    }
+    return job;
+}
+
+/**
+ * @brief Queue a map for loading on the worker thread
+ *
+ * @param filename Path of the map
+ * @return LoaderJob* Job to poll, take or cancel
+ */
+LoaderJob * loader_request(const char * filename) {
+    LoaderJob * job = loader_job_new();
+    strncpy(job->filename, filename, MAX_FILENAME_LENGTH - 1);
+    loader_enqueue(job);
+    return job;
+}
+
+/**
+ * @brief Free a map on the worker thread
+ *
+ * @param map Map to free, it is moved into the loader and cleared
+ */
+void loader_free(Map * map) {
+    LoaderJob * job = loader_job_new();
+    job->map = *map;
+    job->release = true;
+    *map = (Map){0};
+    loader_enqueue(job);
+}
+
+bool loader_done(LoaderJob * job) {
+    SDL_LockMutex(loader_mutex);
+    bool done = job->done;
+    SDL_UnlockMutex(loader_mutex);
+    return done;
+}
+
+/**
+ * @brief Move the loaded map out of the job and free the job, waits for the job to finish
+ *
+ * @param job
+ * @param map Receives the loaded map
+ */
+void loader_take(LoaderJob * job, Map * map) {
+    SDL_LockMutex(loader_mutex);
+    while (!job->done) {
+        SDL_CondWait(loader_finished, loader_mutex);
+    }
+    SDL_UnlockMutex(loader_mutex);
+    *map = job->map;
+    free(job);
+}
+
+/**
+ * @brief Drop a job that is no longer needed
+ *
+ * @param job
+ */
+void loader_cancel(LoaderJob * job) {
+    SDL_LockMutex(loader_mutex);
+    // Still queued, unlink it
+    for (LoaderJob ** link = &loader_queue; *link != NULL; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            SDL_UnlockMutex(loader_mutex);
+            free(job);
+            return;
+        }
+    }
+    if (job->done) {
+        SDL_UnlockMutex(loader_mutex);
+        map_free(&job->map);
+        free(job);
+        return;
+    }
+    // Being loaded, the worker frees it when it is done
+    job->cancelled = true;
+    SDL_UnlockMutex(loader_mutex);
+}
@@ -14,81 +14,152 @@
 #include "draw.h"
 #include "init.h"
 #include "input.h"
+#include "pacing.h"
 #include "player.h"
+#include "profile.h"
 #include "map.h"
 #include "tileset.h"
+#include "tileset_cache.h"
+#include "image_cache.h"
 #include "assets.h"
+#include "atlas.h"
+#include "atom.h"
+#include "bench.h"
+#include "loader.h"
+#include "map_cache.h"
+#include "render_queue.h"
+#include "resolution.h"
+#include "simulation.h"
+#include "warp.h"
+#include "world.h"
 
 // Logging
 #include <log.h>
 
-static void capFrameRate(long *then, float *remainder)
-{
-	long wait, frameTime;
-
-	wait = 16 + *remainder;
-
-	*remainder -= (int)*remainder;
-
-	frameTime = SDL_GetTicks() - *then;
-
-	wait -= frameTime;
-
-	if (wait < 1)
-	{
-		wait = 1;
-	}
-
-	SDL_Delay(wait);
-
-	*remainder += 0.667;
-
-	*then = SDL_GetTicks();
-}
-
 int main(int argc, char* argv[]) {
     App app = {0};
 
-    Map map = {0};
-    long then;
-	float remainder = 0;
+    World world = {0};
 
+    bool headless = bench_init(argc, argv);
     log_info("Starting up...");
     // Init SDL
-    init_sdl(&app);
+    init_sdl(&app, headless);
     // Init tilesets
     asset_init();
-    Tileset * map_tiles = tileset_load(&app, asset_path("map_tiles.tsj"));
-    Tileset * player_tiles = tileset_load(&app, asset_path("player_tiles.tsj"));
+    tileset_cache_init(&app);
+    image_cache_init(&app, IMAGE_CACHE_BUDGET);
+    profile_init(&app);
+    Tileset * player_tiles = tileset_cache_acquire(asset_path("player_tiles.tsj"));
     Camera camera = make_camera(&app, 1280, 720);
     app.camera = &camera;
+    resolution_init(&app, &camera);
     
     player_init(&app, player_tiles);
-    map_init(&map, map_tiles, asset_path("home.tmj"));
+    loader_init();
+    map_cache_init(MAP_CACHE_BUDGET);
+    world_load(&world, asset_path("worldofzuul.world"), asset_path(headless ? bench_map() : "home.tmj"));
 
-    then = SDL_GetTicks();
+    pacing_init(app.renderer);
+    // Benchmarks tick once per frame on this thread, so the scripted path does not depend on the frame rate
+    simulation_init(&app, &world, &camera, !headless);
     //Camera camera = make_camera(&app, SCREEN_WIDTH, SCREEN_HEIGHT);
     
-    while (1) {
-        draw_prepare_scene(&app, camera.target);
+    while (!app.quit && (!headless || bench_frame_begin(&app))) {
+        if (!headless) {
+            pacing_wait();
+        }
+        profile_frame_begin();
+        // The map cache and the image cache only serve this thread
+        map_cache_update();
+        image_cache_update(&app);
+        profile_stage(PROFILE_STAGE_UPDATE);
         input_handle(&app);
-        player_handle(&app, &map, &camera);
-        map_draw(&app, &map);
-        player_draw(&app);
-        camera_update(&camera, player_get(), map.width*map.tilewidth, map.height*map.tileheight);
+        profile_handle(&app);
+        profile_stage(PROFILE_STAGE_INPUT);
+        warp_prepare();
+        // Hand input to the simulation and apply what changes the map it is on, then take the newest snapshot
+        simulation_lock();
+        simulation_input(&app);
+        if (headless) {
+            simulation_step();
+        }
+        profile_stage(PROFILE_STAGE_PLAYER);
+        // Swap in the destination of a finished warp, the next tick starts there
+        if (world_warp(&world, player_get())) {
+            camera_update(&camera, player_get(), &world_get_map(&world)->bounds);
+        }
+        world_enter(&world, &camera, player_get());
+        const SceneSnapshot * scene = simulation_latest(&world);
+        simulation_unlock();
+        // Everything from here on works on the snapshot while the simulation keeps ticking
+        world_stream(&world, &scene->camera);
+        // Every animation runs off the simulation clock
+        app.ticks = scene->ticks;
+        if (tileset_cache_update_animations(app.ticks)) {
+            draw_mark_dirty();
+        }
+        profile_stage(PROFILE_STAGE_UPDATE);
+
+        float alpha = simulation_alpha(scene);
+        Camera view;
+        camera_interpolate(&view, &scene->camera, alpha);
+        resolution_apply(&view);
+        player_interpolate(&scene->player, scene->player_tile, alpha);
+        app.camera = &view;
+        profile_stage(PROFILE_STAGE_CAMERA);
+        // Idle frames present the camera target of the last frame that changed
+        bool redraw = draw_take_dirty() || warp_fading();
+        if (redraw) {
+            image_cache_redraw();
+            draw_prepare_camera(&app, &view);
+            world_draw(&app, &world, scene->map);
+            profile_stage(PROFILE_STAGE_MAP);
+            player_draw(&app);
+            profile_stage(PROFILE_STAGE_SPRITES);
+            render_queue_flush(app.renderer);
+            warp_draw(&app);
+            profile_stage(PROFILE_STAGE_FLUSH);
+        }
         // Screen
         draw_prepare_scene(&app, NULL);
-        draw_camera_to_screen(&app, &camera);
-        capFrameRate(&then, &remainder);
+        draw_camera_to_screen(&app, &view);
+        profile_stage(PROFILE_STAGE_SCREEN);
+        profile_draw_hud(&app);
+        profile_stage(PROFILE_STAGE_HUD);
+        SDL_RenderPresent(app.renderer);
+        profile_stage(PROFILE_STAGE_PRESENT);
+        app.camera = &camera;
+        profile_frame_end();
+        if (redraw) {
+            resolution_frame(profile_last_frame_ms());
+        }
+        if (headless) {
+            bench_frame_end();
+        }
+    }
+    simulation_quit();
+    if (headless) {
+        bench_write();
     }
+    profile_quit();
+    resolution_quit();
 
     SDL_DestroyRenderer(app.renderer);
     SDL_DestroyWindow(app.window);
     player_free();
-    tileset_free(player_tiles);
-    tileset_free(map_tiles);
-    map_free(&map);
+    render_queue_free();
+    tileset_cache_release(player_tiles);
+    warp_cancel();
+    world_free(&world);
+    map_cache_quit();
+    tileset_cache_quit();
+    image_cache_quit();
+    atlas_quit();
+    loader_quit();
     asset_free();
+    atom_quit();
+    bench_quit();
     IMG_Quit();
     SDL_Quit();
 
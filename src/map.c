@@ -1,13 +1,25 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
-#include <cjson/cJSON.h>
 #include <stdio.h>
+#include <math.h>
 #include <stdlib.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include "structs.h"
 #include "defs.h"
 #include "draw.h"
 #include "map.h"
 #include "tileset.h"
+#include "base64.h"
+#include "atom.h"
+#include "chunk.h"
+#include "json.h"
+#include "render_cache.h"
+#include "render_queue.h"
+#include "tileset_cache.h"
+#include "zmap.h"
 
 // Logging
 #include <log.h>
@@ -17,340 +29,1047 @@
 #define MAP_TILE_HEIGHT 64
 #define MAP_ANIMATION_FRAMES 2
 
-static void map_parse_tile_layer(const cJSON * j_layer, Layer * layer) {
-    const cJSON *j_width = cJSON_GetObjectItemCaseSensitive(j_layer, "width");
-    if (!cJSON_IsNumber(j_width)) {
-        log_error("Failed to parse layer width");
+static size_t map_parse_tile_data(JsonReader * reader, Layer * layer) {
+    // Width and height usually follow the data, grow the buffer until they are known
+    size_t capacity = 0;
+    if (layer->width > 0 && layer->height > 0) {
+        capacity = (size_t)layer->width * layer->height;
+        layer->data = arena_alloc(reader->arena, capacity * sizeof(uint32_t));
+    }
+    size_t count = json_read_uint32_array(reader, &layer->data, &capacity);
+    if (count > 0 && count < capacity) {
+        layer->data = arena_realloc(reader->arena, layer->data, capacity * sizeof(uint32_t), count * sizeof(uint32_t));
+    }
+    return count;
+}
+
+static size_t map_inflate(const uint8_t * compressed, size_t compressed_size, uint8_t * out, size_t size, bool gzip) {
+    z_stream stream = {0};
+    if (inflateInit2(&stream, gzip ? 15 + 16 : 15) != Z_OK) {
+        log_error("Failed to initialize zlib");
         exit(1);
     }
-    const cJSON *j_height = cJSON_GetObjectItemCaseSensitive(j_layer, "height");
-    if (!cJSON_IsNumber(j_height)) {
-        log_error("Failed to parse layer height");
+    stream.next_in = (Bytef *)compressed;
+    stream.avail_in = compressed_size;
+    stream.next_out = out;
+    stream.avail_out = size;
+    int rc = inflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    inflateEnd(&stream);
+    if (rc != Z_STREAM_END) {
+        log_error("Failed to inflate layer data: %s", stream.msg != NULL ? stream.msg : "output size mismatch");
         exit(1);
     }
+    return written;
+}
 
-    layer->width = j_width->valueint;
-    layer->height = j_height->valueint;
+// Layer data is stored as little-endian gids
+static void map_tile_data_to_host(uint32_t * data, size_t count) {
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    for (size_t i = 0; i < count; i++) {
+        data[i] = SDL_SwapLE32(data[i]);
+    }
+#else
+    (void)data;
+    (void)count;
+#endif
+}
 
-    // Read json data
-    const cJSON *j_data = cJSON_GetObjectItemCaseSensitive(j_layer, "data");
-    if (cJSON_IsArray(j_data)) {
-        // Allocate tiles for layer
-        layer->data = calloc(layer->width * layer->height, sizeof(uint32_t));
-        if (layer->data == NULL) {
-            log_error("Failed to allocate map data");
+/**
+ * @brief Decompress zlib, gzip or zstd compressed tile data into gids
+ * 
+ * @param compressed Compressed bytes
+ * @param compressed_size 
+ * @param compression zlib, gzip or zstd
+ * @param data Gid buffer of count elements
+ * @param count Number of tiles
+ */
+void map_decompress_tile_data(const uint8_t * compressed, size_t compressed_size, const char * compression, uint32_t * data, size_t count) {
+    size_t size = count * sizeof(uint32_t);
+    size_t written = 0;
+    if (strcmp(compression, "zlib") == 0 || strcmp(compression, "gzip") == 0) {
+        written = map_inflate(compressed, compressed_size, (uint8_t *)data, size, strcmp(compression, "gzip") == 0);
+    } else if (strcmp(compression, "zstd") == 0) {
+#ifdef HAVE_ZSTD
+        written = ZSTD_decompress(data, size, compressed, compressed_size);
+        if (ZSTD_isError(written)) {
+            log_error("Failed to decompress layer data: %s", ZSTD_getErrorName(written));
             exit(1);
         }
-        int data_index = 0;
-        const cJSON *j_gid;
-        cJSON_ArrayForEach(j_gid, j_data) {
-            if (!cJSON_IsNumber(j_gid)) {
-                log_error("Failed to parse map tile");
-                exit(1);
-            }
+#else
+        log_error("Layer data is zstd compressed but zstd support is not compiled in");
+        exit(1);
+#endif
+    } else {
+        log_error("Layer compression not supported: %s", compression);
+        exit(1);
+    }
+    if (written != size) {
+        log_error("Layer data has %zu bytes, expected %zu", written, size);
+        exit(1);
+    }
+    map_tile_data_to_host(data, count);
+}
 
-            // Read flags
-            layer->data[data_index] = j_gid->valueint;
-            data_index++;
+/**
+ * @brief Decode base64 encoded and optionally compressed tile data into gids
+ * 
+ * @param encoded Base64 characters
+ * @param compression zlib, gzip, zstd or NULL/empty for uncompressed data
+ * @param data Gid buffer of count elements
+ * @param count Number of tiles
+ */
+void map_decode_tile_data(const char * encoded, const char * compression, uint32_t * data, size_t count) {
+    size_t length = strlen(encoded);
+    size_t size = count * sizeof(uint32_t);
+    if (compression == NULL || compression[0] == '\0') {
+        size_t written = 0;
+        if (!base64_decode(encoded, length, (uint8_t *)data, size, &written)) {
+            log_error("Failed to decode base64 layer data");
+            exit(1);
+        }
+        if (written != size) {
+            log_error("Layer data has %zu bytes, expected %zu", written, size);
+            exit(1);
         }
+        map_tile_data_to_host(data, count);
+        return;
+    }
+    size_t compressed_size = 0;
+    uint8_t * compressed = malloc(BASE64_DECODED_SIZE(length));
+    if (compressed == NULL) {
+        log_error("Failed to allocate compressed layer data");
+        exit(1);
+    }
+    if (!base64_decode(encoded, length, compressed, BASE64_DECODED_SIZE(length), &compressed_size)) {
+        log_error("Failed to decode base64 layer data");
+        exit(1);
     }
+    map_decompress_tile_data(compressed, compressed_size, compression, data, count);
+    free(compressed);
 }
 
-static void map_parse_properties(const cJSON *j_object, Object * object) {
-    const cJSON * j_properties = cJSON_GetObjectItemCaseSensitive(j_object, "properties");
-    object->property_count = cJSON_GetArraySize(j_properties);
-    object->properties = NULL;
-    if (cJSON_IsArray(j_properties)) {
-        object->properties = calloc(object->property_count, sizeof(Property));
-        const cJSON * j_property = NULL;
-        int property_index = 0;
-        cJSON_ArrayForEach(j_property, j_properties) {
-            Property * property = &object->properties[property_index];
-            const cJSON * j_name = cJSON_GetObjectItemCaseSensitive(j_property, "name");
-            if (!cJSON_IsString(j_name)) {
-                log_error("Failed to parse object property name");
-                exit(1);
+static void map_parse_properties(JsonReader * reader, Property ** properties, size_t * property_count) {
+    size_t capacity = 0;
+    *property_count = 0;
+    if (!json_array_begin(reader)) {
+        return;
+    }
+    while (json_array_next(reader)) {
+        Property * property = json_array_push(reader->arena, (void **)properties, property_count, &capacity, sizeof(Property));
+        bool has_name = false;
+        bool has_type = false;
+        const char * key;
+        json_object_begin(reader);
+        while (json_object_next(reader, &key)) {
+            if (strcmp(key, "name") == 0) {
+                has_name = json_read_atom(reader, &property->name);
+            } else if (strcmp(key, "type") == 0) {
+                Atom type;
+                has_type = json_read_atom(reader, &type);
+                property->type = property_type_from_atom(type);
+            } else if (strcmp(key, "propertytype") == 0) {
+                json_read_atom(reader, &property->propertytype);
+            } else if (strcmp(key, "value") == 0) {
+                // Without a type the value decides it
+                switch (json_peek(reader)) {
+                    case JSON_TYPE_NUMBER:
+                        json_read_number(reader, &property->number_value);
+                        property->type = has_type ? property->type : PROPERTY_TYPE_FLOAT;
+                        break;
+                    case JSON_TYPE_BOOL:
+                        json_read_bool(reader, &property->bool_value);
+                        property->type = has_type ? property->type : PROPERTY_TYPE_BOOL;
+                        break;
+                    case JSON_TYPE_STRING:
+                        json_read_string_copy(reader, &property->string_value);
+                        break;
+                    default:
+                        log_warn("Property type not supported");
+                        json_skip(reader);
+                        break;
+                }
+            } else {
+                json_skip(reader);
             }
-            property->name = calloc(strlen(j_name->valuestring) + 1, sizeof(char));
-            strcpy(property->name, j_name->valuestring);
+        }
+        if (!has_name && !reader->error) {
+            log_error("Failed to parse object property name");
+            exit(1);
+        }
+    }
+}
 
-            const cJSON * j_type = cJSON_GetObjectItemCaseSensitive(j_property, "type");
-            if (cJSON_IsString(j_type)) {
-                property->type = calloc(strlen(j_type->valuestring) + 1, sizeof(char));
-                strcpy(property->type, j_type->valuestring);
-            }
+static void map_parse_object(JsonReader * reader, Object * object) {
+    bool has_width = false;
+    bool has_height = false;
+    bool has_x = false;
+    bool has_y = false;
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "width") == 0) {
+            has_width = json_read_number(reader, &object->width);
+        } else if (strcmp(key, "height") == 0) {
+            has_height = json_read_number(reader, &object->height);
+        } else if (strcmp(key, "x") == 0) {
+            has_x = json_read_number(reader, &object->x);
+        } else if (strcmp(key, "y") == 0) {
+            has_y = json_read_number(reader, &object->y);
+        } else if (strcmp(key, "id") == 0) {
+            json_read_int(reader, &object->id);
+        } else if (strcmp(key, "name") == 0) {
+            json_read_atom(reader, &object->name);
+        } else if (strcmp(key, "type") == 0 || strcmp(key, "class") == 0) {
+            json_read_atom(reader, &object->type);
+        } else if (strcmp(key, "gid") == 0) {
+            double gid;
+            json_read_number(reader, &gid);
+            object->gid = (uint32_t)gid;
+        } else if (strcmp(key, "properties") == 0) {
+            map_parse_properties(reader, &object->properties, &object->property_count);
+            object->property_mask = property_mask_build(object->properties, object->property_count);
+        } else {
+            json_skip(reader);
+        }
+    }
+    if (reader->error) {
+        return;
+    }
+    if (!has_width) {
+        log_error("Failed to parse object width");
+        exit(1);
+    }
+    if (!has_height) {
+        log_error("Failed to parse object height");
+        exit(1);
+    }
+    if (!has_x) {
+        log_error("Failed to parse object x");
+        exit(1);
+    }
+    if (!has_y) {
+        log_error("Failed to parse object y");
+        exit(1);
+    }
+}
 
-            const cJSON * j_propertytype = cJSON_GetObjectItemCaseSensitive(j_property, "propertytype");
-            if (cJSON_IsString(j_propertytype)) {
-                property->propertytype = calloc(strlen(j_propertytype->valuestring) + 1, sizeof(char));
-                strcpy(property->propertytype, j_propertytype->valuestring);
-            }
-            
-
-            const cJSON * j_value = cJSON_GetObjectItemCaseSensitive(j_property, "value");
-            if (cJSON_IsNumber(j_value)) {
-                log_debug("Property value: %d", j_value->valueint);
-                property->number_value = cJSON_GetNumberValue(j_value);
-                //property->float_value = cJSON_GetNumberValue(j_value);
-            } else if (cJSON_IsBool(j_value)) {
-                property->bool_value = j_value->valueint;
-            } else if (cJSON_IsString(j_value)) {
-                property->string_value = calloc(strlen(j_value->valuestring) + 1, sizeof(char));
-                strcpy(property->string_value, j_value->valuestring);
+static void map_parse_object_layer(JsonReader * reader, Layer * layer) {
+    size_t capacity = 0;
+    layer->object_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Object * object = json_array_push(reader->arena, (void **)&layer->objects, &layer->object_count, &capacity, sizeof(Object));
+        map_parse_object(reader, object);
+    }
+    log_debug("Parsed objects %zu", layer->object_count);
+}
+
+// Chunk data as found in the map file, packed once the layer encoding is known
+typedef struct MapChunkSource
+{
+    char *text; // Base64 string or the span of a csv array
+    size_t length;
+    bool encoded;
+} MapChunkSource;
+
+static void map_parse_chunk(JsonReader * reader, Chunk * chunk, MapChunkSource * source) {
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "data") == 0) {
+            if (json_peek(reader) == JSON_TYPE_STRING) {
+                json_read_string(reader, &source->text);
+                source->length = strlen(source->text);
+                source->encoded = true;
             } else {
-                log_warn("Property type not supported");
-            } 
-            property_index++;
+                source->text = reader->cursor;
+                json_skip(reader);
+                source->length = reader->cursor - source->text;
+            }
+        } else if (strcmp(key, "width") == 0) {
+            json_read_int(reader, &chunk->width);
+        } else if (strcmp(key, "height") == 0) {
+            json_read_int(reader, &chunk->height);
+        } else if (strcmp(key, "x") == 0) {
+            json_read_int(reader, &chunk->x);
+        } else if (strcmp(key, "y") == 0) {
+            json_read_int(reader, &chunk->y);
+        } else {
+            json_skip(reader);
         }
     }
 }
 
-static void map_parse_object_layer(const cJSON * j_layer, Layer * layer) {
-    const cJSON *j_objects = cJSON_GetObjectItemCaseSensitive(j_layer, "objects");
-    layer->object_count = cJSON_GetArraySize(j_objects);
-    layer->objects = NULL;
-    if (cJSON_IsArray(j_objects)) {
-        // Allocate tiles for layer
-        layer->objects = calloc(layer->object_count, sizeof(Object));
-        if (layer->objects == NULL) {
-            log_error("Failed to allocate map object data");
+static void map_parse_chunks(JsonReader * reader, Layer * layer, Arena * scratch, MapChunkSource ** sources) {
+    size_t capacity = 0;
+    size_t count = 0;
+    size_t source_capacity = 0;
+    size_t source_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Chunk * chunk = json_array_push(reader->arena, (void **)&layer->array, &count, &capacity, sizeof(Chunk));
+        MapChunkSource * source = json_array_push(scratch, (void **)sources, &source_count, &source_capacity, sizeof(MapChunkSource));
+        map_parse_chunk(reader, chunk, source);
+    }
+    layer->array_count = count;
+}
+
+/**
+ * @brief Convert the chunk data of a layer to its packed form
+ * 
+ * Compressed chunks keep their compressed bytes, csv and uncompressed chunks are packed with zlib.
+ * 
+ * @param arena Arena of the map
+ * @param scratch Arena for the decoded gids
+ * @param layer 
+ * @param sources Chunk data from the map file, one per chunk
+ */
+static void map_pack_chunks(Arena * arena, Arena * scratch, Layer * layer, MapChunkSource * sources) {
+    bool compressed = layer->compression != NULL && layer->compression[0] != '\0';
+    uint32_t * gids = NULL;
+    size_t gids_capacity = 0;
+    for (uint32_t i = 0; i < layer->array_count; i++) {
+        Chunk * chunk = &layer->array[i];
+        MapChunkSource * source = &sources[i];
+        if (source->text == NULL || chunk->width <= 0 || chunk->height <= 0) {
+            log_error("Failed to parse chunk %d of layer %s", i, atom_name(layer->name));
             exit(1);
         }
-        log_debug("Parsing objects %d", layer->object_count);
-        int object_index = 0;
-        const cJSON *j_object;
-        cJSON_ArrayForEach(j_object, j_objects) {
-            Object * object = &layer->objects[object_index];
-            const cJSON *j_width = cJSON_GetObjectItemCaseSensitive(j_object, "width");
-            if (!cJSON_IsNumber(j_width)) {
-                log_error("Failed to parse layer width");
-                exit(1);
-            }
-            const cJSON *j_height = cJSON_GetObjectItemCaseSensitive(j_object, "height");
-            if (!cJSON_IsNumber(j_height)) {
-                log_error("Failed to parse layer height");
+        if (source->encoded && (layer->encoding == NULL || strcmp(layer->encoding, "base64") != 0)) {
+            log_error("Layer data encoding not supported: %s", layer->encoding);
+            exit(1);
+        }
+        if (!source->encoded && compressed) {
+            log_error("Compressed layer %s has csv chunk data", atom_name(layer->name));
+            exit(1);
+        }
+        if (compressed) {
+            size_t capacity = BASE64_DECODED_SIZE(source->length);
+            chunk->packed = arena_alloc(arena, capacity);
+            if (!base64_decode(source->text, source->length, chunk->packed, capacity, &chunk->packed_size)) {
+                log_error("Failed to decode base64 chunk data");
                 exit(1);
             }
-            const cJSON *j_x = cJSON_GetObjectItemCaseSensitive(j_object, "x");
-            if (!cJSON_IsNumber(j_x)) {
-                log_error("Failed to parse layer x");
+            chunk->packed = arena_realloc(arena, chunk->packed, capacity, chunk->packed_size);
+            continue;
+        }
+        size_t count = (size_t)chunk->width * chunk->height;
+        if (count > gids_capacity) {
+            gids = arena_alloc(scratch, count * sizeof(uint32_t));
+            gids_capacity = count;
+        }
+        if (source->encoded) {
+            map_decode_tile_data(source->text, NULL, gids, count);
+        } else {
+            JsonReader chunk_reader;
+            json_reader_init(&chunk_reader, source->text, source->length);
+            size_t capacity = count;
+            chunk_reader.arena = scratch;
+            if (json_read_uint32_array(&chunk_reader, &gids, &capacity) != count || chunk_reader.error) {
+                log_error("Chunk %d,%d of layer %s does not have %zu tiles", chunk->x, chunk->y, atom_name(layer->name), count);
                 exit(1);
             }
-            const cJSON *j_y = cJSON_GetObjectItemCaseSensitive(j_object, "y");
-            if (!cJSON_IsNumber(j_y)) {
-                log_error("Failed to parse layer y");
-                exit(1);
+        }
+        chunk_pack(arena, layer, chunk, gids);
+    }
+}
+
+static void map_parse_layer(JsonReader * reader, Layer * layer) {
+    bool has_data = false;
+    size_t data_count = 0;
+    char * encoded = NULL;
+    MapChunkSource * chunk_sources = NULL;
+    Arena scratch;
+    arena_init(&scratch);
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "type") == 0) {
+            json_read_atom(reader, &layer->type);
+        } else if (strcmp(key, "name") == 0) {
+            json_read_atom(reader, &layer->name);
+        } else if (strcmp(key, "class") == 0) {
+            json_read_atom(reader, &layer->class);
+        } else if (strcmp(key, "id") == 0) {
+            int id;
+            json_read_int(reader, &id);
+            layer->id = id;
+        } else if (strcmp(key, "width") == 0) {
+            json_read_int(reader, &layer->width);
+        } else if (strcmp(key, "height") == 0) {
+            json_read_int(reader, &layer->height);
+        } else if (strcmp(key, "data") == 0) {
+            // Encoded data stays in the file buffer until the encoding is known
+            if (json_peek(reader) == JSON_TYPE_STRING) {
+                json_read_string(reader, &encoded);
+            } else {
+                data_count = map_parse_tile_data(reader, layer);
             }
+            has_data = true;
+        } else if (strcmp(key, "encoding") == 0) {
+            json_read_string_copy(reader, &layer->encoding);
+        } else if (strcmp(key, "compression") == 0) {
+            json_read_string_copy(reader, &layer->compression);
+        } else if (strcmp(key, "chunks") == 0) {
+            map_parse_chunks(reader, layer, &scratch, &chunk_sources);
+        } else if (strcmp(key, "startx") == 0) {
+            json_read_int(reader, &layer->startx);
+        } else if (strcmp(key, "starty") == 0) {
+            json_read_int(reader, &layer->starty);
+        } else if (strcmp(key, "objects") == 0) {
+            map_parse_object_layer(reader, layer);
+        } else {
+            json_skip(reader);
+        }
+    }
+    if (reader->error) {
+        arena_free(&scratch);
+        return;
+    }
+    if (layer->array_count > 0) {
+        // Infinite map layer, the size is the bounding box of the chunks
+        map_pack_chunks(reader->arena, &scratch, layer, chunk_sources);
+        arena_free(&scratch);
+        chunk_table_build(layer);
+        return;
+    }
+    if (layer->type == ATOM_NONE) {
+        log_error("Failed to parse layer type");
+        exit(1);
+    }
+    if (layer->type != ATOM_TILELAYER) {
+        // Only tile layers have a size
+        layer->width = 0;
+        layer->height = 0;
+        layer->data = NULL;
+        return;
+    }
+    if (layer->width <= 0) {
+        log_error("Failed to parse layer width");
+        exit(1);
+    }
+    if (layer->height <= 0) {
+        log_error("Failed to parse layer height");
+        exit(1);
+    }
+    if (encoded != NULL) {
+        if (layer->encoding == NULL || strcmp(layer->encoding, "base64") != 0) {
+            log_error("Layer data encoding not supported: %s", layer->encoding);
+            exit(1);
+        }
+        data_count = (size_t)layer->width * layer->height;
+        layer->data = arena_alloc(reader->arena, data_count * sizeof(uint32_t));
+        map_decode_tile_data(encoded, layer->compression, layer->data, data_count);
+    }
+    if (has_data && data_count != (size_t)layer->width * layer->height) {
+        log_error("Layer %s has %zu tiles, expected %d", atom_name(layer->name), data_count, layer->width * layer->height);
+        exit(1);
+    }
+    if (!has_data) {
+        layer->data = arena_alloc(reader->arena, (size_t)layer->width * layer->height * sizeof(uint32_t));
+    }
+}
+
+static void map_parse_layers(JsonReader * reader, Map * map) {
+    size_t capacity = 0;
+    size_t layer_count = 0;
+    log_debug("Parsing layers");
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Layer * layer = json_array_push(reader->arena, (void **)&map->layers, &layer_count, &capacity, sizeof(Layer));
+        map_parse_layer(reader, layer);
+    }
+    map->layer_count = layer_count;
+}
 
-            object->width = j_width->valueint;
-            object->height = j_height->valueint;
-            object->x = j_x->valueint;
-            object->y = j_y->valueint;
-            map_parse_properties(j_object, object);
-            object_index++;
+static int map_compare_tilesets(const void * a, const void * b) {
+    const MapTileset * tileset_a = a;
+    const MapTileset * tileset_b = b;
+    return (tileset_a->first_gid > tileset_b->first_gid) - (tileset_a->first_gid < tileset_b->first_gid);
+}
+
+static void map_parse_tilesets(JsonReader * reader, Map * map) {
+    size_t capacity = 0;
+    size_t tileset_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        MapTileset * tileset = json_array_push(reader->arena, (void **)&map->tilesets, &tileset_count, &capacity, sizeof(MapTileset));
+        int first_gid = 0;
+        const char * key;
+        json_object_begin(reader);
+        while (json_object_next(reader, &key)) {
+            if (strcmp(key, "firstgid") == 0) {
+                json_read_int(reader, &first_gid);
+            } else if (strcmp(key, "source") == 0) {
+                json_read_string_copy(reader, &tileset->source);
+            } else {
+                json_skip(reader);
+            }
+        }
+        if (reader->error) {
+            return;
+        }
+        if (first_gid <= 0) {
+            log_error("Failed to parse tileset firstgid");
+            exit(1);
+        }
+        tileset->first_gid = first_gid;
+        if (tileset->source == NULL) {
+            log_warn("Embedded tilesets are not supported, tiles from gid %d are not drawn", first_gid);
         }
     }
+    map->tileset_count = tileset_count;
+    qsort(map->tilesets, map->tileset_count, sizeof(MapTileset), map_compare_tilesets);
 }
 
+/**
+ * @brief Load a map, preferring its compiled .zmap version when there is one
+ * 
+ * @param map 
+ * @param filename .tmj or .zmap file
+ * @return 0 on success
+ */
 int map_load(Map * map, const char *filename) {
+    map->mapping = NULL;
+    map->mapping_size = 0;
+    char compiled[MAX_FILENAME_LENGTH];
+    if (zmap_find_compiled(filename, compiled, sizeof(compiled))) {
+        if (zmap_load(map, compiled) == 0) {
+            snprintf(map->filename, sizeof(map->filename), "%s", filename);
+            map->bounds = (SDL_Rect){0, 0, map->width * map->tilewidth, map->height * map->tileheight};
+            return 0;
+        }
+        if (strcmp(compiled, filename) == 0) {
+            log_error("Failed to load compiled map");
+            exit(1);
+        }
+        log_warn("Falling back to %s", filename);
+    }
+    return map_load_tmj(map, filename);
+}
+
+int map_load_tmj(Map * map, const char *filename) {
+    map->mapping = NULL;
+    map->mapping_size = 0;
+    map->layers = NULL;
+    map->layer_count = 0;
+    map->tilesets = NULL;
+    map->tileset_count = 0;
+    map->gid_tilesets = NULL;
+    map->gid_count = 0;
+    map->collision = NULL;
+    map->tile_overhang = (SDL_Point){0, 0};
+    map->chunk_radius = MAP_CHUNK_RADIUS;
+    map->render_cache = NULL;
+    arena_init(&map->arena);
     // Read map file into buffer
-    FILE *fp = fopen(filename, "r");
-    if (fp == NULL) {
+    size_t size;
+    char *string = json_read_file(filename, &size);
+    if (string == NULL) {
         log_error("Failed to open map file");
         exit(1);
     }
-    fseek(fp, 0, SEEK_END);
-    long fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);  /* same as rewind(f); */
 
-    char *string = malloc(fsize + 1);
-    fread(string, fsize, 1, fp);
-    fclose(fp);
-
-    string[fsize] = 0;
-
-    // Load json map data
-    cJSON *map_json = cJSON_Parse(string);
-    if (map_json == NULL) {
+    // Stream json map data
+    bool has_width = false;
+    bool has_height = false;
+    bool has_tile_width = false;
+    bool has_tile_height = false;
+    bool has_layers = false;
+    JsonReader reader;
+    json_reader_init(&reader, string, size);
+    reader.arena = &map->arena;
+    const char * key;
+    json_object_begin(&reader);
+    while (json_object_next(&reader, &key)) {
+        if (strcmp(key, "width") == 0) {
+            has_width = json_read_int(&reader, &map->width);
+        } else if (strcmp(key, "height") == 0) {
+            has_height = json_read_int(&reader, &map->height);
+        } else if (strcmp(key, "tilewidth") == 0) {
+            has_tile_width = json_read_int(&reader, &map->tilewidth);
+        } else if (strcmp(key, "tileheight") == 0) {
+            has_tile_height = json_read_int(&reader, &map->tileheight);
+        } else if (strcmp(key, "infinite") == 0) {
+            json_read_bool(&reader, &map->infinite);
+        } else if (strcmp(key, "layers") == 0) {
+            map_parse_layers(&reader, map);
+            has_layers = true;
+        } else if (strcmp(key, "tilesets") == 0) {
+            map_parse_tilesets(&reader, map);
+        } else {
+            json_skip(&reader);
+        }
+    }
+    if (reader.error) {
         log_error("Failed to parse map json");
         exit(1);
     }
-    const cJSON * j_height = cJSON_GetObjectItemCaseSensitive(map_json, "height");
-    if (!cJSON_IsNumber(j_height)) {
+    if (!has_height) {
         log_error("Failed to parse map height");
         exit(1);
     }
-    const cJSON * j_width = cJSON_GetObjectItemCaseSensitive(map_json, "width");
-    if (!cJSON_IsNumber(j_width)) {
+    if (!has_width) {
         log_error("Failed to parse map width");
         exit(1);
     }
-    const cJSON * j_tile_width = cJSON_GetObjectItemCaseSensitive(map_json, "tilewidth");
-    if (!cJSON_IsNumber(j_tile_width)) {
+    if (!has_tile_width) {
         log_error("Failed to parse map tilewidth");
         exit(1);
     }
-    const cJSON * j_tile_height = cJSON_GetObjectItemCaseSensitive(map_json, "tileheight");
-    if (!cJSON_IsNumber(j_tile_height)) {
+    if (!has_tile_height) {
         log_error("Failed to parse map tileheight");
         exit(1);
     }
-    const cJSON * j_layers = cJSON_GetObjectItemCaseSensitive(map_json, "layers");
-    if (!cJSON_IsArray(j_layers)) {
+    if (!has_layers) {
         log_error("Failed to parse map layers");
         exit(1);
     }
-    map->width = j_width->valueint;
-    map->height = j_height->valueint;
-    map->tilewidth = j_tile_width->valueint;
-    map->tileheight = j_tile_height->valueint;
-    map->layer_count = cJSON_GetArraySize(j_layers);
-    map->layers = calloc(map->layer_count, sizeof(Layer));
-    if (map->layers == NULL) {
-        log_error("Failed to allocate map layers");
+    // Grow infinite maps to cover all chunks right and below of the origin
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        for (uint32_t j = 0; j < map->layers[i].array_count; j++) {
+            Chunk * chunk = &map->layers[i].array[j];
+            if (chunk->x + chunk->width > map->width) {
+                map->width = chunk->x + chunk->width;
+            }
+            if (chunk->y + chunk->height > map->height) {
+                map->height = chunk->y + chunk->height;
+            }
+        }
+    }
+
+    snprintf(map->filename, sizeof(map->filename), "%s", filename);
+    map->bounds = (SDL_Rect){0, 0, map->width * map->tilewidth, map->height * map->tileheight};
+    map_build_occupancy(map);
+
+    free(string);
+    return 0;
+}
+
+/**
+ * @brief Index the tiles of every tile layer so drawing and collisions skip empty cells
+ *
+ * Sets a bit for every non-empty tile and marks tile layers without tiles as
+ * empty. Chunked layers of infinite maps are not indexed.
+ *
+ * @param map
+ */
+void map_build_occupancy(Map * map) {
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        if (layer->data == NULL || layer->chunk_table != NULL) {
+            continue;
+        }
+        layer->occupancy_words = (layer->width + 63) / 64;
+        layer->occupancy = arena_alloc(&map->arena, (size_t)layer->occupancy_words * layer->height * sizeof(uint64_t));
+        size_t count = 0;
+        for (int row = 0; row < layer->height; row++) {
+            uint64_t * words = &layer->occupancy[(size_t)row * layer->occupancy_words];
+            const uint32_t * data = &layer->data[(size_t)row * layer->width];
+            for (int col = 0; col < layer->width; col++) {
+                if (data[col] != 0) {
+                    words[col / 64] |= (uint64_t)1 << (col % 64);
+                    count++;
+                }
+            }
+        }
+        layer->empty = count == 0;
+    }
+}
+
+// Check the occupancy bit of a tile, layers without an index may have a tile anywhere
+static bool map_layer_occupied(Layer * layer, int col, int row) {
+    if (layer->occupancy == NULL) {
+        return !layer->empty;
+    }
+    if (col < 0 || row < 0 || col >= layer->width || row >= layer->height) {
+        return false;
+    }
+    return layer->occupancy[(size_t)row * layer->occupancy_words + col / 64] >> (col % 64) & 1;
+}
+
+
+// Tile flag of every collision channel
+static const uint32_t map_collision_flags[MAP_COLLISION_COUNT] = {
+    [MAP_COLLISION_SOLID] = TILE_INFO_SOLID,
+    [MAP_COLLISION_WATER] = TILE_INFO_WATER,
+    [MAP_COLLISION_TRIGGER] = TILE_INFO_TRIGGER,
+};
+
+// Words of the collision grid row of a channel
+static uint64_t * map_collision_row(Map * map, int channel, int row) {
+    return &map->collision[((size_t)channel * map->collision_area.h + row) * map->collision_words];
+}
+
+// Give a cell the channels of a tile, tiles without tileset data leave the cell to the layers below
+static void map_collision_set(Map * map, int col, int row, uint32_t gid) {
+    Tileset * tileset = map_resolve_gid(map, &gid);
+    TileInfo * info = tileset != NULL ? tileset_get_info(tileset, gid, false) : NULL;
+    if (info == NULL || info->tile == NULL) {
+        return;
+    }
+    col -= map->collision_area.x;
+    row -= map->collision_area.y;
+    uint64_t bit = (uint64_t)1 << (col % 64);
+    for (int channel = 0; channel < MAP_COLLISION_COUNT; channel++) {
+        uint64_t * word = &map_collision_row(map, channel, row)[col / 64];
+        *word = (info->flags & map_collision_flags[channel]) ? *word | bit : *word & ~bit;
+    }
+}
+
+/**
+ * @brief Combine the tiles of every tile layer into the collision grid, once the tilesets are attached
+ *
+ * Layers are applied from the bottom up, so a cell ends up with the channels of
+ * its topmost tile that has tileset data. Evicted chunks of infinite maps are
+ * decoded for the build and evicted again.
+ *
+ * @param map
+ */
+static void map_build_collision(Map * map) {
+    SDL_Rect area = {0, 0, map->width, map->height};
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        for (uint32_t j = 0; j < map->layers[i].array_count; j++) {
+            area.x = SDL_min(area.x, map->layers[i].array[j].x);
+            area.y = SDL_min(area.y, map->layers[i].array[j].y);
+        }
+    }
+    area.w = map->width - area.x;
+    area.h = map->height - area.y;
+    if (area.w <= 0 || area.h <= 0) {
+        return;
+    }
+    map->collision_area = area;
+    map->collision_words = (area.w + 63) / 64;
+    map->collision = calloc((size_t)MAP_COLLISION_COUNT * map->collision_words * area.h, sizeof(uint64_t));
+    if (map->collision == NULL) {
+        log_error("Failed to allocate collision grid");
         exit(1);
     }
-    log_debug("Parsing layers");
-    const cJSON *j_layer;
-    int layer_index = 0;
-    cJSON_ArrayForEach(j_layer, j_layers) {
-        // Check layer type
-        const cJSON *j_type = cJSON_GetObjectItemCaseSensitive(j_layer, "type");
-        if (!cJSON_IsString(j_type)) {
-            log_error("Failed to parse layer type");
-            exit(1);
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        if ((layer->type != ATOM_NONE && layer->type != ATOM_TILELAYER) || layer->empty) {
+            continue;
         }
-        Layer * layer = &map->layers[layer_index];
-        layer->type = calloc(strlen(j_type->valuestring) + 1, sizeof(char));
-        layer->object_count = 0;
-        layer->objects = NULL;
-        layer->data = NULL;
-        layer->width = 0;
-        layer->height = 0;
-        strcpy(layer->type, j_type->valuestring);
-        // Read json data
-        const cJSON *j_name = cJSON_GetObjectItemCaseSensitive(j_layer, "name");
-        if (cJSON_IsString(j_name)) {
-            layer->name = calloc(strlen(j_name->valuestring) + 1, sizeof(char));
-            strcpy(layer->name, j_name->valuestring);
+        if (layer->chunk_table != NULL) {
+            for (uint32_t j = 0; j < layer->array_count; j++) {
+                Chunk * chunk = &layer->array[j];
+                bool resident = chunk->data != NULL;
+                uint32_t * data = chunk_data(layer, chunk);
+                for (int k = 0; k < chunk->width * chunk->height; k++) {
+                    if (data[k] != 0) {
+                        map_collision_set(map, chunk->x + k % chunk->width, chunk->y + k / chunk->width, data[k]);
+                    }
+                }
+                if (!resident) {
+                    free(chunk->data);
+                    chunk->data = NULL;
+                }
+            }
+        } else if (layer->data != NULL) {
+            int width = SDL_min(layer->width, map->width);
+            int height = SDL_min(layer->height, map->height);
+            for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                    uint32_t gid = layer->data[col + row * layer->width];
+                    if (gid != 0) {
+                        map_collision_set(map, col, row, gid);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Mark the tile layers with image collection tiles, their tiles are drawn back to front instead of batched by texture
+static void map_find_overlapping_layers(Map * map) {
+    if (map->tile_overhang.x == 0 && map->tile_overhang.y == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        if (layer->data == NULL || layer->empty) {
+            continue;
         }
-        if (strcmp(j_type->valuestring, "objectgroup") == 0) {
-            map_parse_object_layer(j_layer, layer);
+        // Chunks of infinite maps are decoded while streaming, any of them may hold one
+        if (layer->chunk_table != NULL) {
+            layer->overlapping = true;
+            continue;
         }
-        if (strcmp(j_type->valuestring, "tilelayer") == 0) {
-            map_parse_tile_layer(j_layer, layer);
+        for (size_t j = 0; j < (size_t)layer->width * layer->height && !layer->overlapping; j++) {
+            uint32_t gid = layer->data[j];
+            Tileset * tileset = map_resolve_gid(map, &gid);
+            layer->overlapping = tileset != NULL && tileset->texture == NULL;
         }
-        layer_index++;
     }
-    
-    cJSON_Delete(map_json);
-    free(string);
-    return 0;
 }
 
+/**
+ * @brief Load a map and its tilesets, on the render thread
+ */
+void map_init(Map * map, const char *filename) {
+    map_load(map, filename);
+    map_attach_tilesets(map);
+}
+
+/**
+ * @brief Get the tilesets of a map from the tileset cache and build the gid lookup table
+ *
+ * Maps are loaded without tilesets so they can be loaded on the loader thread,
+ * call this on the render thread once the map is taken. Does nothing when the
+ * tilesets are already attached.
+ *
+ * @param map
+ */
+void map_attach_tilesets(Map * map) {
+    if (map->gid_tilesets != NULL || map->tileset_count == 0) {
+        return;
+    }
+    const char * separator = strrchr(map->filename, '/');
+    int directory_length = separator != NULL ? separator - map->filename + 1 : 0;
+    for (uint32_t i = 0; i < map->tileset_count; i++) {
+        MapTileset * tileset = &map->tilesets[i];
+        if (tileset->source == NULL) {
+            continue;
+        }
+        char filename[MAX_FILENAME_LENGTH];
+        snprintf(filename, sizeof(filename), "%.*s%s", directory_length, map->filename, tileset->source);
+        tileset->tileset = tileset_cache_acquire(filename);
+        if (tileset->tileset != NULL) {
+            map->gid_count = SDL_max(map->gid_count, tileset->first_gid + tileset->tileset->num_tiles);
+        }
+    }
+    if (map->gid_count == 0) {
+        return;
+    }
+    if (map->tileset_count >= MAP_NO_TILESET) {
+        log_error("Map %s has too many tilesets", map->filename);
+        exit(1);
+    }
+    map->gid_tilesets = malloc(map->gid_count * sizeof(uint16_t));
+    if (map->gid_tilesets == NULL) {
+        log_error("Failed to allocate gid table");
+        exit(1);
+    }
+    // Later tilesets start at higher gids and win where ranges overlap, like in Tiled
+    for (uint32_t gid = 0; gid < map->gid_count; gid++) {
+        map->gid_tilesets[gid] = MAP_NO_TILESET;
+    }
+    for (uint32_t i = 0; i < map->tileset_count; i++) {
+        MapTileset * tileset = &map->tilesets[i];
+        if (tileset->tileset == NULL) {
+            continue;
+        }
+        uint32_t end = SDL_min(tileset->first_gid + tileset->tileset->num_tiles, map->gid_count);
+        for (uint32_t gid = tileset->first_gid; gid < end; gid++) {
+            map->gid_tilesets[gid] = i;
+        }
+        // Tiled sizes image collections to their largest image
+        if (tileset->tileset->texture == NULL) {
+            map->tile_overhang.x = SDL_max(map->tile_overhang.x, (int)(tileset->tileset->tile_width + map->tilewidth - 1) / map->tilewidth - 1);
+            map->tile_overhang.y = SDL_max(map->tile_overhang.y, (int)(tileset->tileset->tile_height + map->tileheight - 1) / map->tileheight - 1);
+        }
+    }
+    map_find_overlapping_layers(map);
+    map_build_collision(map);
+}
 
-// Load map tiles using tiles.tsj json file for meta info
+/**
+ * @brief Give the tilesets of a map back to the tileset cache, on the render thread
+ */
+void map_detach_tilesets(Map * map) {
+    for (uint32_t i = 0; i < map->tileset_count; i++) {
+        tileset_cache_release(map->tilesets[i].tileset);
+        map->tilesets[i].tileset = NULL;
+    }
+    free(map->gid_tilesets);
+    map->gid_tilesets = NULL;
+    map->gid_count = 0;
+    free(map->collision);
+    map->collision = NULL;
+    map->tile_overhang = (SDL_Point){0, 0};
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        map->layers[i].overlapping = false;
+    }
+}
 
-void map_init(Map * map, Tileset * tileset, const char *filename) {
-    map->tileset = tileset;
-    map_load(map, filename);
+/**
+ * @brief Find the tileset of a gid
+ *
+ * @param map
+ * @param gid Global tile id including flip flags, rewritten to be relative to the returned tileset
+ * @return Tileset* NULL for the empty tile and gids without a loaded tileset
+ */
+Tileset * map_resolve_gid(Map * map, uint32_t * gid) {
+    uint32_t id = *gid & TILE_ID_MASK;
+    if (id == 0 || id >= map->gid_count || map->gid_tilesets[id] == MAP_NO_TILESET) {
+        return NULL;
+    }
+    MapTileset * tileset = &map->tilesets[map->gid_tilesets[id]];
+    *gid = (*gid & TILE_FLAG_MASK) | (id - tileset->first_gid + 1);
+    return tileset->tileset;
 }
 
 void map_draw_layer(App * app, Map * map, Layer * layer) {
+    uint16_t layer_index = (layer - map->layers) | (layer->overlapping ? RENDER_QUEUE_OVERLAP : 0);
     // Calculate start and end col and row pased on camera position
-    int32_t start_col = app->camera->x / map->tilewidth;
-    int32_t start_row = app->camera->y / map->tileheight;
+    int32_t start_col = floorf(app->camera->x / map->tilewidth);
+    int32_t start_row = floorf(app->camera->y / map->tileheight);
     int32_t end_col = start_col + ceil(app->camera->width / map->tilewidth) + 1;
     int32_t end_row = start_row + ceil(app->camera->height / map->tileheight) + 2;
-    if (end_row > layer->height) {
-        end_row = layer->height;
+    // Image collection tiles left of and below the view can reach into it
+    start_col -= map->tile_overhang.x;
+    end_row += map->tile_overhang.y;
+    // Check map bound and adjust start and end col and row, the camera can reach past the map when it is part of a world
+    if (start_col < 0) {
+        start_col = 0;
+    }
+    if (start_row < 0) {
+        start_row = 0;
     }
-
-    uint32_t offset_x = -app->camera->x + start_col * map->tilewidth;
-    uint32_t offset_y = -app->camera->y + start_row * map->tileheight;
-    // Check map bound and adjust end col and row
     if (end_col > layer->width) {
         end_col = layer->width;
-        offset_x = 0;
     }
     if (end_row > layer->height) {
         end_row = layer->height;
-        offset_y = 0;
     }
-    if (start_col < 0) {
-        start_col = 0;
-        offset_x = 0;
+    // Only tile layers with data are indexed
+    if (layer->occupancy == NULL || start_col >= end_col) {
+        return;
     }
-    if (start_row < 0) {
-        start_row = 0;
-        offset_y = 0;
-    }
-    // log_debug("Drawing layer w: %d h: %d p: %p, data_p: %p", layer->width, layer->height, layer, layer->data);
-    // log_debug("Drawing layer start_col: %d end_col: %d start_row: %d end_row: %d", start_col, end_col, start_row, end_row);
-    for (int i = start_col; i < end_col; i++) {
-        for (int j = start_row; j < end_row; j++) {
-            uint32_t tile_index = i+(j*layer->width);
-            if (tile_index > layer->width * layer->height) {
-                log_error("Tile index out of range");
+    // Walk the set bits of the occupancy rows, empty tiles are never visited
+    int first_word = start_col / 64;
+    int last_word = (end_col - 1) / 64;
+    for (int j = start_row; j < end_row; j++) {
+        const uint64_t * occupancy = &layer->occupancy[(size_t)j * layer->occupancy_words];
+        for (int word = first_word; word <= last_word; word++) {
+            uint64_t bits = occupancy[word];
+            if (word == first_word) {
+                bits &= ~(uint64_t)0 << (start_col % 64);
+            }
+            if (word == last_word) {
+                bits &= ~(uint64_t)0 >> (63 - (end_col - 1) % 64);
+            }
+            while (bits != 0) {
+                int i = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                uint32_t global_tile_id = layer->data[i + j * layer->width];
+                Tileset * tileset = map_resolve_gid(map, &global_tile_id);
+                if (tileset == NULL) {
+                    continue;
+                }
+                TilePlacement placement;
+                if (tileset_place_tile(tileset, global_tile_id, false, i * map->tilewidth - (int)app->camera->x, j * map->tileheight - (int)app->camera->y, map->tileheight, &placement)) {
+                    tileset_queue_placement(tileset, &placement, layer_index);
+                }
+            }
+        }
+    }
+}
+
+static void map_draw_chunked_layer(App * app, Map * map, Layer * layer) {
+    uint16_t layer_index = (layer - map->layers) | (layer->overlapping ? RENDER_QUEUE_OVERLAP : 0);
+    int32_t start_col = floorf(app->camera->x / map->tilewidth);
+    int32_t start_row = floorf(app->camera->y / map->tileheight);
+    int32_t end_col = floorf((app->camera->x + app->camera->width - 1) / map->tilewidth);
+    int32_t end_row = floorf((app->camera->y + app->camera->height - 1) / map->tileheight);
+    // Image collection tiles left of and below the view can reach into it
+    start_col -= map->tile_overhang.x;
+    end_row += map->tile_overhang.y;
+    // Walk the chunk grid under the camera and draw the visible part of every chunk
+    for (int chunk_row = chunk_floor_div(start_row, layer->chunkheight); chunk_row <= chunk_floor_div(end_row, layer->chunkheight); chunk_row++) {
+        for (int chunk_col = chunk_floor_div(start_col, layer->chunkwidth); chunk_col <= chunk_floor_div(end_col, layer->chunkwidth); chunk_col++) {
+            Chunk * chunk = chunk_find(layer, chunk_col, chunk_row);
+            if (chunk == NULL) {
                 continue;
             }
-            // Convert to local tile index TODO make work for multiple tilesets
-            uint32_t global_tile_id = layer->data[tile_index];
-            // log_debug("Drawing tile %d", tile_id);
-            int x = (i - start_col) * map->tilewidth + offset_x;
-            int y = (j - start_row) * map->tileheight + offset_y;
-            tileset_render_tile(app, map->tileset, global_tile_id, false, x, y, true);
+            uint32_t * data = chunk_data(layer, chunk);
+            int first_col = SDL_max(start_col, chunk->x);
+            int last_col = SDL_min(end_col, chunk->x + chunk->width - 1);
+            int first_row = SDL_max(start_row, chunk->y);
+            int last_row = SDL_min(end_row, chunk->y + chunk->height - 1);
+            for (int i = first_col; i <= last_col; i++) {
+                for (int j = first_row; j <= last_row; j++) {
+                    uint32_t global_tile_id = data[(i - chunk->x) + (j - chunk->y) * chunk->width];
+                    Tileset * tileset = map_resolve_gid(map, &global_tile_id);
+                    if (tileset == NULL) {
+                        continue;
+                    }
+                    TilePlacement placement;
+                    if (tileset_place_tile(tileset, global_tile_id, false, i * map->tilewidth - (int)app->camera->x, j * map->tileheight - (int)app->camera->y, map->tileheight, &placement)) {
+                        tileset_queue_placement(tileset, &placement, layer_index);
+                    }
+                }
+            }
         }
     }
 }
 
 void map_draw(App * app, Map * map) {
+    // Keep the chunks of infinite maps around the camera decoded
+    if (map->infinite) {
+        chunk_stream(map, app->camera);
+    }
     // Loop thourgh all layers and draw tiles
-    // log_debug("Drawing map %d", map->tileset->columns);
-    for (int i = 0; i < map->layer_count; i++) {
-        map_draw_layer(app, map, &map->layers[i]);
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        if (map->layers[i].empty) {
+            continue;
+        }
+        if (map->layers[i].chunk_table != NULL) {
+            map_draw_chunked_layer(app, map, &map->layers[i]);
+        } else if (map->layers[i].data != NULL && render_cache_enabled()) {
+            render_cache_draw_layer(app, map, i);
+        } else {
+            map_draw_layer(app, map, &map->layers[i]);
+        }
     }
 }
 
+/**
+ * @brief Free a map, everything but the decoded chunks of infinite maps goes with its arena
+ * 
+ * Maps that were drawn hold baked textures and tileset references, those have to be freed on the render thread.
+ * 
+ * @param map 
+ */
 void map_free(Map * map) {
-    // Free all layers
-    for (int i = 0; i < map->layer_count; i++) {
-        if (map->layers[i].data != NULL) {
-            free(map->layers[i].data);
-        }
-        if (map->layers[i].objects != NULL) {
-            for (int j = 0; j < map->layers[i].object_count; j++) {
-                for (int k = 0; k < map->layers[i].objects[j].property_count; k++) {
-                    if (map->layers[i].objects[j].properties[k].name != NULL) {
-                        free(map->layers[i].objects[j].properties[k].name);
-                    }
-                    if (map->layers[i].objects[j].properties[k].type != NULL) {
-                        free(map->layers[i].objects[j].properties[k].type);
-                    }
-                    if (map->layers[i].objects[j].properties[k].propertytype != NULL) {
-                        free(map->layers[i].objects[j].properties[k].propertytype);
-                    }
-                    if (map->layers[i].objects[j].properties[k].string_value != NULL) {
-                        free(map->layers[i].objects[j].properties[k].string_value);
-                    }
-                }
-                free(map->layers[i].objects[j].properties);
+    render_cache_free(map);
+    map_detach_tilesets(map);
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        chunk_free(&map->layers[i]);
+    }
+    map->layers = NULL;
+    map->layer_count = 0;
+    arena_free(&map->arena);
+    zmap_unload(map);
+}
+
+/**
+ * @brief Estimate the memory a loaded map uses
+ * 
+ * @param map 
+ * @return size_t Bytes
+ */
+size_t map_memory_size(Map * map) {
+    size_t size = map->arena.size + map->mapping_size;
+    if (map->collision != NULL) {
+        size += (size_t)MAP_COLLISION_COUNT * map->collision_words * map->collision_area.h * sizeof(uint64_t);
+    }
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        for (uint32_t j = 0; j < layer->array_count; j++) {
+            if (layer->array[j].data != NULL) {
+                size += (size_t)layer->array[j].width * layer->array[j].height * sizeof(uint32_t);
             }
-            free(map->layers[i].objects);
-        }
-        if (map->layers[i].type != NULL) {
-            free(map->layers[i].type);
-        }
-        if (map->layers[i].name != NULL) {
-            free(map->layers[i].name);
         }
     }
-    free(map->layers);
+    return size;
 }
 
-uint32_t map_get_tile_id_at_x_y(Map * map, int layer_index, int x, int y) {
+uint32_t map_get_tile_id_at_x_y(Map * map, uint32_t layer_index, int x, int y) {
     log_debug("Getting tile at %d %d", x, y);
-    if (layer_index > map->layer_count) {
+    if (layer_index >= map->layer_count) {
         log_error("Layer index out of range");
         return 0;
     }
@@ -366,20 +1085,23 @@ uint32_t map_get_tile_id_at_x_y(Map * map, int layer_index, int x, int y) {
     return layer->data[tile_index];
 }
 
-uint32_t map_get_tile_id_at_row_col(Map * map, int layer_index, int col, int row) {
+uint32_t map_get_tile_id_at_row_col(Map * map, uint32_t layer_index, int col, int row) {
     // log_debug("Getting tile at %d %d", row, col);
-    if (layer_index > map->layer_count) {
+    if (layer_index >= map->layer_count) {
         log_error("Layer index out of range");
         return 0;
     }
     Layer * layer = &map->layers[layer_index];
     // Check if layer is tile layer
-    if (layer->type != NULL && strcmp(layer->type, "tilelayer") != 0) {
+    if (layer->type != ATOM_NONE && layer->type != ATOM_TILELAYER) {
         //log_error("Layer is not a tile layer");
         return 0;
     }
-    if (row < 0 || col < 0 || row > (layer->width) || row > (layer->height)) {
-        log_error("Tile index out of range %d %d %s", row, col, layer->type);
+    if (layer->chunk_table != NULL) {
+        return chunk_get_tile_id(layer, col, row);
+    }
+    if (row < 0 || col < 0 || col >= layer->width || row >= layer->height) {
+        log_error("Tile index out of range %d %d %s", row, col, atom_name(layer->type));
         return 0;
     }
 
@@ -388,26 +1110,29 @@ uint32_t map_get_tile_id_at_row_col(Map * map, int layer_index, int col, int row
     return layer->data[tile_index];
 }
 
-Tile * map_get_tile_at(Map * map, int col, int row) {
+// Topmost tile at a position that has data in the tileset
+static TileInfo * map_get_tile_info_at(Map * map, int col, int row) {
     for (int i=map->layer_count-1;i>=0;i--) {
+        if (!map_layer_occupied(&map->layers[i], col, row)) {
+            continue;
+        }
         uint32_t global_tile_id = map_get_tile_id_at_row_col(map, i, col, row);
-        //log_debug("Global tile id: %d layer: %d", global_tile_id, i);
-        if (global_tile_id != 0) {
-            // Get tileset
-            Tileset * tileset = map->tileset;
-            // Get tileset tile
-            Tile * tile = tileset_get_tile_by_id(tileset, global_tile_id, false);
-            if (tile == NULL) {
-                // log_error("Tile not found");
-                continue;
-            } else {
-                return tile;
+        Tileset * tileset = map_resolve_gid(map, &global_tile_id);
+        if (tileset != NULL) {
+            TileInfo * info = tileset_get_info(tileset, global_tile_id, false);
+            if (info != NULL && info->tile != NULL) {
+                return info;
             }
         }
     }
     return NULL;
 }
 
+Tile * map_get_tile_at(Map * map, int col, int row) {
+    TileInfo * info = map_get_tile_info_at(map, col, row);
+    return info != NULL ? info->tile : NULL;
+}
+
 /**
  * @brief Check for collision at col, row tile position
  * 
@@ -419,59 +1144,98 @@ Tile * map_get_tile_at(Map * map, int col, int row) {
  * @return false Collision not detected
  */
 bool map_check_tile_collision(Map * map, int col, int row, SDL_Rect * bb_rect, SDL_Rect * intersection) {
-    Tile * tile = map_get_tile_at(map, col, row);
-    if (tile == NULL || bb_rect == NULL) {
+    TileInfo * info = map_get_tile_info_at(map, col, row);
+    if (info == NULL || bb_rect == NULL || !(info->flags & TILE_INFO_SOLID)) {
         return false;
     }
     SDL_Rect rect = {col * map->tilewidth, row * map->tileheight, map->tilewidth, map->tileheight};
-    for (int i=0;i<tile->property_count;i++) {
-        if (strcmp(tile->properties[i].name, "solid") == 0 && tile->properties[i].bool_value == true) {
-            return SDL_IntersectRect(&rect, bb_rect, intersection);
+    return SDL_IntersectRect(&rect, bb_rect, intersection);
+}
+
+/**
+ * @brief Check a box against the collision grid
+ *
+ * The cells under the box are tested a word of 64 cells at a time, the rows
+ * are combined first so the leftmost colliding column is found right away.
+ * Outside of the grid, and before the tilesets are attached, nothing collides.
+ *
+ * @param map
+ * @param channels MAP_COLLISION_BIT of every channel to check
+ * @param box Pixel area to check
+ * @param intersection Overlap of the box with the topmost colliding cell of the leftmost colliding column
+ * @return true The box overlaps a cell of one of the channels
+ */
+bool map_check_box_collision(Map * map, uint32_t channels, const SDL_Rect * box, SDL_Rect * intersection) {
+    if (map->collision == NULL || box->w <= 0 || box->h <= 0) {
+        return false;
+    }
+    SDL_Rect * area = &map->collision_area;
+    int first_col = SDL_max(chunk_floor_div(box->x, map->tilewidth), area->x) - area->x;
+    int last_col = SDL_min(chunk_floor_div(box->x + box->w - 1, map->tilewidth), area->x + area->w - 1) - area->x;
+    int first_row = SDL_max(chunk_floor_div(box->y, map->tileheight), area->y) - area->y;
+    int last_row = SDL_min(chunk_floor_div(box->y + box->h - 1, map->tileheight), area->y + area->h - 1) - area->y;
+    if (first_col > last_col || first_row > last_row) {
+        return false;
+    }
+    int first_word = first_col / 64;
+    int last_word = last_col / 64;
+    for (int word = first_word; word <= last_word; word++) {
+        uint64_t mask = ~(uint64_t)0;
+        if (word == first_word) {
+            mask &= ~(uint64_t)0 << (first_col % 64);
+        }
+        if (word == last_word) {
+            mask &= ~(uint64_t)0 >> (63 - last_col % 64);
+        }
+        uint64_t columns = 0;
+        for (int channel = 0; channel < MAP_COLLISION_COUNT; channel++) {
+            if (!(channels & MAP_COLLISION_BIT(channel))) {
+                continue;
+            }
+            for (int row = first_row; row <= last_row; row++) {
+                columns |= map_collision_row(map, channel, row)[word];
+            }
+        }
+        columns &= mask;
+        if (columns == 0) {
+            continue;
+        }
+        int col = word * 64 + __builtin_ctzll(columns);
+        uint64_t bit = (uint64_t)1 << (col % 64);
+        for (int row = first_row; row <= last_row; row++) {
+            for (int channel = 0; channel < MAP_COLLISION_COUNT; channel++) {
+                if ((channels & MAP_COLLISION_BIT(channel)) && (map_collision_row(map, channel, row)[word] & bit)) {
+                    SDL_Rect cell = {(col + area->x) * map->tilewidth, (row + area->y) * map->tileheight, map->tilewidth, map->tileheight};
+                    return SDL_IntersectRect(&cell, box, intersection);
+                }
+            }
         }
     }
     return false;
 }
 
-bool map_check_object_collisions(Map * map, const char * name, SDL_Rect * player_rect, void (*collision_callback)(Property * property, void * data), void* data) {
-    for (int i=0;i<map->layer_count;i++) {
+bool map_check_object_collisions(Map * map, Atom name, SDL_Rect * player_rect, void (*collision_callback)(Property * property, void * data), void* data) {
+    for (uint32_t i=0;i<map->layer_count;i++) {
         Layer * layer = &map->layers[i];
-        if (layer == NULL) {
-            continue;
-        }
-        if (strcmp(layer->type, "objectgroup") != 0) {
+        if (layer->type != ATOM_OBJECTGROUP) {
             continue;
         }
-        // log_debug("Checking objects in layer: %s count: %d", map->layers[i].name, map->layers[i].object_count);
-        for (int j=0;j<layer->object_count;j++) {
+        // log_debug("Checking objects in layer: %s count: %d", atom_name(map->layers[i].name), map->layers[i].object_count);
+        for (size_t j=0;j<layer->object_count;j++) {
             Object * object = &layer->objects[j];
-            if (object == NULL) {
+            // Read property for warp
+            Property * property = property_find(object->properties, object->property_count, object->property_mask, name);
+            if (property == NULL || property->type != PROPERTY_TYPE_STRING || property->string_value == NULL) {
                 continue;
             }
-            // Read property for warp
-            for (int k=0;k<object->property_count;k++) {
-                // log_debug("Object property: %s", object->properties[k].name);
-                Property * property = &object->properties[k];
-                if (property == NULL) {
-                    continue;
-                }
-                if (property->name == NULL || property->type == NULL) {
-                    continue;
-                }
-                if (strcmp(property->name, "warp") != 0) {
-                    continue;
-                }
-                if (strcmp(property->type, "string") != 0) {
-                    continue;
-                }
-                SDL_Point object_point = {(int)object->x, (int)object->y};
-                if (!SDL_PointInRect(&object_point, player_rect)) {
-                    continue;
-                }
-                // Callback collision function
-                log_debug("Collision detected with object: %s", property->string_value);
-                collision_callback(property, data);
-                return true;
+            SDL_Point object_point = {(int)object->x, (int)object->y};
+            if (!SDL_PointInRect(&object_point, player_rect)) {
+                continue;
             }
+            // Callback collision function
+            log_debug("Collision detected with object: %s", property->string_value);
+            collision_callback(property, data);
+            return true;
         }
     }
     return false;
@@ -0,0 +1,276 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader.h"
+#include "map_cache.h"
+#include "render_cache.h"
+
+// Logging
+#include <log.h>
+
+typedef enum MapCacheState
+{
+    MAP_CACHE_LOADING,
+    MAP_CACHE_READY,
+    MAP_CACHE_IN_USE // Taken, only kept to skip prefetching a second copy
+} MapCacheState;
+
+typedef struct MapCacheEntry
+{
+    char filename[MAX_FILENAME_LENGTH];
+    MapCacheState state;
+    LoaderJob *job;
+    Map map;
+    size_t size;
+    Uint64 last_used;
+    bool pinned; // Requested, kept until it is taken
+} MapCacheEntry;
+
+static MapCacheEntry * map_cache_entries;
+static size_t map_cache_count;
+static size_t map_cache_capacity;
+static size_t map_cache_budget;
+static size_t map_cache_used;
+static Uint64 map_cache_clock;
+
+static MapCacheEntry * map_cache_find(const char * filename, MapCacheState state) {
+    for (size_t i = 0; i < map_cache_count; i++) {
+        if (map_cache_entries[i].state == state && strcmp(map_cache_entries[i].filename, filename) == 0) {
+            return &map_cache_entries[i];
+        }
+    }
+    return NULL;
+}
+
+// A map has a single entry, whatever its state
+static MapCacheEntry * map_cache_find_any(const char * filename) {
+    for (size_t i = 0; i < map_cache_count; i++) {
+        if (strcmp(map_cache_entries[i].filename, filename) == 0) {
+            return &map_cache_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static MapCacheEntry * map_cache_add(const char * filename, MapCacheState state) {
+    if (map_cache_count == map_cache_capacity) {
+        map_cache_capacity = map_cache_capacity ? map_cache_capacity * 2 : 8;
+        map_cache_entries = realloc(map_cache_entries, map_cache_capacity * sizeof(MapCacheEntry));
+        if (map_cache_entries == NULL) {
+            log_error("Failed to allocate map cache");
+            exit(1);
+        }
+    }
+    MapCacheEntry * entry = &map_cache_entries[map_cache_count++];
+    *entry = (MapCacheEntry){.state = state};
+    snprintf(entry->filename, sizeof(entry->filename), "%s", filename);
+    if (state == MAP_CACHE_LOADING) {
+        entry->job = loader_request(filename);
+    }
+    return entry;
+}
+
+static void map_cache_remove(MapCacheEntry * entry) {
+    *entry = map_cache_entries[--map_cache_count];
+}
+
+// Free least recently used maps until the cache fits its budget again
+static void map_cache_trim(void) {
+    while (map_cache_used > map_cache_budget) {
+        MapCacheEntry * oldest = NULL;
+        for (size_t i = 0; i < map_cache_count; i++) {
+            MapCacheEntry * entry = &map_cache_entries[i];
+            if (entry->state == MAP_CACHE_READY && !entry->pinned && (oldest == NULL || entry->last_used < oldest->last_used)) {
+                oldest = entry;
+            }
+        }
+        if (oldest == NULL) {
+            return;
+        }
+        log_debug("Evicting %s from the map cache (%zu bytes)", oldest->filename, oldest->size);
+        map_cache_used -= oldest->size;
+        // The loader thread frees the rest, it can not touch textures
+        render_cache_free(&oldest->map);
+        map_detach_tilesets(&oldest->map);
+        loader_free(&oldest->map);
+        map_cache_remove(oldest);
+    }
+}
+
+static void map_cache_ready(MapCacheEntry * entry) {
+    entry->state = MAP_CACHE_READY;
+    entry->size = map_memory_size(&entry->map);
+    entry->last_used = ++map_cache_clock;
+    map_cache_used += entry->size;
+}
+
+/**
+ * @brief Create the cache
+ *
+ * @param budget Bytes of maps that are not in use the cache keeps loaded
+ */
+void map_cache_init(size_t budget) {
+    map_cache_budget = budget;
+}
+
+void map_cache_quit(void) {
+    for (size_t i = 0; i < map_cache_count; i++) {
+        MapCacheEntry * entry = &map_cache_entries[i];
+        if (entry->state == MAP_CACHE_LOADING) {
+            loader_cancel(entry->job);
+        } else if (entry->state == MAP_CACHE_READY) {
+            map_free(&entry->map);
+        }
+    }
+    free(map_cache_entries);
+    map_cache_entries = NULL;
+    map_cache_count = 0;
+    map_cache_capacity = 0;
+    map_cache_used = 0;
+}
+
+/**
+ * @brief Adopt maps the loader thread finished and evict maps over the budget, call once per frame
+ */
+void map_cache_update(void) {
+    for (size_t i = 0; i < map_cache_count; i++) {
+        MapCacheEntry * entry = &map_cache_entries[i];
+        if (entry->state == MAP_CACHE_LOADING && loader_done(entry->job)) {
+            loader_take(entry->job, &entry->map);
+            entry->job = NULL;
+            map_cache_ready(entry);
+            log_debug("Prefetched %s (%zu bytes)", entry->filename, entry->size);
+        }
+    }
+    map_cache_trim();
+}
+
+/**
+ * @brief Load a map in the background unless it is cached, loading or in use
+ *
+ * @param filename
+ */
+void map_cache_prefetch(const char * filename) {
+    if (map_cache_find_any(filename) == NULL) {
+        map_cache_add(filename, MAP_CACHE_LOADING);
+    }
+}
+
+/**
+ * @brief Prefetch the destinations of the warp objects of a map
+ *
+ * Warp destinations are asset names, they are looked up next to the map.
+ *
+ * @param map
+ */
+void map_cache_prefetch_warps(Map * map) {
+    const char * separator = strrchr(map->filename, '/');
+    int directory_length = separator != NULL ? separator - map->filename + 1 : 0;
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        for (size_t j = 0; j < layer->object_count; j++) {
+            Object * object = &layer->objects[j];
+            Property * property = property_find(object->properties, object->property_count, object->property_mask, ATOM_WARP);
+            char asset_name[99];
+            if (property == NULL || !property_has_string(property) || property->string_value == NULL ||
+                sscanf(property->string_value, "%98[^:]", asset_name) != 1) {
+                continue;
+            }
+            char filename[MAX_FILENAME_LENGTH];
+            snprintf(filename, sizeof(filename), "%.*s%s", directory_length, map->filename, asset_name);
+            if (strcmp(filename, map->filename) != 0) {
+                map_cache_prefetch(filename);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Make sure a map gets loaded and stays cached until it is taken
+ *
+ * A map that is in use is not loaded a second time, its user has to hand it
+ * over or give it back to the cache.
+ *
+ * @param filename
+ */
+void map_cache_request(const char * filename) {
+    MapCacheEntry * entry = map_cache_find_any(filename);
+    if (entry == NULL) {
+        entry = map_cache_add(filename, MAP_CACHE_LOADING);
+    }
+    entry->pinned = true;
+}
+
+void map_cache_cancel(const char * filename) {
+    MapCacheEntry * entry = map_cache_find_any(filename);
+    if (entry != NULL) {
+        entry->pinned = false;
+    }
+}
+
+static void map_cache_take_entry(MapCacheEntry * entry, Map * map) {
+    *map = entry->map;
+    entry->map = (Map){0};
+    entry->state = MAP_CACHE_IN_USE;
+    entry->pinned = false;
+    map_cache_used -= entry->size;
+    map_cache_prefetch_warps(map);
+}
+
+/**
+ * @brief Move a cached map out of the cache
+ *
+ * @param filename
+ * @param map Receives the map
+ * @return true The map was cached, false when it is not loaded (yet)
+ */
+bool map_cache_take(const char * filename, Map * map) {
+    map_cache_update();
+    MapCacheEntry * entry = map_cache_find(filename, MAP_CACHE_READY);
+    if (entry == NULL) {
+        return false;
+    }
+    map_cache_take_entry(entry, map);
+    return true;
+}
+
+/**
+ * @brief Take a map from the cache, waiting for it to load when it is not cached
+ *
+ * @param filename
+ * @param map Receives the map
+ */
+void map_cache_load(const char * filename, Map * map) {
+    map_cache_request(filename);
+    MapCacheEntry * entry = map_cache_find_any(filename);
+    if (entry->state == MAP_CACHE_IN_USE) {
+        log_error("Map %s is already in use", filename);
+        exit(1);
+    }
+    if (entry->state == MAP_CACHE_LOADING) {
+        loader_take(entry->job, &entry->map);
+        entry->job = NULL;
+        map_cache_ready(entry);
+    }
+    map_cache_take_entry(entry, map);
+}
+
+/**
+ * @brief Give a map that is no longer used back to the cache, call on the render thread
+ *
+ * The map keeps its tilesets, collision grid and baked layers so taking it
+ * again is free, they are dropped when the map is evicted. Eviction waits for
+ * the next map_cache_update(), giving a map back only moves it.
+ *
+ * @param map Moved into the cache and cleared
+ */
+void map_cache_put(Map * map) {
+    MapCacheEntry * entry = map_cache_find(map->filename, MAP_CACHE_IN_USE);
+    if (entry == NULL) {
+        entry = map_cache_add(map->filename, MAP_CACHE_READY);
+    }
+    entry->map = *map;
+    *map = (Map){0};
+    map_cache_ready(entry);
+}
@@ -0,0 +1,95 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pacing.h"
+
+// Logging
+#include <log.h>
+
+static FramePacing pacing_mode = FRAME_PACING_VSYNC;
+static int pacing_fps;
+static Uint64 pacing_period; // Performance counter ticks per frame of FRAME_PACING_TARGET
+static Uint64 pacing_deadline;
+static Uint64 pacing_previous;
+static int pacing_refresh_rate = PACING_DEFAULT_RATE; // Of the display the window is on
+
+/**
+ * @brief Pick the pacing from the command line
+ *
+ * @param value vsync, uncapped or a frame rate
+ * @return true The value is valid
+ */
+bool pacing_parse(const char * value) {
+    if (strcmp(value, "vsync") == 0) {
+        pacing_mode = FRAME_PACING_VSYNC;
+    } else if (strcmp(value, "uncapped") == 0) {
+        pacing_mode = FRAME_PACING_UNCAPPED;
+    } else if (atoi(value) > 0) {
+        pacing_mode = FRAME_PACING_TARGET;
+        pacing_fps = atoi(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Apply the pacing to the renderer and start the clock
+ */
+void pacing_init(SDL_Renderer * renderer) {
+    if (SDL_RenderSetVSync(renderer, pacing_mode == FRAME_PACING_VSYNC) != 0) {
+        log_warn("Failed to change vsync: %s", SDL_GetError());
+    }
+    if (pacing_mode == FRAME_PACING_TARGET) {
+        pacing_period = SDL_GetPerformanceFrequency() / pacing_fps;
+    }
+    SDL_DisplayMode mode;
+    SDL_Window * window = SDL_RenderGetWindow(renderer);
+    if (window != NULL && SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0) {
+        pacing_refresh_rate = mode.refresh_rate;
+    }
+    pacing_previous = pacing_deadline = SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief Wait until the next frame is due
+ *
+ * @return double Seconds since the previous call
+ */
+double pacing_wait(void) {
+    if (pacing_mode == FRAME_PACING_TARGET) {
+        pacing_deadline += pacing_period;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now > pacing_deadline) {
+            // More than a frame late, start over instead of rushing to catch up
+            pacing_deadline = now;
+        } else {
+            Uint64 spin = SDL_GetPerformanceFrequency() * PACING_SPIN_MS / 1000;
+            if (pacing_deadline - now > spin) {
+                SDL_Delay((pacing_deadline - now - spin) * 1000 / SDL_GetPerformanceFrequency());
+            }
+            while (SDL_GetPerformanceCounter() < pacing_deadline) {
+            }
+        }
+    }
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = (double)(now - pacing_previous) / SDL_GetPerformanceFrequency();
+    pacing_previous = now;
+    return elapsed;
+}
+
+/**
+ * @brief Milliseconds a frame may take to keep up with the pacing
+ *
+ * Uncapped frames aim for PACING_DEFAULT_RATE.
+ */
+double pacing_frame_ms(void) {
+    switch (pacing_mode) {
+        case FRAME_PACING_TARGET:
+            return 1000.0 / pacing_fps;
+        case FRAME_PACING_VSYNC:
+            return 1000.0 / pacing_refresh_rate;
+        default:
+            return 1000.0 / PACING_DEFAULT_RATE;
+    }
+}
@@ -4,14 +4,19 @@
 #include "draw.h"
 #include "tileset.h"
 #include "player.h"
+#include "render_queue.h"
 #include <math.h>
 
 #include "assets.h"
+#include "warp.h"
 
 // Logging
 #include <log.h>
 
 struct Entity player;
+// Interpolated position and tile to draw with
+static SDL_Point player_render;
+static int player_render_tile = -1;
 
 #define PLAYER_BORDER_DISTANCE 10
 
@@ -32,30 +37,31 @@ struct Entity * player_get() {
     return &player;
 }
 
+/**
+ * @brief Tile the player is drawn with, the facing tile or its current animation frame
+ *
+ * @param entity Player, or a snapshot copy of it
+ */
+int player_tile_id(const struct Entity * entity) {
+    if (entity->move_speed > 0) {
+        return tileset_animation_frame(entity->tileset, entity->facing, entity->animation_ticks);
+    }
+    return entity->facing;
+}
+
 void collision_callback(Property *property, void *data) {
     log_debug("Collision detected with object: %s", property->string_value);
-    // Load new map
-    Map * map = (Map *)data;
-    // Save tileset and property value before beeing freed
-    Tileset * tileset = map->tileset;
     int to_x, to_y;
     char asset_name[99];
     // Get x an y from property
     // Use sscanf to parse the string
     if (sscanf(property->string_value, "%99[^:]:%d,%d", asset_name, &to_x, &to_y) == 3) {
-        // Successfully parsed
-        log_debug("Warping to map: %s x: %d y: %d", asset_name, to_x, to_y);
-
+        // Successfully parsed, the map is swapped in by warp_finish once it is loaded
         char * map_path = asset_path(asset_name);
-        // log_debug("Map width: %d height: %d", map->width, map->height);
-        map_free(map);
-        map_init(map, tileset, map_path);
-        // log_debug("Map width: %d height: %d", map->width, map->height);
-        // log_debug("Player x: %d y: %d", player.x, player.y);
-
-        player.x = to_x;
-        player.y = to_y;
-        // log_debug("Player x: %d y: %d dx: %f dy: %f",player.x, player.y,  player.dx, player.dy);
+        if (map_path == NULL) {
+            return;
+        }
+        warp_start(map_path, to_x, to_y);
     } else {
         // Parsing failed
         log_error("Failed to parse the input string: %s\nShould be in the format filename.tmj:x,y where x and y are coordinate to span the player on the new map", property->string_value);
@@ -88,6 +94,9 @@ void player_handle(App * app, Map * map, Camera *camera) {
     } else{
         player.move_speed = 0;
     }
+    if (player.move_speed > 0) {
+        player.animation_ticks += app->frame_ticks;
+    }
     
     player_move(map);
     // log_debug("Player x: %d y: %d abs %d %d",player.x, player.y, player.x_abs, player.y_abs);
@@ -95,59 +104,29 @@ void player_handle(App * app, Map * map, Camera *camera) {
 
 SDL_Rect player_get_collision_rect(int x, int y) {
     SDL_Rect rect = {x, y, player.width, player.height};
-    // Get player tile_id from tilemap and find bounding box
-    Tile * player_tile = tileset_get_tile_by_id(player.tileset, player.facing, true);
+    // The player tile of the facing direction holds the bounding box
+    TileInfo * player_tile = tileset_get_info(player.tileset, player.facing, true);
     if (player_tile == NULL) {
         log_error("Player tile not found");
         return rect;
     }
-    int player_x = x;
-    int player_y = y;
-    // Get bounding box position
-    for (int i=0;i<player_tile->objectgroup_count;i++) {
-        Layer * objectgroup = player_tile->objectgroup;
-        // log_debug("Object x: %d y: %d width: %d height: %d type: %s", objectgroup[i].x, objectgroup[i].y, objectgroup[i].width, objectgroup[i].height, objectgroup[i].type);
-        if (strcmp(objectgroup[i].type, "collision_box") == 0) {
-            int bounding_box_x = (player_x + objectgroup[i].x);
-            int bounding_box_y = (player_y + objectgroup[i].y);
-            int bounding_box_width = objectgroup[i].width;
-            int bounding_box_height = objectgroup[i].height;
-            rect.x = bounding_box_x;
-            rect.y = bounding_box_y;
-            rect.w = bounding_box_width;
-            rect.h = bounding_box_height;
-            return rect;
-        }
+    if (player_tile->flags & TILE_INFO_HITBOX) {
+        rect.x = x + player_tile->hitbox.x;
+        rect.y = y + player_tile->hitbox.y;
+        rect.w = player_tile->hitbox.w;
+        rect.h = player_tile->hitbox.h;
     }
-
     // If not bounding box was found return player tile position
     return rect;
 }
 
 bool player_check_map_collision(Map * map, SDL_Rect * player_rect, SDL_Rect * intersection) {
-    // Check for collision for each_tile under the player
-    int player_tile_col = player_rect->x / map->tilewidth;
-    int player_tile_row = player_rect->y / map->tileheight;
-    int player_tile_col_end = (player_rect->x + player_rect->w) / map->tilewidth;
-    int player_tile_row_end = (player_rect->y + player_rect->h) / map->tileheight;
-    for (int i=player_tile_col;i <= player_tile_col_end; i++) {
-        for (int j=player_tile_row;j <= player_tile_row_end; j++) {
-            //log_debug("Checking collision at x: %d y: %d", i, j);
-            if (map_check_tile_collision(map, i, j, player_rect, intersection)) {
-                //log_debug("Collision box x: %d y: %d w: %d h: %d", intersection->x, intersection->y, intersection->w, intersection->h);
-                // Prevent player from moving
-                // Fix player direction during collision
-                //log_debug("Collision detected at x: %d [%d %d] y: %d [%d %d]", i,player_tile_col, player_tile_col_end, j, player_tile_row, player_tile_row_end);
-                return true;
-            }
-        }
-    }
-    return false;
+    // Solid tiles under the player, straight from the collision grid of the map
+    return map_check_box_collision(map, MAP_COLLISION_BIT(MAP_COLLISION_SOLID), player_rect, intersection);
 }
 
 void player_move(Map * map) {
-    int map_width = map->width * map->tilewidth;
-    int map_height = map->height * map->tileheight;
+    SDL_Rect * bounds = &map->bounds;
     // Check collision in x direction
     SDL_Rect player_rect = player_get_collision_rect(player.x + player.dx, player.y);
     SDL_Rect distance = {0, 0, 0, 0};
@@ -178,7 +157,7 @@ void player_move(Map * map) {
         player.dy = PLAYER_SPEED - distance.h;
     }
     // Map object collision check
-    map_check_object_collisions(map, "warp", &player_rect, collision_callback, map);
+    map_check_object_collisions(map, ATOM_WARP, &player_rect, collision_callback, map);
 
     // Keep player in the center of the camera until the camera hits the edge of the map
     // X Axis movement
@@ -190,17 +169,17 @@ void player_move(Map * map) {
     // log_debug("Camera x: %f y: %f", camera->x, camera->y);
 
     // Prevent player from moving outside of map
-    if (player.x < 0) {
-        player.x = 0;
+    if (player.x < bounds->x) {
+        player.x = bounds->x;
     }
-    if (player.y < 0) {
-        player.y = 0;
+    if (player.y < bounds->y) {
+        player.y = bounds->y;
     }
-    if (player.x > map_width - player.width) {
-        player.x = map_width - player.width;
+    if (player.x > bounds->x + bounds->w - player.width) {
+        player.x = bounds->x + bounds->w - player.width;
     }
-    if (player.y > map_height - player.height) {
-        player.y = map_height - player.height;
+    if (player.y > bounds->y + bounds->h - player.height) {
+        player.y = bounds->y + bounds->h - player.height;
     }
     // Reset player dx and dy
     player.dx = 0;
@@ -209,11 +188,40 @@ void player_move(Map * map) {
     //log_debug("Player x: %d y: %d", player.x, player.y);
 }
 
+/**
+ * @brief Remember the position of the player before a simulation tick moves it
+ */
+void player_save_state(void) {
+    player.previous_x = player.x;
+    player.previous_y = player.y;
+}
+
+/**
+ * @brief Place the player between its previous and current tick for drawing
+ *
+ * Marks the scene dirty when the player moved onto another pixel or changed tile.
+ *
+ * @param entity Player as of the tick to draw, a snapshot copy
+ * @param tile Tile resolved for the tick with player_tile_id()
+ * @param alpha Fraction of a tick since the current tick, 0 to 1
+ */
+void player_interpolate(const struct Entity * entity, int tile, float alpha) {
+    SDL_Point render = {
+        entity->previous_x + (int)floorf((entity->x - entity->previous_x) * alpha + 0.5f),
+        entity->previous_y + (int)floorf((entity->y - entity->previous_y) * alpha + 0.5f),
+    };
+    if (render.x != player_render.x || render.y != player_render.y || tile != player_render_tile) {
+        player_render = render;
+        player_render_tile = tile;
+        draw_mark_dirty();
+    }
+}
+
 void player_draw(App * app)
 {
 	// Draw player
     Camera * camera = app->camera;
-    tileset_render_tile(app, player.tileset, player.facing, true, player.x - camera->x, player.y - camera->y, player.move_speed > 0 ? 1 : 0);
+    tileset_queue_tile(player.tileset, player_render_tile, true, player_render.x - camera->x, player_render.y - camera->y, false, RENDER_QUEUE_SPRITE_LAYER);
 }
 
 void player_free() {
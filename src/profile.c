@@ -0,0 +1,263 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdio.h>
+#include "assets.h"
+#include "draw.h"
+#include "profile.h"
+#include "resolution.h"
+
+// Logging
+#include <log.h>
+
+#define PROFILE_HUD_X 8
+#define PROFILE_HUD_Y 8
+#define PROFILE_HUD_WIDTH (PROFILE_HISTORY * 2)
+#define PROFILE_GRAPH_HEIGHT 100
+#define PROFILE_GRAPH_MS 33.3f // Frame time at the top of the graph
+
+static const char * profile_stage_names[PROFILE_STAGE_COUNT] = {
+    [PROFILE_STAGE_UPDATE] = "update",
+    [PROFILE_STAGE_INPUT] = "input",
+    [PROFILE_STAGE_PLAYER] = "player",
+    [PROFILE_STAGE_MAP] = "map",
+    [PROFILE_STAGE_SPRITES] = "sprites",
+    [PROFILE_STAGE_FLUSH] = "flush",
+    [PROFILE_STAGE_CAMERA] = "camera",
+    [PROFILE_STAGE_SCREEN] = "screen",
+    [PROFILE_STAGE_HUD] = "hud",
+    [PROFILE_STAGE_PRESENT] = "present",
+};
+
+// Ring buffer of the last frames, the frame with number n is at n % PROFILE_HISTORY
+static float profile_stage_ms[PROFILE_HISTORY][PROFILE_STAGE_COUNT];
+static float profile_frame_ms[PROFILE_HISTORY]; // Sum of the stages
+static float profile_interval_ms[PROFILE_HISTORY]; // Since the previous frame began, includes the frame cap
+static Uint64 profile_frame_count;
+static float profile_current[PROFILE_STAGE_COUNT];
+static Uint64 profile_totals[PROFILE_STAGE_COUNT];
+static Uint64 profile_frame_start;
+static Uint64 profile_previous_start;
+static Uint64 profile_mark;
+static double profile_ticks_per_ms;
+static const char * profile_output;
+
+static bool profile_hud_visible;
+static bool profile_key_held;
+static TTF_Font * profile_font;
+static SDL_Texture * profile_text;
+static int profile_text_width;
+static int profile_text_height;
+static uint64_t profile_text_ticks;
+
+/**
+ * @brief Start profiling, the HUD text needs PROFILE_HUD_FONT in the assets
+ */
+void profile_init(App * app) {
+    profile_ticks_per_ms = SDL_GetPerformanceFrequency() / 1000.0;
+    if (TTF_Init() != 0) {
+        log_warn("Failed to initialize SDL_ttf, the HUD shows no text: %s", TTF_GetError());
+        return;
+    }
+    char * path = asset_path(PROFILE_HUD_FONT);
+    profile_font = path != NULL ? TTF_OpenFont(path, PROFILE_HUD_FONT_SIZE) : NULL;
+    if (profile_font == NULL) {
+        log_warn("Failed to open the HUD font, the HUD shows no text");
+    }
+}
+
+/**
+ * @brief Write the CSV when an output was set and free the HUD
+ */
+void profile_quit(void) {
+    if (profile_output != NULL) {
+        FILE * file = fopen(profile_output, "w");
+        if (file == NULL) {
+            log_error("Failed to open profile output %s", profile_output);
+        } else {
+            fprintf(file, "frame");
+            for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+                fprintf(file, ",%s_ms", profile_stage_names[i]);
+            }
+            fprintf(file, ",frame_ms,interval_ms\n");
+            Uint64 first = profile_frame_count > PROFILE_HISTORY ? profile_frame_count - PROFILE_HISTORY : 0;
+            for (Uint64 frame = first; frame < profile_frame_count; frame++) {
+                size_t index = frame % PROFILE_HISTORY;
+                fprintf(file, "%llu", (unsigned long long)frame);
+                for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+                    fprintf(file, ",%.4f", profile_stage_ms[index][i]);
+                }
+                fprintf(file, ",%.4f,%.4f\n", profile_frame_ms[index], profile_interval_ms[index]);
+            }
+            fclose(file);
+            log_info("Wrote %llu frames to %s", (unsigned long long)(profile_frame_count - first), profile_output);
+        }
+    }
+    SDL_DestroyTexture(profile_text);
+    profile_text = NULL;
+    if (profile_font != NULL) {
+        TTF_CloseFont(profile_font);
+        profile_font = NULL;
+    }
+    if (TTF_WasInit()) {
+        TTF_Quit();
+    }
+}
+
+/**
+ * @brief Write the frames in the ring buffer to a CSV file on exit
+ *
+ * @param filename Kept, not copied
+ */
+void profile_set_output(const char * filename) {
+    profile_output = filename;
+}
+
+void profile_frame_begin(void) {
+    profile_frame_start = profile_mark = SDL_GetPerformanceCounter();
+    SDL_memset(profile_current, 0, sizeof(profile_current));
+}
+
+/**
+ * @brief End a stage, adds the time since the previous stage ended
+ *
+ * A stage can be ended more than once a frame.
+ */
+void profile_stage(ProfileStage stage) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    profile_current[stage] += (now - profile_mark) / profile_ticks_per_ms;
+    profile_totals[stage] += now - profile_mark;
+    profile_mark = now;
+}
+
+void profile_frame_end(void) {
+    size_t index = profile_frame_count % PROFILE_HISTORY;
+    float frame_ms = 0;
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        profile_stage_ms[index][i] = profile_current[i];
+        frame_ms += profile_current[i];
+    }
+    profile_frame_ms[index] = frame_ms;
+    profile_interval_ms[index] = profile_previous_start ? (profile_frame_start - profile_previous_start) / profile_ticks_per_ms : frame_ms;
+    profile_previous_start = profile_frame_start;
+    profile_frame_count++;
+}
+
+/**
+ * @brief Toggle the HUD when PROFILE_HUD_KEY goes down
+ */
+void profile_handle(App * app) {
+    bool pressed = app->keyboard[PROFILE_HUD_KEY];
+    if (pressed && !profile_key_held) {
+        profile_hud_visible = !profile_hud_visible;
+        profile_text_ticks = 0;
+    }
+    profile_key_held = pressed;
+}
+
+static void profile_render_text(App * app) {
+    size_t frames = SDL_min(profile_frame_count, PROFILE_HISTORY);
+    float average[PROFILE_STAGE_COUNT + 1] = {0};
+    float worst[PROFILE_STAGE_COUNT + 1] = {0};
+    float interval = 0;
+    for (size_t i = 0; i < frames; i++) {
+        for (int j = 0; j < PROFILE_STAGE_COUNT; j++) {
+            average[j] += profile_stage_ms[i][j] / frames;
+            worst[j] = SDL_max(worst[j], profile_stage_ms[i][j]);
+        }
+        average[PROFILE_STAGE_COUNT] += profile_frame_ms[i] / frames;
+        worst[PROFILE_STAGE_COUNT] = SDL_max(worst[PROFILE_STAGE_COUNT], profile_frame_ms[i]);
+        interval += profile_interval_ms[i] / frames;
+    }
+
+    char lines[PROFILE_STAGE_COUNT + 2][64];
+    snprintf(lines[0], sizeof(lines[0]), "%5.1f fps  %-8s %6.2f avg %6.2f max  %3.0f%%", interval > 0 ? 1000 / interval : 0, "frame", average[PROFILE_STAGE_COUNT], worst[PROFILE_STAGE_COUNT], resolution_scale() * 100);
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        snprintf(lines[i + 1], sizeof(lines[i + 1]), "%9s  %-8s %6.2f avg %6.2f max", "", profile_stage_names[i], average[i], worst[i]);
+    }
+    int line_height = TTF_FontLineSkip(profile_font);
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, PROFILE_HUD_WIDTH, line_height * (PROFILE_STAGE_COUNT + 1), 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        return;
+    }
+    for (int i = 0; i < PROFILE_STAGE_COUNT + 1; i++) {
+        SDL_Surface * line = TTF_RenderUTF8_Blended(profile_font, lines[i], (SDL_Color){255, 255, 255, 255});
+        if (line != NULL) {
+            SDL_SetSurfaceBlendMode(line, SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(line, NULL, surface, &(SDL_Rect){0, i * line_height, line->w, line->h});
+            SDL_FreeSurface(line);
+        }
+    }
+    SDL_DestroyTexture(profile_text);
+    profile_text = SDL_CreateTextureFromSurface(app->renderer, surface);
+    profile_text_width = surface->w;
+    profile_text_height = surface->h;
+    SDL_FreeSurface(surface);
+}
+
+/**
+ * @brief Draw the HUD onto the current render target when it is visible
+ *
+ * The frame time graph is drawn every frame, the text is rendered again every
+ * PROFILE_HUD_REFRESH_MS so it stays readable and cheap.
+ */
+void profile_draw_hud(App * app) {
+    if (!profile_hud_visible) {
+        return;
+    }
+    if (profile_font != NULL && (profile_text == NULL || profile_text_ticks == 0 || app->ticks - profile_text_ticks >= PROFILE_HUD_REFRESH_MS)) {
+        profile_render_text(app);
+        profile_text_ticks = SDL_max(app->ticks, 1);
+    }
+    int text_height = profile_text != NULL ? profile_text_height : 0;
+    SDL_Rect panel = {PROFILE_HUD_X, PROFILE_HUD_Y, PROFILE_HUD_WIDTH + 8, text_height + PROFILE_GRAPH_HEIGHT + 12};
+    SDL_SetRenderDrawBlendMode(app->renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(app->renderer, &panel);
+    if (profile_text != NULL) {
+        SDL_Rect dest = {panel.x + 4, panel.y + 4, profile_text_width, profile_text_height};
+        draw_texture(app->renderer, profile_text, NULL, &dest, SDL_FLIP_NONE);
+    }
+
+    // One bar per frame, oldest on the left, colored by the frame budget it fits in
+    SDL_Rect bars[3][PROFILE_HISTORY];
+    int bar_count[3] = {0};
+    size_t frames = SDL_min(profile_frame_count, PROFILE_HISTORY);
+    int bottom = panel.y + panel.h - 4;
+    for (size_t i = 0; i < frames; i++) {
+        float ms = profile_frame_ms[(profile_frame_count - frames + i) % PROFILE_HISTORY];
+        int height = SDL_clamp((int)(ms / PROFILE_GRAPH_MS * PROFILE_GRAPH_HEIGHT), 1, PROFILE_GRAPH_HEIGHT);
+        int color = ms < 1000.0f / 60 ? 0 : ms < 1000.0f / 30 ? 1 : 2;
+        bars[color][bar_count[color]++] = (SDL_Rect){panel.x + 4 + (int)i * 2, bottom - height, 2, height};
+    }
+    static const SDL_Color colors[3] = {{80, 220, 80, 255}, {240, 200, 60, 255}, {240, 70, 60, 255}};
+    for (int i = 0; i < 3; i++) {
+        SDL_SetRenderDrawColor(app->renderer, colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+        SDL_RenderFillRects(app->renderer, bars[i], bar_count[i]);
+    }
+    // 60 fps line
+    int budget = bottom - (int)(1000.0f / 60 / PROFILE_GRAPH_MS * PROFILE_GRAPH_HEIGHT);
+    SDL_SetRenderDrawColor(app->renderer, 255, 255, 255, 120);
+    SDL_RenderDrawLine(app->renderer, panel.x + 4, budget, panel.x + 4 + PROFILE_HUD_WIDTH, budget);
+}
+
+const char * profile_stage_name(ProfileStage stage) {
+    return profile_stage_names[stage];
+}
+
+/**
+ * @brief Milliseconds spent in a stage since the start
+ */
+double profile_stage_total(ProfileStage stage) {
+    return profile_totals[stage] / profile_ticks_per_ms;
+}
+
+/**
+ * @brief Milliseconds the last frame took before it was presented
+ */
+float profile_last_frame_ms(void) {
+    if (profile_frame_count == 0) {
+        return 0;
+    }
+    size_t index = (profile_frame_count - 1) % PROFILE_HISTORY;
+    return profile_frame_ms[index] - profile_stage_ms[index][PROFILE_STAGE_PRESENT];
+}
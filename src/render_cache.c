@@ -0,0 +1,204 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include "draw.h"
+#include "render_cache.h"
+#include "render_queue.h"
+
+// Logging
+#include <log.h>
+
+static bool render_cache_on = true;
+
+void render_cache_set_enabled(bool enabled) {
+    render_cache_on = enabled;
+}
+
+bool render_cache_enabled(void) {
+    return render_cache_on;
+}
+
+static bool render_cache_is_animated(Map * map, uint32_t gid) {
+    Tileset * tileset = map_resolve_gid(map, &gid);
+    TileInfo * info = tileset != NULL ? tileset_get_info(tileset, gid, false) : NULL;
+    return info != NULL && ((info->flags & TILE_INFO_ANIMATED) || info->image != NULL);
+}
+
+// Tileset of a tile that is baked into the chunks, NULL for empty, animated, streamed and unknown tiles
+static Tileset * render_cache_static_tileset(Map * map, uint32_t * gid) {
+    Tileset * tileset = map_resolve_gid(map, gid);
+    TileInfo * info = tileset != NULL ? tileset_get_info(tileset, *gid, false) : NULL;
+    return info != NULL && !(info->flags & TILE_INFO_ANIMATED) && info->image == NULL ? tileset : NULL;
+}
+
+static void render_cache_build_layer(Map * map, Layer * layer, RenderLayer * render_layer) {
+    int size = RENDER_CACHE_CHUNK_SIZE;
+    render_layer->columns = (layer->width * map->tilewidth + size - 1) / size;
+    render_layer->rows = (layer->height * map->tileheight + size - 1) / size;
+    render_layer->chunks = calloc((size_t)render_layer->columns * render_layer->rows, sizeof(RenderChunk));
+    if (render_layer->chunks == NULL) {
+        log_error("Failed to allocate render chunks");
+        exit(1);
+    }
+    size_t capacity = 0;
+    for (size_t i = 0; i < (size_t)layer->width * layer->height; i++) {
+        if (!render_cache_is_animated(map, layer->data[i])) {
+            continue;
+        }
+        if (render_layer->animated_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            render_layer->animated = realloc(render_layer->animated, capacity * sizeof(uint32_t));
+            if (render_layer->animated == NULL) {
+                log_error("Failed to allocate animated tiles");
+                exit(1);
+            }
+        }
+        render_layer->animated[render_layer->animated_count++] = i;
+    }
+}
+
+// Draw the static tiles under a chunk into its texture
+static void render_cache_bake(App * app, Map * map, Layer * layer, RenderChunk * chunk, int chunk_col, int chunk_row) {
+    int size = RENDER_CACHE_CHUNK_SIZE;
+    int first_col = chunk_col * size / map->tilewidth;
+    int first_row = chunk_row * size / map->tileheight;
+    int last_col = SDL_min(((chunk_col + 1) * size - 1) / map->tilewidth, layer->width - 1);
+    int last_row = SDL_min(((chunk_row + 1) * size - 1) / map->tileheight, layer->height - 1);
+    chunk->baked = true;
+    bool empty = true;
+    for (int j = first_row; j <= last_row && empty; j++) {
+        for (int i = first_col; i <= last_col && empty; i++) {
+            uint32_t gid = layer->data[i + j * layer->width];
+            empty = render_cache_static_tileset(map, &gid) == NULL;
+        }
+    }
+    if (empty) {
+        return;
+    }
+
+    chunk->texture = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, size, size);
+    if (chunk->texture == NULL) {
+        log_error("Failed to create render cache texture: %s", SDL_GetError());
+        exit(1);
+    }
+    // Blending onto a transparent target leaves premultiplied colors, draw them as such
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                             SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if (SDL_SetTextureBlendMode(chunk->texture, premultiplied) != 0) {
+        SDL_SetTextureBlendMode(chunk->texture, SDL_BLENDMODE_BLEND);
+    }
+
+    SDL_Texture * target = SDL_GetRenderTarget(app->renderer);
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(app->renderer, &r, &g, &b, &a);
+    // Changing the target resets the scale of a scaled down camera target
+    float scale_x, scale_y;
+    SDL_RenderGetScale(app->renderer, &scale_x, &scale_y);
+    SDL_SetRenderTarget(app->renderer, chunk->texture);
+    SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 0);
+    SDL_RenderClear(app->renderer);
+    for (int j = first_row; j <= last_row; j++) {
+        for (int i = first_col; i <= last_col; i++) {
+            uint32_t gid = layer->data[i + j * layer->width];
+            Tileset * tileset = render_cache_static_tileset(map, &gid);
+            if (tileset == NULL) {
+                continue;
+            }
+            tileset_render_tile(app, tileset, gid, false, i * map->tilewidth - chunk_col * size, j * map->tileheight - chunk_row * size, false);
+        }
+    }
+    SDL_SetRenderTarget(app->renderer, target);
+    SDL_RenderSetScale(app->renderer, scale_x, scale_y);
+    SDL_SetRenderDrawColor(app->renderer, r, g, b, a);
+}
+
+/**
+ * @brief Draw a tile layer from its baked chunks and draw its animated tiles on top
+ *
+ * @param app
+ * @param map
+ * @param layer_index Layer with tile data, chunked layers of infinite maps are not cached
+ */
+void render_cache_draw_layer(App * app, Map * map, uint32_t layer_index) {
+    if (map->render_cache == NULL) {
+        map->render_cache = calloc(1, sizeof(RenderCache));
+        if (map->render_cache == NULL) {
+            log_error("Failed to allocate render cache");
+            exit(1);
+        }
+        map->render_cache->layer_count = map->layer_count;
+        map->render_cache->layers = calloc(map->layer_count, sizeof(RenderLayer));
+        if (map->render_cache->layers == NULL) {
+            log_error("Failed to allocate render cache layers");
+            exit(1);
+        }
+    }
+    Layer * layer = &map->layers[layer_index];
+    RenderLayer * render_layer = &map->render_cache->layers[layer_index];
+    uint16_t queue_layer = layer_index | (layer->overlapping ? RENDER_QUEUE_OVERLAP : 0);
+    if (render_layer->chunks == NULL) {
+        render_cache_build_layer(map, layer, render_layer);
+    }
+    Camera * camera = app->camera;
+    int size = RENDER_CACHE_CHUNK_SIZE;
+    int first_col = SDL_max((int)floorf(camera->x / size), 0);
+    int first_row = SDL_max((int)floorf(camera->y / size), 0);
+    int last_col = SDL_min((int)floorf((camera->x + camera->width) / size), render_layer->columns - 1);
+    int last_row = SDL_min((int)floorf((camera->y + camera->height) / size), render_layer->rows - 1);
+    for (int row = first_row; row <= last_row; row++) {
+        for (int col = first_col; col <= last_col; col++) {
+            RenderChunk * chunk = &render_layer->chunks[col + row * render_layer->columns];
+            if (!chunk->baked) {
+                render_cache_bake(app, map, layer, chunk, col, row);
+            }
+            if (chunk->texture == NULL) {
+                continue;
+            }
+            SDL_Rect dest = {col * size - (int)camera->x, row * size - (int)camera->y, size, size};
+            render_queue_push(chunk->texture, NULL, &dest, DRAW_FLIP_NONE, queue_layer, dest.y);
+        }
+    }
+
+    // Animated and streamed tiles change every few frames and are drawn one by one,
+    // culled by the area they really cover
+    SDL_Rect view = {0, 0, camera->width, camera->height};
+    for (size_t i = 0; i < render_layer->animated_count; i++) {
+        uint32_t index = render_layer->animated[i];
+        uint32_t gid = layer->data[index];
+        Tileset * tileset = map_resolve_gid(map, &gid);
+        if (tileset == NULL) {
+            continue;
+        }
+        TilePlacement placement;
+        if (!tileset_place_tile(tileset, gid, false, (index % layer->width) * map->tilewidth - (int)camera->x, (index / layer->width) * map->tileheight - (int)camera->y, map->tileheight, &placement) ||
+            !SDL_HasIntersection(&placement.dest, &view)) {
+            continue;
+        }
+        tileset_queue_placement(tileset, &placement, queue_layer);
+    }
+}
+
+/**
+ * @brief Destroy the baked textures of a map, call on the render thread
+ *
+ * @param map
+ */
+void render_cache_free(Map * map) {
+    RenderCache * cache = map->render_cache;
+    if (cache == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->layer_count; i++) {
+        RenderLayer * render_layer = &cache->layers[i];
+        for (int j = 0; j < render_layer->columns * render_layer->rows; j++) {
+            if (render_layer->chunks[j].texture != NULL) {
+                SDL_DestroyTexture(render_layer->chunks[j].texture);
+            }
+        }
+        free(render_layer->chunks);
+        free(render_layer->animated);
+    }
+    free(cache->layers);
+    free(cache);
+    map->render_cache = NULL;
+}
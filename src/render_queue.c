@@ -0,0 +1,240 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include "draw.h"
+#include "render_queue.h"
+
+// Logging
+#include <log.h>
+
+typedef struct RenderQuad
+{
+    uint64_t key; // Layer, texture slot and y, most significant first, y before the slot in overlapping layers
+    uint32_t order; // Push order, keeps the sort stable
+    uint16_t slot;
+    SDL_Rect src;
+    SDL_Rect dest;
+    DrawFlip flip;
+} RenderQuad;
+
+typedef struct RenderTexture
+{
+    SDL_Texture *texture;
+    float width;
+    float height;
+} RenderTexture;
+
+static RenderQuad * render_quads;
+static uint32_t render_quad_count;
+static uint32_t render_quad_capacity;
+
+// Textures used this frame, a quad refers to its texture by slot to keep the key small
+static RenderTexture * render_textures;
+static uint16_t render_texture_count;
+static uint16_t render_texture_capacity;
+
+// Vertex and index buffers, reused between frames
+static SDL_Vertex * render_vertices;
+static int * render_indices;
+static uint32_t render_vertex_capacity;
+
+static uint16_t render_queue_texture_slot(SDL_Texture * texture) {
+    for (uint16_t i = 0; i < render_texture_count; i++) {
+        if (render_textures[i].texture == texture) {
+            return i;
+        }
+    }
+    if (render_texture_count == render_texture_capacity) {
+        if (render_texture_capacity == UINT16_MAX) {
+            log_error("Too many textures in the render queue");
+            exit(1);
+        }
+        render_texture_capacity = render_texture_capacity ? SDL_min(render_texture_capacity * 2, UINT16_MAX) : 16;
+        render_textures = realloc(render_textures, render_texture_capacity * sizeof(RenderTexture));
+        if (render_textures == NULL) {
+            log_error("Failed to allocate render queue textures");
+            exit(1);
+        }
+    }
+    int width = 0;
+    int height = 0;
+    SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+    render_textures[render_texture_count] = (RenderTexture){texture, width, height};
+    return render_texture_count++;
+}
+
+/**
+ * @brief Queue a textured quad for the next flush
+ *
+ * @param texture
+ * @param src Part of the texture, NULL for all of it
+ * @param dest Position on the render target
+ * @param flip
+ * @param layer Quads on lower layers are drawn first, or'ed with RENDER_QUEUE_OVERLAP when its quads overlap
+ * @param y Sort position within the layer, usually the bottom of the quad
+ */
+void render_queue_push(SDL_Texture * texture, const SDL_Rect * src, const SDL_Rect * dest, DrawFlip flip, uint16_t layer, int y) {
+    if (render_quad_count == render_quad_capacity) {
+        render_quad_capacity = render_quad_capacity ? render_quad_capacity * 2 : 1024;
+        render_quads = realloc(render_quads, render_quad_capacity * sizeof(RenderQuad));
+        if (render_quads == NULL) {
+            log_error("Failed to allocate render queue");
+            exit(1);
+        }
+    }
+    uint16_t slot = render_queue_texture_slot(texture);
+    RenderQuad * quad = &render_quads[render_quad_count];
+    // Flip the sign bit so negative y sorts before positive y
+    uint64_t sort_y = (uint32_t)y ^ 0x80000000u;
+    uint64_t order = (uint64_t)(layer & ~RENDER_QUEUE_OVERLAP) << 48;
+    if (layer & RENDER_QUEUE_OVERLAP) {
+        // Back to front first, quads further down cover the ones above them whatever their texture
+        quad->key = order | sort_y << 16 | slot;
+    } else {
+        quad->key = order | (uint64_t)slot << 32 | sort_y;
+    }
+    quad->order = render_quad_count++;
+    quad->slot = slot;
+    quad->dest = *dest;
+    quad->flip = flip;
+    if (src != NULL) {
+        quad->src = *src;
+    } else {
+        RenderTexture * render_texture = &render_textures[slot];
+        quad->src = (SDL_Rect){0, 0, (int)render_texture->width, (int)render_texture->height};
+    }
+}
+
+static int render_queue_compare(const void * a, const void * b) {
+    const RenderQuad * quad_a = a;
+    const RenderQuad * quad_b = b;
+    if (quad_a->key != quad_b->key) {
+        return quad_a->key < quad_b->key ? -1 : 1;
+    }
+    return quad_a->order < quad_b->order ? -1 : quad_a->order > quad_b->order;
+}
+
+static void render_queue_reserve(uint32_t quads) {
+    if (quads * 4 <= render_vertex_capacity) {
+        return;
+    }
+    render_vertex_capacity = quads * 4;
+    render_vertices = realloc(render_vertices, render_vertex_capacity * sizeof(SDL_Vertex));
+    render_indices = realloc(render_indices, render_vertex_capacity / 4 * 6 * sizeof(int));
+    if (render_vertices == NULL || render_indices == NULL) {
+        log_error("Failed to allocate render queue vertices");
+        exit(1);
+    }
+}
+
+// Write the four corners of a quad, flipping swaps the texture coordinates
+static void render_queue_vertices(const RenderQuad * quad, const RenderTexture * texture, SDL_Vertex * vertex, int * index, int base) {
+    float u0 = quad->src.x / texture->width;
+    float v0 = quad->src.y / texture->height;
+    float u1 = (quad->src.x + quad->src.w) / texture->width;
+    float v1 = (quad->src.y + quad->src.h) / texture->height;
+    // Texture coordinates along the x and y axis of the quad, the diagonal flip swaps the axes
+    bool diagonal = quad->flip & DRAW_FLIP_DIAGONAL;
+    float x_from = diagonal ? v0 : u0;
+    float x_to = diagonal ? v1 : u1;
+    float y_from = diagonal ? u0 : v0;
+    float y_to = diagonal ? u1 : v1;
+    if (quad->flip & DRAW_FLIP_HORIZONTAL) {
+        float x = x_from;
+        x_from = x_to;
+        x_to = x;
+    }
+    if (quad->flip & DRAW_FLIP_VERTICAL) {
+        float y = y_from;
+        y_from = y_to;
+        y_to = y;
+    }
+    SDL_FPoint corners[4] = {{x_from, y_from}, {x_to, y_from}, {x_to, y_to}, {x_from, y_to}};
+    if (diagonal) {
+        for (int i = 0; i < 4; i++) {
+            corners[i] = (SDL_FPoint){corners[i].y, corners[i].x};
+        }
+    }
+    float x0 = quad->dest.x;
+    float y0 = quad->dest.y;
+    float x1 = quad->dest.x + quad->dest.w;
+    float y1 = quad->dest.y + quad->dest.h;
+    SDL_Color white = {255, 255, 255, 255};
+    vertex[0] = (SDL_Vertex){{x0, y0}, white, corners[0]};
+    vertex[1] = (SDL_Vertex){{x1, y0}, white, corners[1]};
+    vertex[2] = (SDL_Vertex){{x1, y1}, white, corners[2]};
+    vertex[3] = (SDL_Vertex){{x0, y1}, white, corners[3]};
+    index[0] = base;
+    index[1] = base + 1;
+    index[2] = base + 2;
+    index[3] = base;
+    index[4] = base + 2;
+    index[5] = base + 3;
+}
+
+/**
+ * @brief Draw and clear everything that was queued since the last flush
+ *
+ * @param renderer Draws to its current render target
+ */
+void render_queue_flush(SDL_Renderer * renderer) {
+    if (render_quad_count == 0) {
+        render_texture_count = 0;
+        return;
+    }
+    qsort(render_quads, render_quad_count, sizeof(RenderQuad), render_queue_compare);
+    render_queue_reserve(render_quad_count);
+    uint32_t start = 0;
+    while (start < render_quad_count) {
+        // Runs of the same texture become one batch, even across layers
+        uint16_t slot = render_quads[start].slot;
+        RenderTexture * texture = &render_textures[slot];
+        uint32_t end = start;
+        while (end < render_quad_count && render_quads[end].slot == slot) {
+            int quad = end - start;
+            render_queue_vertices(&render_quads[end], texture, &render_vertices[quad * 4], &render_indices[quad * 6], quad * 4);
+            end++;
+        }
+        int count = end - start;
+        draw_geometry(renderer, texture->texture, render_vertices, count * 4, render_indices, count * 6);
+        start = end;
+    }
+    render_quad_count = 0;
+    render_texture_count = 0;
+}
+
+/**
+ * @brief Draw a single quad right away, for textures drawn outside of the frame
+ *
+ * @param renderer Draws to its current render target
+ * @param texture
+ * @param src Part of the texture, NULL for all of it
+ * @param dest
+ * @param flip
+ */
+void render_queue_draw(SDL_Renderer * renderer, SDL_Texture * texture, const SDL_Rect * src, const SDL_Rect * dest, DrawFlip flip) {
+    int width = 0;
+    int height = 0;
+    SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+    RenderTexture render_texture = {texture, width, height};
+    RenderQuad quad = {.src = src != NULL ? *src : (SDL_Rect){0, 0, width, height}, .dest = *dest, .flip = flip};
+    SDL_Vertex vertices[4];
+    int indices[6];
+    render_queue_vertices(&quad, &render_texture, vertices, indices, 0);
+    draw_geometry(renderer, texture, vertices, 4, indices, 6);
+}
+
+void render_queue_free(void) {
+    free(render_quads);
+    free(render_textures);
+    free(render_vertices);
+    free(render_indices);
+    render_quads = NULL;
+    render_textures = NULL;
+    render_vertices = NULL;
+    render_indices = NULL;
+    render_quad_count = 0;
+    render_quad_capacity = 0;
+    render_texture_count = 0;
+    render_texture_capacity = 0;
+    render_vertex_capacity = 0;
+}
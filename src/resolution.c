@@ -0,0 +1,125 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "pacing.h"
+#include "resolution.h"
+
+// Logging
+#include <log.h>
+
+// Target pixels per world pixel of every level, from full resolution down
+static const float resolution_scales[RESOLUTION_LEVEL_COUNT] = {1.0f, 0.85f, 0.7f, 0.6f, 0.5f};
+
+static bool resolution_dynamic = true;
+static SDL_Texture * resolution_targets[RESOLUTION_LEVEL_COUNT]; // The first one belongs to the camera
+static int resolution_level;
+static float resolution_window_ms;
+static int resolution_window_frames;
+
+/**
+ * @brief Pick the resolution from the command line
+ *
+ * @param value dynamic or fixed, fixed always draws at full resolution
+ * @return true The value is valid
+ */
+bool resolution_parse(const char * value) {
+    if (strcmp(value, "dynamic") == 0) {
+        resolution_dynamic = true;
+    } else if (strcmp(value, "fixed") == 0) {
+        resolution_dynamic = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Create a target for every level smaller than the camera target
+ *
+ * @param app
+ * @param camera Its target is the full resolution level
+ */
+void resolution_init(App * app, Camera * camera) {
+    resolution_targets[0] = camera->target;
+    resolution_level = 0;
+    if (!resolution_dynamic) {
+        return;
+    }
+    for (int i = 1; i < RESOLUTION_LEVEL_COUNT; i++) {
+        int width = ceilf(camera->target_width * resolution_scales[i]);
+        int height = ceilf(camera->target_height * resolution_scales[i]);
+        resolution_targets[i] = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (resolution_targets[i] == NULL) {
+            log_error("Failed to create camera target of %dx%d: %s", width, height, SDL_GetError());
+            exit(1);
+        }
+        SDL_SetTextureBlendMode(resolution_targets[i], SDL_BLENDMODE_BLEND);
+    }
+}
+
+void resolution_quit(void) {
+    for (int i = 1; i < RESOLUTION_LEVEL_COUNT; i++) {
+        if (resolution_targets[i] != NULL) {
+            SDL_DestroyTexture(resolution_targets[i]);
+            resolution_targets[i] = NULL;
+        }
+    }
+    resolution_targets[0] = NULL;
+}
+
+/**
+ * @brief Draw the camera into the target of the current level
+ *
+ * @param view Camera the frame is drawn with
+ */
+void resolution_apply(Camera * view) {
+    view->target = resolution_targets[resolution_level];
+    view->scale = resolution_scales[resolution_level];
+}
+
+static void resolution_set_level(int level, float average, float budget) {
+    log_info("Resolution scale %.2f -> %.2f, frames took %.2f ms of a %.2f ms budget",
+             resolution_scales[resolution_level], resolution_scales[level], average, budget);
+    resolution_level = level;
+    // The new target holds nothing yet
+    draw_mark_dirty();
+}
+
+/**
+ * @brief Add the time of a frame that redrew the scene
+ *
+ * Idle frames only copy the old target to the screen, leave them out or the
+ * resolution goes up whenever the player stands still.
+ *
+ * @param ms Milliseconds the frame took, without waiting for the display
+ */
+void resolution_frame(float ms) {
+    if (!resolution_dynamic) {
+        return;
+    }
+    resolution_window_ms += ms;
+    if (++resolution_window_frames < RESOLUTION_WINDOW) {
+        return;
+    }
+    float average = resolution_window_ms / resolution_window_frames;
+    float budget = pacing_frame_ms();
+    resolution_window_ms = 0;
+    resolution_window_frames = 0;
+    if (average > budget && resolution_level + 1 < RESOLUTION_LEVEL_COUNT) {
+        resolution_set_level(resolution_level + 1, average, budget);
+    } else if (resolution_level > 0) {
+        float growth = resolution_scales[resolution_level - 1] / resolution_scales[resolution_level];
+        if (average * growth * growth < budget * RESOLUTION_HEADROOM) {
+            resolution_set_level(resolution_level - 1, average, budget);
+        }
+    }
+}
+
+/**
+ * @brief Target pixels per world pixel the frames are drawn at
+ */
+float resolution_scale(void) {
+    return resolution_scales[resolution_level];
+}
@@ -0,0 +1,190 @@
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "player.h"
+#include "simulation.h"
+#include "warp.h"
+
+// Logging
+#include <log.h>
+
+#define SIMULATION_FRESH 4 // Set in simulation_ready until the renderer takes the snapshot
+
+static SDL_Thread * simulation_thread;
+static SDL_mutex * simulation_mutex;
+static SDL_atomic_t simulation_running;
+static App simulation_app; // Input and clock of the simulation, apart from the ones the main thread uses
+static World * simulation_world;
+static Camera * simulation_camera;
+static uint64_t simulation_tick_count;
+
+// Triple buffer, every slot is owned by one side except the ready one that is handed over
+static SceneSnapshot simulation_slots[3];
+static int simulation_back = 0; // Written by the simulation
+static SDL_atomic_t simulation_ready = {1}; // Newest snapshot, with SIMULATION_FRESH until it is taken
+static int simulation_front = 2; // Read by the renderer
+
+static void simulation_publish(void) {
+    SceneSnapshot * scene = &simulation_slots[simulation_back];
+    scene->tick = simulation_tick_count;
+    scene->time = SDL_GetPerformanceCounter();
+    scene->ticks = simulation_app.ticks;
+    scene->map = world_get_map(simulation_world);
+    scene->origin = (SDL_Point){simulation_world->current->rect.x, simulation_world->current->rect.y};
+    scene->camera = *simulation_camera;
+    scene->player = *player_get();
+    scene->player_tile = player_tile_id(&scene->player);
+    simulation_back = SDL_AtomicSet(&simulation_ready, simulation_back | SIMULATION_FRESH) & 3;
+}
+
+// Advance the player and the camera by a tick, the lock is held
+static void simulation_tick(void) {
+    simulation_tick_count++;
+    uint64_t ticks = simulation_tick_count * 1000 / SIMULATION_RATE;
+    simulation_app.frame_ticks = ticks - simulation_app.ticks;
+    simulation_app.ticks = ticks;
+    player_save_state();
+    camera_save_state(simulation_camera);
+    Map * map = world_get_map(simulation_world);
+    if (!warp_pending()) {
+        player_handle(&simulation_app, map, simulation_camera);
+    }
+    camera_update(simulation_camera, player_get(), &map->bounds);
+    simulation_publish();
+}
+
+static int simulation_run(void * data) {
+    Uint64 period = SDL_GetPerformanceFrequency() / SIMULATION_RATE;
+    Uint64 next = SDL_GetPerformanceCounter();
+    while (SDL_AtomicGet(&simulation_running)) {
+        next += period;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now > next + period * SIMULATION_MAX_STEPS) {
+            // Too far behind to catch up, the game slows down instead
+            next = now;
+        } else if (next > now) {
+            SDL_Delay((next - now) * 1000 / SDL_GetPerformanceFrequency());
+        }
+        SDL_LockMutex(simulation_mutex);
+        simulation_tick();
+        SDL_UnlockMutex(simulation_mutex);
+    }
+    return 0;
+}
+
+/**
+ * @brief Publish the first snapshot and start ticking
+ *
+ * @param app Main thread App, the simulation keeps its own input and clock
+ * @param world Loaded world, the player is on its current map
+ * @param camera Simulated camera, the renderer draws with the snapshot copies
+ * @param threaded Tick on a thread at SIMULATION_RATE, otherwise only on simulation_step()
+ */
+void simulation_init(App * app, World * world, Camera * camera, bool threaded) {
+    simulation_world = world;
+    simulation_camera = camera;
+    memcpy(simulation_app.keyboard, app->keyboard, sizeof(simulation_app.keyboard));
+    simulation_mutex = SDL_CreateMutex();
+    if (simulation_mutex == NULL) {
+        log_error("Failed to create simulation lock: %s", SDL_GetError());
+        exit(1);
+    }
+    camera_update(camera, player_get(), &world_get_map(world)->bounds);
+    player_save_state();
+    camera_save_state(camera);
+    simulation_publish();
+    if (!threaded) {
+        return;
+    }
+    SDL_AtomicSet(&simulation_running, 1);
+    simulation_thread = SDL_CreateThread(simulation_run, "simulation", NULL);
+    if (simulation_thread == NULL) {
+        log_error("Failed to create simulation thread: %s", SDL_GetError());
+        exit(1);
+    }
+}
+
+/**
+ * @brief Stop the thread, the world can be freed afterwards
+ */
+void simulation_quit(void) {
+    if (simulation_thread != NULL) {
+        SDL_AtomicSet(&simulation_running, 0);
+        SDL_WaitThread(simulation_thread, NULL);
+        simulation_thread = NULL;
+    }
+    SDL_DestroyMutex(simulation_mutex);
+    simulation_mutex = NULL;
+}
+
+void simulation_lock(void) {
+    SDL_LockMutex(simulation_mutex);
+}
+
+void simulation_unlock(void) {
+    SDL_UnlockMutex(simulation_mutex);
+}
+
+/**
+ * @brief Hand the keys held on the main thread to the simulation, the lock is held
+ */
+void simulation_input(App * app) {
+    memcpy(simulation_app.keyboard, app->keyboard, sizeof(simulation_app.keyboard));
+}
+
+/**
+ * @brief Run a tick on the calling thread, the lock is held
+ */
+void simulation_step(void) {
+    simulation_tick();
+}
+
+/**
+ * @brief Take the newest snapshot
+ *
+ * The snapshot stays valid until the next call and can be read without the
+ * lock. The player can be handed to a neighboring map after the tick, the
+ * coordinates are moved onto the current map of the world then. Call on the
+ * main thread with the lock held, after the world changes of the frame.
+ *
+ * @param world
+ * @return const SceneSnapshot*
+ */
+const SceneSnapshot * simulation_latest(World * world) {
+    if (SDL_AtomicGet(&simulation_ready) & SIMULATION_FRESH) {
+        simulation_front = SDL_AtomicSet(&simulation_ready, simulation_front) & 3;
+    }
+    SceneSnapshot * scene = &simulation_slots[simulation_front];
+    int dx = scene->origin.x - world->current->rect.x;
+    int dy = scene->origin.y - world->current->rect.y;
+    scene->map = world_get_map(world);
+    if (dx != 0 || dy != 0) {
+        scene->camera.x += dx;
+        scene->camera.y += dy;
+        scene->camera.previous_x += dx;
+        scene->camera.previous_y += dy;
+        scene->player.x += dx;
+        scene->player.y += dy;
+        scene->player.previous_x += dx;
+        scene->player.previous_y += dy;
+        scene->origin = (SDL_Point){world->current->rect.x, world->current->rect.y};
+    }
+    return scene;
+}
+
+/**
+ * @brief Fraction of a tick since the snapshot, to draw between its previous and current state
+ *
+ * Without a thread the snapshot is always the tick that just ran.
+ *
+ * @param scene
+ * @return float 0 to 1
+ */
+float simulation_alpha(const SceneSnapshot * scene) {
+    if (simulation_thread == NULL) {
+        return 1.0f;
+    }
+    double elapsed = (double)(SDL_GetPerformanceCounter() - scene->time) * SIMULATION_RATE / SDL_GetPerformanceFrequency();
+    return SDL_clamp(elapsed, 0.0, 1.0);
+}
@@ -1,151 +1,327 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
-#include <cjson/cJSON.h>
 #include "tileset.h"
 #include "structs.h"
 #include "draw.h"
 #include "assets.h"
+#include "atlas.h"
+#include "json.h"
+#include "render_queue.h"
 
 // Logging
 #include <log.h>
 
 
-static void tileset_parse_properties(const cJSON *j_tile, Tile * tile) {
-    const cJSON * j_properties = cJSON_GetObjectItemCaseSensitive(j_tile, "properties");
-    tile->property_count = cJSON_GetArraySize(j_properties);
-    tile->properties = NULL;
-    if (cJSON_IsArray(j_properties)) {
-        tile->properties = calloc(tile->property_count, sizeof(Property));
-        const cJSON * j_property = NULL;
-        int property_index = 0;
-        cJSON_ArrayForEach(j_property, j_properties) {
-            Property * property = &tile->properties[property_index];
-            const cJSON * j_name = cJSON_GetObjectItemCaseSensitive(j_property, "name");
-            if (!cJSON_IsString(j_name)) {
-                log_error("Failed to parse tile property name");
-                exit(1);
+static void tileset_parse_properties(JsonReader * reader, Tile * tile) {
+    size_t capacity = 0;
+    tile->property_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Property * property = json_array_push(reader->arena, (void **)&tile->properties, &tile->property_count, &capacity, sizeof(Property));
+        bool has_name = false;
+        bool has_type = false;
+        const char * key;
+        json_object_begin(reader);
+        while (json_object_next(reader, &key)) {
+            if (strcmp(key, "name") == 0) {
+                has_name = json_read_atom(reader, &property->name);
+            } else if (strcmp(key, "type") == 0) {
+                Atom type;
+                has_type = json_read_atom(reader, &type);
+                property->type = property_type_from_atom(type);
+            } else if (strcmp(key, "propertytype") == 0) {
+                json_read_atom(reader, &property->propertytype);
+            } else if (strcmp(key, "value") == 0) {
+                // Without a type the value decides it
+                switch (json_peek(reader)) {
+                    case JSON_TYPE_STRING:
+                        json_read_string_copy(reader, &property->string_value);
+                        break;
+                    case JSON_TYPE_NUMBER:
+                        json_read_number(reader, &property->number_value);
+                        property->type = has_type ? property->type : PROPERTY_TYPE_FLOAT;
+                        break;
+                    case JSON_TYPE_BOOL:
+                        json_read_bool(reader, &property->bool_value);
+                        property->type = has_type ? property->type : PROPERTY_TYPE_BOOL;
+                        break;
+                    default:
+                        log_warn("Property type not supported");
+                        json_skip(reader);
+                        break;
+                }
+            } else {
+                json_skip(reader);
             }
-            property->name = calloc(strlen(j_name->valuestring) + 1, sizeof(char));
-            strcpy(property->name, j_name->valuestring);
+        }
+        if (!has_name && !reader->error) {
+            log_error("Failed to parse tile property name");
+            exit(1);
+        }
+    }
+    tile->property_mask = property_mask_build(tile->properties, tile->property_count);
+}
 
-            const cJSON * j_type = cJSON_GetObjectItemCaseSensitive(j_property, "type");
-            if (cJSON_IsString(j_type)) {
-                property->type = calloc(strlen(j_type->valuestring) + 1, sizeof(char));
-                strcpy(property->type, j_type->valuestring);
-            }
+static void tileset_parse_object(JsonReader * reader, Layer * object) {
+    bool has_x = false;
+    bool has_y = false;
+    bool has_width = false;
+    bool has_height = false;
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "x") == 0) {
+            has_x = json_read_int(reader, &object->x);
+        } else if (strcmp(key, "y") == 0) {
+            has_y = json_read_int(reader, &object->y);
+        } else if (strcmp(key, "width") == 0) {
+            has_width = json_read_int(reader, &object->width);
+        } else if (strcmp(key, "height") == 0) {
+            has_height = json_read_int(reader, &object->height);
+        } else if (strcmp(key, "type") == 0) {
+            json_read_atom(reader, &object->type);
+        } else if (strcmp(key, "name") == 0) {
+            json_read_atom(reader, &object->name);
+        } else if (strcmp(key, "visible") == 0) {
+            json_read_bool(reader, &object->visible);
+        } else {
+            json_skip(reader);
+        }
+    }
+    if (reader->error) {
+        return;
+    }
+    if (!has_x) {
+        log_error("Failed to parse object x");
+        exit(1);
+    }
+    if (!has_y) {
+        log_error("Failed to parse object y");
+        exit(1);
+    }
+    if (!has_width) {
+        log_error("Failed to parse object width");
+        exit(1);
+    }
+    if (!has_height) {
+        log_error("Failed to parse object height");
+        exit(1);
+    }
+}
 
-            const cJSON * j_propertytype = cJSON_GetObjectItemCaseSensitive(j_property, "propertytype");
-            if (cJSON_IsString(j_propertytype)) {
-                property->propertytype = calloc(strlen(j_propertytype->valuestring) + 1, sizeof(char));
-                strcpy(property->propertytype, j_propertytype->valuestring);
-            }
-            
-
-            const cJSON * j_value = cJSON_GetObjectItemCaseSensitive(j_property, "value");
-            if (cJSON_IsString(j_value)) {
-                property->string_value = calloc(strlen(j_value->valuestring) + 1, sizeof(char));
-                strcpy(property->string_value, j_value->valuestring);
-            } else if (cJSON_IsNumber(j_value)) {
-                property->number_value = cJSON_GetNumberValue(j_value);
-            } else if (cJSON_IsBool(j_value)) {
-                property->bool_value = j_value->valueint;
-            } else {
-                log_warn("Property type not supported");
-            } 
-            property_index++;
+static void tileset_parse_objectgroup(JsonReader * reader, Tile * tile) {
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "objects") != 0) {
+            json_skip(reader);
+            continue;
+        }
+        size_t capacity = 0;
+        tile->objectgroup_count = 0;
+        json_array_begin(reader);
+        while (json_array_next(reader)) {
+            Layer * object = json_array_push(reader->arena, (void **)&tile->objectgroup, &tile->objectgroup_count, &capacity, sizeof(Layer));
+            tileset_parse_object(reader, object);
         }
     }
 }
 
-static void tileset_parse_objectgroup(const cJSON *j_tile, Tile * tile) {
-    const cJSON * j_objectgroup = cJSON_GetObjectItemCaseSensitive(j_tile, "objectgroup");
-    if (cJSON_IsObject(j_objectgroup)) {
-        const cJSON * j_objects = cJSON_GetObjectItemCaseSensitive(j_objectgroup, "objects");
-        tile->objectgroup_count = cJSON_GetArraySize(j_objects);
-        tile->objectgroup = NULL;
-        if (cJSON_IsArray(j_objects)) {
-            const cJSON * j_object = NULL;
-            tile->objectgroup = calloc(tile->objectgroup_count, sizeof(Layer));
-            int object_index = 0;
-            cJSON_ArrayForEach(j_object, j_objects) {
-                Layer * object = &tile->objectgroup[object_index];
-                const cJSON * j_x = cJSON_GetObjectItemCaseSensitive(j_object, "x");
-                if (!cJSON_IsNumber(j_x)) {
-                    log_error("Failed to parse object x");
-                    exit(1);
-                }
-                object->x = j_x->valueint;
-                const cJSON * j_y = cJSON_GetObjectItemCaseSensitive(j_object, "y");
-                if (!cJSON_IsNumber(j_y)) {
-                    log_error("Failed to parse object y");
-                    exit(1);
-                }
-                object->y = j_y->valueint;
-                const cJSON * j_width = cJSON_GetObjectItemCaseSensitive(j_object, "width");
-                if (!cJSON_IsNumber(j_width)) {
-                    log_error("Failed to parse object width");
-                    exit(1);
-                }
-                object->width = j_width->valueint;
-                const cJSON * j_height = cJSON_GetObjectItemCaseSensitive(j_object, "height");
-                if (!cJSON_IsNumber(j_height)) {
-                    log_error("Failed to parse object height");
-                    exit(1);
-                }
-                object->height = j_height->valueint;
-                const cJSON * j_type = cJSON_GetObjectItemCaseSensitive(j_object, "type");
-                if (cJSON_IsString(j_type)) {
-                    object->type = calloc(strlen(j_type->valuestring) + 1, sizeof(char));
-                    strcpy(object->type, j_type->valuestring);
-                }
-                const cJSON * j_name = cJSON_GetObjectItemCaseSensitive(j_object, "name");
-                if (cJSON_IsString(j_name)) {
-                    object->name = calloc(strlen(j_name->valuestring) + 1, sizeof(char));
-                    strcpy(object->name, j_name->valuestring);
-                }
-                const cJSON * j_visible = cJSON_GetObjectItemCaseSensitive(j_object, "visible");
-                if (!cJSON_IsBool(j_visible)) {
-                    object->visible = j_visible->valueint;
-                }
+static void tileset_parse_animation(JsonReader * reader, Tile * tile) {
+    size_t capacity = 0;
+    tile->animation_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Frame * frame = json_array_push(reader->arena, (void **)&tile->animation, &tile->animation_count, &capacity, sizeof(Frame));
+        bool has_duration = false;
+        bool has_tileid = false;
+        const char * key;
+        json_object_begin(reader);
+        while (json_object_next(reader, &key)) {
+            if (strcmp(key, "duration") == 0) {
+                has_duration = json_read_int(reader, &frame->duration);
+            } else if (strcmp(key, "tileid") == 0) {
+                has_tileid = json_read_int(reader, &frame->tileid);
+            } else {
+                json_skip(reader);
             }
-            object_index++;
+        }
+        if (reader->error) {
+            return;
+        }
+        if (!has_duration) {
+            log_error("Failed to parse tile duration");
+            exit(1);
+        }
+        if (!has_tileid) {
+            log_error("Failed to parse tile tileid");
+            exit(1);
         }
     }
 }
 
-static void tileset_parse_animation(const cJSON *j_tile, Tile * tile) {
-    const cJSON * j_animation = cJSON_GetObjectItemCaseSensitive(j_tile, "animation");
-    tile->animation_count = cJSON_GetArraySize(j_animation);
-    tile->animation = NULL;
-    // Handle animation
-    if (cJSON_IsArray(j_animation)) {
-        // Allocate animation memory
-        tile->animation = calloc(tile->animation_count, sizeof(Frame));
-        if (tile->animation == NULL) {
-            log_error("Failed to allocate animation memory");
-            exit(1);
+static void tileset_parse_tile(JsonReader * reader, Tile * tile) {
+    bool has_id = false;
+    const char * key;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "id") == 0) {
+            has_id = json_read_int(reader, &tile->id);
+        } else if (strcmp(key, "image") == 0) {
+            json_read_string_copy(reader, &tile->image);
+        } else if (strcmp(key, "imageheight") == 0) {
+            json_read_int(reader, &tile->imageheight);
+        } else if (strcmp(key, "imagewidth") == 0) {
+            json_read_int(reader, &tile->imagewidth);
+        } else if (strcmp(key, "type") == 0) {
+            json_read_atom(reader, &tile->type);
+        } else if (strcmp(key, "properties") == 0) {
+            tileset_parse_properties(reader, tile);
+        } else if (strcmp(key, "objectgroup") == 0) {
+            tileset_parse_objectgroup(reader, tile);
+        } else if (strcmp(key, "animation") == 0) {
+            tileset_parse_animation(reader, tile);
+        } else {
+            json_skip(reader);
         }
+    }
+    if (!has_id && !reader->error) {
+        log_error("Failed to parse tile id");
+        exit(1);
+    }
+    log_debug("Loaded tile id: %d", tile->id);
+}
 
-        const cJSON *j_frame = NULL;
-        size_t animation_index = 0;
-        cJSON_ArrayForEach(j_frame, j_animation) {
-            Frame * frame = &tile->animation[animation_index];
-            const cJSON *j_duration = cJSON_GetObjectItemCaseSensitive(j_frame, "duration");
-            if (!cJSON_IsNumber(j_duration)) {
-                log_error("Failed to parse tile duration");
-                exit(1);
+static void tileset_parse_tiles(JsonReader * reader, Tileset * tileset) {
+    size_t capacity = 0;
+    size_t tile_count = 0;
+    json_array_begin(reader);
+    while (json_array_next(reader)) {
+        Tile * tile = json_array_push(reader->arena, (void **)&tileset->tiles, &tile_count, &capacity, sizeof(Tile));
+        tileset_parse_tile(reader, tile);
+    }
+    tileset->tile_count = tile_count;
+}
+
+// Tileset fields that have to be present in the json file
+enum {
+    TILESET_TILE_WIDTH = 1 << 0,
+    TILESET_TILE_HEIGHT = 1 << 1,
+    TILESET_IMAGE = 1 << 2,
+    TILESET_TILECOUNT = 1 << 3,
+    TILESET_COLUMNS = 1 << 4,
+    TILESET_IMAGE_HEIGHT = 1 << 5,
+    TILESET_IMAGE_WIDTH = 1 << 6,
+    TILESET_SPACING = 1 << 7,
+    TILESET_MARGIN = 1 << 8,
+    TILESET_NAME = 1 << 9,
+    TILESET_REQUIRED = (1 << 10) - 1,
+    // Image collections have an image per tile instead of one for the tileset
+    TILESET_COLLECTION_REQUIRED = TILESET_REQUIRED & ~(TILESET_IMAGE | TILESET_IMAGE_HEIGHT | TILESET_IMAGE_WIDTH)
+};
+
+static const char * tileset_field_names[] = {
+    "tile width", "tile height", "image", "tilecount", "columns", "imageheight", "imagewidth", "spacing", "margin", "name"
+};
+
+static int tileset_read_uint(JsonReader * reader, uint32_t * value) {
+    int number;
+    if (!json_read_int(reader, &number)) {
+        return 0;
+    }
+    *value = number;
+    return 1;
+}
+
+// Sum up the frame durations so the frame at any time is a binary search away
+static void tileset_build_animation(Tileset * tileset, Tile * tile, TileAnimation * animation) {
+    *animation = (TileAnimation){
+        .frames = tile->animation,
+        .frame_count = tile->animation_count,
+        .ends = arena_alloc(&tileset->arena, tile->animation_count * sizeof(uint32_t)),
+        .tileid = tile->animation[0].tileid,
+    };
+    for (uint32_t i = 0; i < animation->frame_count; i++) {
+        if (tile->animation[i].duration <= 0) {
+            log_warn("Tile %d of %s has a frame without duration, it is not animated", tile->id, tileset->name);
+            animation->duration = 0;
+            return;
+        }
+        animation->duration += tile->animation[i].duration;
+        animation->ends[i] = animation->duration;
+    }
+}
+
+// Give every tile of an image collection its own streamed image, file names are relative to the tileset file
+static void tileset_build_images(Tileset * tileset, const char * directory) {
+    for (uint32_t i = 0; i < tileset->tile_count; i++) {
+        Tile * tile = &tileset->tiles[i];
+        if (tile->id < 0 || (uint32_t)tile->id >= tileset->num_tiles || tile->image == NULL) {
+            continue;
+        }
+        TileImage * image = arena_alloc(&tileset->arena, sizeof(TileImage));
+        *image = (TileImage){.width = tile->imagewidth, .height = tile->imageheight};
+        size_t length = strlen(directory) + strlen(tile->image) + 1;
+        image->path = arena_alloc(&tileset->arena, length);
+        snprintf(image->path, length, "%s%s", directory, tile->image);
+        tileset->info[tile->id].src = (SDL_Rect){0, 0, tile->imagewidth, tile->imageheight};
+        tileset->info[tile->id].image = image;
+    }
+}
+
+// Check for a bool property that is true
+static bool tileset_bool_property(Tile * tile, Atom name) {
+    Property * property = property_find(tile->properties, tile->property_count, tile->property_mask, name);
+    return property != NULL && property->type == PROPERTY_TYPE_BOOL && property->bool_value;
+}
+
+// Fill the lookup table from the parsed tiles, so drawing and collisions never search
+static void tileset_build_info(Tileset * tileset) {
+    tileset->info = arena_alloc(&tileset->arena, tileset->num_tiles * sizeof(TileInfo));
+    uint32_t columns = SDL_max(tileset->columns, 1);
+    for (uint32_t i = 0; i < tileset->num_tiles; i++) {
+        uint32_t column = i % columns;
+        uint32_t row = i / columns;
+        tileset->info[i].src = (SDL_Rect){
+            tileset->image.x + column * (tileset->tile_width + tileset->spacing) + tileset->margin,
+            tileset->image.y + row * (tileset->tile_height + tileset->spacing) + tileset->margin,
+            tileset->tile_width,
+            tileset->tile_height,
+        };
+    }
+    uint32_t animation_capacity = 0;
+    for (uint32_t i = 0; i < tileset->tile_count; i++) {
+        Tile * tile = &tileset->tiles[i];
+        if (tile->id < 0 || (uint32_t)tile->id >= tileset->num_tiles) {
+            log_warn("Tile id %d is outside of tileset %s", tile->id, tileset->name);
+            continue;
+        }
+        TileInfo * info = &tileset->info[tile->id];
+        info->tile = tile;
+        info->flags |= tileset_bool_property(tile, ATOM_SOLID) ? TILE_INFO_SOLID : 0;
+        info->flags |= tileset_bool_property(tile, ATOM_WATER) ? TILE_INFO_WATER : 0;
+        info->flags |= tileset_bool_property(tile, ATOM_TRIGGER) ? TILE_INFO_TRIGGER : 0;
+        for (size_t j = 0; j < tile->objectgroup_count; j++) {
+            Layer * object = &tile->objectgroup[j];
+            if (object->type == ATOM_COLLISION_BOX) {
+                info->hitbox = (SDL_Rect){object->x, object->y, object->width, object->height};
+                info->flags |= TILE_INFO_HITBOX;
+                break;
             }
-            const cJSON *j_tileid = cJSON_GetObjectItemCaseSensitive(j_frame, "tileid");
-            if (!cJSON_IsNumber(j_tileid)) {
-                log_error("Failed to parse tile tileid");
-                exit(1);
+        }
+        if (tile->animation_count > 0) {
+            if (tileset->animation_count == animation_capacity) {
+                uint32_t capacity = animation_capacity ? animation_capacity * 2 : 8;
+                tileset->animations = arena_realloc(&tileset->arena, tileset->animations, animation_capacity * sizeof(TileAnimation), capacity * sizeof(TileAnimation));
+                animation_capacity = capacity;
             }
-            frame->duration = j_duration->valueint;
-            frame->tileid = j_tileid->valueint;
-            animation_index++;
+            info->animation = tileset->animation_count++;
+            info->flags |= TILE_INFO_ANIMATED;
+            tileset_build_animation(tileset, tile, &tileset->animations[info->animation]);
         }
     }
 }
+
 /*
 * Load a tileset from a json file and return a pointer to the loaded tileset
 * 
@@ -155,285 +331,395 @@ static void tileset_parse_animation(const cJSON *j_tile, Tile * tile) {
 */
 Tileset * tileset_load(App * app, const char * filename) {
     Tileset * tileset = calloc(1, sizeof(Tileset));
+    if (tileset == NULL) {
+        log_error("Failed to allocate tileset");
+        exit(1);
+    }
+    arena_init(&tileset->arena);
     // Read map file into buffer
-    FILE *fp = fopen(filename, "r");
-    if (fp == NULL) {
+    size_t fsize;
+    char *string = json_read_file(filename, &fsize);
+    if (string == NULL) {
         log_error("Failed to open map file");
         exit(1);
     }
-    fseek(fp, 0, SEEK_END);
-    long fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);  /* same as rewind(f); */
-
-    char *string = malloc(fsize + 1);
-    fread(string, fsize, 1, fp);
-    fclose(fp);
-
-    string[fsize] = 0;
 
-    // Load json map data
-    cJSON *tile_json = cJSON_Parse(string);
-
-    const cJSON *j_tile_width = cJSON_GetObjectItemCaseSensitive(tile_json, "tilewidth");
-    if (!cJSON_IsNumber(j_tile_width)) {
-        log_error("Failed to parse tile width");
-        exit(1);
-    }
-    const cJSON *j_tile_height = cJSON_GetObjectItemCaseSensitive(tile_json, "tileheight");
-    if (!cJSON_IsNumber(j_tile_height)) {
-        log_error("Failed to parse tile height");
-        exit(1);
-    }
-    const cJSON *j_image = cJSON_GetObjectItemCaseSensitive(tile_json, "image");
-    if (!cJSON_IsString(j_image)) {
-        log_error("Failed to parse image");
-        exit(1);
-    }
-    const cJSON *j_tilecount = cJSON_GetObjectItemCaseSensitive(tile_json, "tilecount");
-    if (!cJSON_IsNumber(j_tilecount)) {
-        log_error("Failed to parse tilecount");
-        exit(1);
+    // Stream json tileset data
+    int fields = 0;
+    char * image = NULL;
+    char * name = NULL;
+    JsonReader reader;
+    json_reader_init(&reader, string, fsize);
+    reader.arena = &tileset->arena;
+    const char * key;
+    json_object_begin(&reader);
+    while (json_object_next(&reader, &key)) {
+        if (strcmp(key, "tilewidth") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->tile_width) * TILESET_TILE_WIDTH;
+        } else if (strcmp(key, "tileheight") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->tile_height) * TILESET_TILE_HEIGHT;
+        } else if (strcmp(key, "image") == 0) {
+            fields |= json_read_string(&reader, &image) * TILESET_IMAGE;
+        } else if (strcmp(key, "tilecount") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->num_tiles) * TILESET_TILECOUNT;
+        } else if (strcmp(key, "columns") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->columns) * TILESET_COLUMNS;
+        } else if (strcmp(key, "imageheight") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->tile_image_height) * TILESET_IMAGE_HEIGHT;
+        } else if (strcmp(key, "imagewidth") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->tile_image_width) * TILESET_IMAGE_WIDTH;
+        } else if (strcmp(key, "spacing") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->spacing) * TILESET_SPACING;
+        } else if (strcmp(key, "margin") == 0) {
+            fields |= tileset_read_uint(&reader, &tileset->margin) * TILESET_MARGIN;
+        } else if (strcmp(key, "name") == 0) {
+            fields |= json_read_string(&reader, &name) * TILESET_NAME;
+        } else if (strcmp(key, "tiles") == 0) {
+            tileset_parse_tiles(&reader, tileset);
+        } else {
+            json_skip(&reader);
+        }
     }
-    const cJSON *j_columns = cJSON_GetObjectItemCaseSensitive(tile_json, "columns");
-    if (!cJSON_IsNumber(j_columns)) {
-        log_error("Failed to parse columns");
+    if (reader.error) {
+        log_error("Failed to parse tileset json %s", filename);
         exit(1);
     }
-    const cJSON *j_image_height = cJSON_GetObjectItemCaseSensitive(tile_json, "imageheight");
-    if (!cJSON_IsNumber(j_image_height)) {
-        log_error("Failed to parse imageheight");
-        exit(1);
+    bool collection = !(fields & TILESET_IMAGE) && tileset->columns == 0;
+    int required = collection ? TILESET_COLLECTION_REQUIRED : TILESET_REQUIRED;
+    for (int i = 0; i < 10; i++) {
+        if ((required & (1 << i)) && !(fields & (1 << i))) {
+            log_error("Failed to parse %s", tileset_field_names[i]);
+            exit(1);
+        }
     }
-    const cJSON *j_image_width = cJSON_GetObjectItemCaseSensitive(tile_json, "imagewidth");
-    if (!cJSON_IsNumber(j_image_width)) {
-        log_error("Failed to parse imagewidth");
-        exit(1);
+    snprintf(tileset->name, sizeof(tileset->name), "%s", name);
+    log_debug("Tileset columns: %d", tileset->columns);
+
+    log_info("Loaded tileset name: %s, tile width: %d, tile height: %d, tilecount: %d file: %s size: %zu bytes", tileset->name, tileset->tile_width, tileset->tile_height, tileset->num_tiles, filename, fsize);
+    if (collection) {
+        // Tile ids of image collections can have gaps where tiles were removed
+        for (uint32_t i = 0; i < tileset->tile_count; i++) {
+            tileset->num_tiles = SDL_max(tileset->num_tiles, (uint32_t)tileset->tiles[i].id + 1);
+        }
+        tileset_build_info(tileset);
+        char directory[MAX_FILENAME_LENGTH] = "";
+        const char * separator = strrchr(filename, '/');
+        if (separator != NULL) {
+            snprintf(directory, sizeof(directory), "%.*s", (int)(separator - filename + 1), filename);
+        }
+        tileset_build_images(tileset, directory);
+        log_info("Tileset %s is an image collection, its images are streamed", tileset->name);
+        free(string);
+        return tileset;
     }
-    const cJSON *j_spacing = cJSON_GetObjectItemCaseSensitive(tile_json, "spacing");
-    if (!cJSON_IsNumber(j_spacing)) {
-        log_error("Failed to parse spacing");
+    tileset->rows = tileset->num_tiles / tileset->columns;
+    // Load the tileset image into the atlas, tile rects point into the atlas page
+    log_info("Loading tileset texture: %s", image);
+    SDL_Surface * surface = IMG_Load(asset_path(image));
+    if (surface == NULL) {
+        log_error("Failed to load tileset image %s: %s", image, IMG_GetError());
         exit(1);
     }
-    const cJSON *j_margin = cJSON_GetObjectItemCaseSensitive(tile_json, "margin");
-    if (!cJSON_IsNumber(j_margin)) {
-        log_error("Failed to parse margin");
-        exit(1);
+    tileset->texture = atlas_add(app->renderer, surface, &tileset->image);
+    SDL_FreeSurface(surface);
+    tileset_build_info(tileset);
+
+    free(string);
+    return tileset;
+}
+
+/**
+ * @brief Check if the value of a property is stored in string_value
+ *
+ * The property value is a union, so the property type decides which member is valid.
+ */
+bool property_has_string(const Property * property) {
+    return property->type == PROPERTY_TYPE_STRING || property->type == PROPERTY_TYPE_COLOR || property->type == PROPERTY_TYPE_FILE;
+}
+
+static const Atom property_type_atoms[] = {
+    [PROPERTY_TYPE_STRING] = ATOM_STRING,
+    [PROPERTY_TYPE_INT] = ATOM_INT,
+    [PROPERTY_TYPE_FLOAT] = ATOM_FLOAT,
+    [PROPERTY_TYPE_BOOL] = ATOM_BOOL,
+    [PROPERTY_TYPE_COLOR] = ATOM_COLOR,
+    [PROPERTY_TYPE_FILE] = ATOM_FILE,
+    [PROPERTY_TYPE_OBJECT] = ATOM_OBJECT,
+    [PROPERTY_TYPE_CLASS] = ATOM_CLASS,
+};
+
+/**
+ * @brief Decode the type of a property from the file
+ *
+ * @param type Interned type name, unknown types are strings
+ */
+PropertyType property_type_from_atom(Atom type) {
+    for (size_t i = 0; i < SDL_arraysize(property_type_atoms); i++) {
+        if (property_type_atoms[i] == type) {
+            return i;
+        }
     }
-    const cJSON *j_name = cJSON_GetObjectItemCaseSensitive(tile_json, "name");
-    if (!cJSON_IsString(j_name)) {
-        log_error("Failed to parse name");
-        exit(1);
+    return PROPERTY_TYPE_STRING;
+}
+
+/**
+ * @brief Get the type name of a property as it is written to files
+ */
+Atom property_type_atom(PropertyType type) {
+    return property_type_atoms[type];
+}
+
+uint64_t property_mask_build(const Property * properties, size_t count) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        mask |= PROPERTY_BIT(properties[i].name);
     }
+    return mask;
+}
 
-    tileset->tile_width = j_tile_width->valueint;
-    tileset->tile_height = j_tile_height->valueint;
-    tileset->tile_image_width = j_image_width->valueint;
-    tileset->tile_image_height = j_image_height->valueint;
-    tileset->num_tiles = j_tilecount->valueint;
-    tileset->margin = j_margin->valueint;
-    tileset->spacing = j_spacing->valueint;
-    tileset->columns = j_columns->valueint;
-    strcpy(tileset->name, j_name->valuestring);
-    log_debug("Tileset columns: %d", tileset->columns);
-    // Allocate tile memory
-    const cJSON *j_tiles = cJSON_GetObjectItemCaseSensitive(tile_json, "tiles");
-    if (cJSON_IsArray(j_tiles)) {
-        tileset->tile_count = cJSON_GetArraySize(j_tiles);
-        tileset->tiles = calloc(tileset->tile_count, sizeof(Tile));
-        if (tileset->tiles == NULL) {
-            log_error("Failed to allocate tile memory");
-            exit(1);
+/**
+ * @brief Look up a property by name
+ *
+ * The mask of the owner rules out most names without looking at the properties.
+ *
+ * @param properties Properties of a tile or object
+ * @param count
+ * @param mask property_mask of the owner
+ * @param name
+ * @return Property* NULL when there is no such property
+ */
+Property * property_find(Property * properties, size_t count, uint64_t mask, Atom name) {
+    if (!(mask & PROPERTY_BIT(name))) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (properties[i].name == name) {
+            return &properties[i];
         }
-        const cJSON *j_tile = NULL;
-        int tile_index = 0;
-        cJSON_ArrayForEach(j_tile, j_tiles) {
-            Tile * tile = &tileset->tiles[tile_index];
-            const cJSON * j_id = cJSON_GetObjectItemCaseSensitive(j_tile, "id");
-            if (!cJSON_IsNumber(j_id)) {
-                log_error("Failed to parse tile id");
-                exit(1);
-            }
-            log_debug("Loading tile id: %d", j_id->valueint);
-            tile->id = j_id->valueint;
-            const cJSON * j_image = cJSON_GetObjectItemCaseSensitive(j_tile, "image");
-            if (cJSON_IsString(j_image)) {
-                tile->image = calloc(strlen(j_image->valuestring) + 1, sizeof(char));
-                strcpy(tile->image, j_image->valuestring);
-            }
+    }
+    return NULL;
+}
 
-            const cJSON * j_imageheight = cJSON_GetObjectItemCaseSensitive(j_tile, "imageheight");
-            if (cJSON_IsNumber(j_imageheight)) {
-                tile->imageheight = j_imageheight->valueint;
-            }
-            const cJSON * j_imagewidth = cJSON_GetObjectItemCaseSensitive(j_tile, "imagewidth");
-            if (cJSON_IsNumber(j_imagewidth)) {
-                tile->imagewidth = j_imagewidth->valueint;
-            }
-            const cJSON * j_type = cJSON_GetObjectItemCaseSensitive(j_tile, "type");
-            if (cJSON_IsString(j_type)) {
-                tile->type = calloc(strlen(j_type->valuestring) + 1, sizeof(char));
-                strcpy(tile->type, j_type->valuestring);
-            }
-            // Handle properties
-            tileset_parse_properties(j_tile, tile);
-            // Handle objectgroup
-            tileset_parse_objectgroup(j_tile, tile);
-            // Handle animation
-            tileset_parse_animation(j_tile, tile);
-            
-            tile_index++;
+static uint32_t tileset_animation_tileid(TileAnimation * animation, uint64_t ticks) {
+    if (animation->duration == 0) {
+        return animation->frames[0].tileid;
+    }
+    // First frame that ends after the time into the loop
+    uint32_t time = ticks % animation->duration;
+    uint32_t low = 0;
+    uint32_t high = animation->frame_count - 1;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (animation->ends[middle] <= time) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
-
-    log_info("Loaded tileset name: %s, tile width: %d, tile height: %d, tilecount: %d file: %s size: %d bytes", j_name->valuestring, j_tile_width->valueint, j_tile_height->valueint, j_tilecount->valueint, filename, fsize);
-    tileset->rows = tileset->num_tiles / tileset->columns;
-    // Load tileset texture
-    log_info("Loading tileset texture: %s", j_image->valuestring);
-    tileset->texture = IMG_LoadTexture(app->renderer, asset_path(j_image->valuestring));
-    SDL_assert(tileset->texture != NULL);
-    
-    cJSON_Delete(tile_json);
-    free(string);
-    return tileset;
+    return animation->frames[low].tileid;
 }
 
-static uint32_t tileset_get_current_animation_tileid(Tile * tile) {
-    // Get current frame from somewhere
-    // Store last tick somewhere
-    uint32_t duration = tile->animation[tile->current_animation_frame].duration;
-    if (duration == 0) {
-        log_error("Duration is 0");
-        return 0;
+/**
+ * @brief Advance every animation of a tileset to the same point in time, call once per frame
+ *
+ * @param tileset
+ * @param ticks Milliseconds on the animation clock
+ * @return true An animation moved on to another frame
+ */
+bool tileset_update_animations(Tileset * tileset, uint64_t ticks) {
+    bool changed = false;
+    for (uint32_t i = 0; i < tileset->animation_count; i++) {
+        TileAnimation * animation = &tileset->animations[i];
+        uint32_t tileid = tileset_animation_tileid(animation, ticks);
+        changed |= tileid != animation->tileid;
+        animation->tileid = tileid;
     }
-    int ticks = SDL_GetTicks();
-    
-    if (ticks - tile->last_tick > duration) {
-        // log_debug("Animating frame %d of %d id ", tile->current_animation_frame, tile->animation_count);
-        tile->current_animation_frame = (tile->current_animation_frame + 1) % tile->animation_count;
-        tile->last_tick = ticks;
+    return changed;
+}
+
+/**
+ * @brief Get the frame of an animated tile at a time of its own clock
+ *
+ * Entities that animate on their own use this instead of the shared tileset state.
+ *
+ * @param tileset
+ * @param tile_id Local id
+ * @param ticks Milliseconds on the clock of the entity
+ * @return uint32_t Local id of the frame, tile_id when it is not animated
+ */
+uint32_t tileset_animation_frame(Tileset * tileset, uint32_t tile_id, uint64_t ticks) {
+    TileInfo * info = tileset_get_info(tileset, tile_id, true);
+    if (info == NULL || !(info->flags & TILE_INFO_ANIMATED)) {
+        return tile_id;
     }
-    return tile->animation[tile->current_animation_frame].tileid;
+    return tileset_animation_tileid(&tileset->animations[info->animation], ticks);
 }
 
-Tile * tileset_get_tile_by_id(Tileset * tileset, int tile_id, bool local) {
+/**
+ * @brief Look up the precomputed data of a tile
+ *
+ * @param tileset
+ * @param tile_id Global id including flip flags, or local id
+ * @param local
+ * @return TileInfo* NULL for the empty tile and ids outside of the tileset
+ */
+TileInfo * tileset_get_info(Tileset * tileset, uint32_t tile_id, bool local) {
     uint32_t local_tile_id = tile_id;
     if (!local) {
         local_tile_id = (tile_id & TILE_ID_MASK) - 1;
     }
-    for (int i = 0; i < tileset->tile_count; i++) {
-        if (tileset->tiles[i].id == local_tile_id) {
-            return tileset->tiles + i;
-        }
+    if (local_tile_id >= tileset->num_tiles) {
+        return NULL;
     }
-    return NULL;
+    return &tileset->info[local_tile_id];
 }
 
-void tileset_render_tile(App * app, Tileset * tileset, int tile_id,bool local_tile_id, int x, int y, bool animated) {
+Tile * tileset_get_tile_by_id(Tileset * tileset, int tile_id, bool local) {
+    TileInfo * info = tileset_get_info(tileset, tile_id, local);
+    return info != NULL ? info->tile : NULL;
+}
+
+// Find the source rect and flip of a tile, NULL when there is nothing to draw
+static TileInfo * tileset_resolve_tile(Tileset * tileset, int tile_id, bool local_tile_id, bool animated, DrawFlip * flip) {
     if (tile_id == 0 && !local_tile_id) {
         // Skip rendering global empty tiles
-        return;
+        return NULL;
     }
-    uint32_t flags = 0;
-    uint32_t tileid = tile_id;
-    Tile * tile = NULL;
-    if (!local_tile_id) {
-        flags = tile_id & TILE_FLAG_MASK;
-        tileid = (tile_id & TILE_ID_MASK) - 1;
-    } 
-
-    tile = tileset_get_tile_by_id(tileset, tileid, true);
-    
-    
-    if (tile != NULL) {
-        // Check if tile is animated
-        if (tile->animation != NULL && animated) {
-            tileid = tileset_get_current_animation_tileid(tile);
-        }
+    TileInfo * info = tileset_get_info(tileset, tile_id, local_tile_id);
+    if (info == NULL) {
+        return NULL;
     }
-    // log_debug("Rendering tile %d pos: [%d %d] animated: %d", tileid, x, y, animated);
-    int columns = tileset->columns;
-    int tile_x = tileid % columns;
-    int tile_y = tileid / columns;
-    SDL_Rect src;
-    SDL_Rect dest;
-    int tile_width = tileset->tile_width;
-    int tile_height = tileset->tile_height;
-    
-    int margin = tileset->margin;
-    int spacing = tileset->spacing;
-    int tile_x_px = tile_x * (tile_width + spacing) + margin;
-    int tile_y_px = tile_y * (tile_height + spacing) + margin;
-    SDL_Texture *texture = tileset->texture;
-
-    // Setup atlasimage source and destination
-    src.x = tile_x_px;
-    src.y = tile_y_px;
-    src.w = tile_width;
-    src.h = tile_height;
-    dest.x = x;
-    dest.y = y;
-    dest.w = tile_width;
-    dest.h = tile_height;
-
-    SDL_RendererFlip flip = SDL_FLIP_NONE;
-    
+    uint32_t flags = local_tile_id ? 0 : tile_id & TILE_FLAG_MASK;
+    if ((info->flags & TILE_INFO_ANIMATED) && animated) {
+        TileInfo * frame = tileset_get_info(tileset, tileset->animations[info->animation].tileid, true);
+        info = frame != NULL ? frame : info;
+    }
+
+    *flip = DRAW_FLIP_NONE;
     // Read flip from tile flags
     if (flags & FLIPPED_HORIZONTALLY_FLAG) {
-        flip |= SDL_FLIP_HORIZONTAL;
+        *flip |= DRAW_FLIP_HORIZONTAL;
     }
     if (flags & FLIPPED_VERTICALLY_FLAG) {
-        flip |= SDL_FLIP_VERTICAL;
+        *flip |= DRAW_FLIP_VERTICAL;
     }
     if (flags & FLIPPED_DIAGONALLY_FLAG) {
-        flip |= SDL_FLIP_HORIZONTAL;
-        flip |= SDL_FLIP_VERTICAL;
+        *flip |= DRAW_FLIP_DIAGONAL;
+    }
+    return info;
+}
+
+// Texture and part of it to draw a tile with, streamed images draw a placeholder until they are loaded
+static SDL_Texture * tileset_tile_texture(Tileset * tileset, TileInfo * info, SDL_Rect * src) {
+    if (info->image != NULL) {
+        return image_cache_texture(info->image, src);
+    }
+    *src = info->src;
+    return tileset->texture;
+}
+
+// Where a tile goes, a diagonal flip swaps the width and height of tiles that are not square
+static SDL_Rect tileset_tile_dest(TileInfo * info, DrawFlip flip, int x, int y) {
+    if (flip & DRAW_FLIP_DIAGONAL) {
+        return (SDL_Rect){x, y, info->src.h, info->src.w};
+    }
+    return (SDL_Rect){x, y, info->src.w, info->src.h};
+}
+
+/**
+ * @brief Resolve a tile placed in a map cell and find the area it covers
+ *
+ * Tiles of image collections keep the size of their image and stand on the
+ * bottom left of the cell like in Tiled, so tall images reach into the rows
+ * above it. The placement is queued with tileset_queue_placement(), so the
+ * tile is only looked up once.
+ *
+ * @param tileset
+ * @param tile_id Global id including flip flags, or local id
+ * @param local_tile_id
+ * @param x Top left of the cell
+ * @param y
+ * @param cell_height Height of the map grid
+ * @param placement Receives the animation frame, flip and area of the tile
+ * @return true The tile exists
+ */
+bool tileset_place_tile(Tileset * tileset, int tile_id, bool local_tile_id, int x, int y, int cell_height, TilePlacement * placement) {
+    placement->info = tileset_resolve_tile(tileset, tile_id, local_tile_id, true, &placement->flip);
+    if (placement->info == NULL) {
+        return false;
+    }
+    placement->dest = tileset_tile_dest(placement->info, placement->flip, x, y);
+    if (placement->info->image != NULL) {
+        placement->dest.y += cell_height - placement->dest.h;
     }
-    // log_debug("Rendering tile %d pos src: [%d %d] dst: [%d %d] col: %d", tileid, tile_x_px, tile_y_px, x, y, columns);
+    return true;
+}
 
-    SDL_RenderCopyEx(app->renderer, texture, &src, &dest, 0, NULL, flip);
+// Push a resolved tile, sorted by its bottom within the layer
+static void tileset_push(Tileset * tileset, TileInfo * info, DrawFlip flip, const SDL_Rect * dest, uint16_t layer) {
+    SDL_Rect src;
+    SDL_Texture * texture = tileset_tile_texture(tileset, info, &src);
+    if (texture == NULL) {
+        return;
+    }
+    render_queue_push(texture, &src, dest, flip, layer, dest->y + dest->h);
+}
+
+/**
+ * @brief Push a placed tile onto the render queue
+ *
+ * Streamed images are only requested here, cull the placement before queueing it.
+ */
+void tileset_queue_placement(Tileset * tileset, const TilePlacement * placement, uint16_t layer) {
+    tileset_push(tileset, placement->info, placement->flip, &placement->dest, layer);
+}
+
+/**
+ * @brief Draw a tile right away, used when drawing into textures outside of the frame
+ */
+void tileset_render_tile(App * app, Tileset * tileset, int tile_id,bool local_tile_id, int x, int y, bool animated) {
+    DrawFlip flip;
+    TileInfo * info = tileset_resolve_tile(tileset, tile_id, local_tile_id, animated, &flip);
+    if (info == NULL) {
+        return;
+    }
+    SDL_Rect src;
+    SDL_Texture * texture = tileset_tile_texture(tileset, info, &src);
+    if (texture == NULL) {
+        return;
+    }
+    SDL_Rect dest = tileset_tile_dest(info, flip, x, y);
+    render_queue_draw(app->renderer, texture, &src, &dest, flip);
+}
+
+/**
+ * @brief Push a tile onto the render queue, sorted by the bottom of the tile within its layer
+ *
+ * @param tileset
+ * @param tile_id Global id including flip flags, or local id
+ * @param local_tile_id
+ * @param x Position on the render target
+ * @param y
+ * @param animated Draw the current animation frame instead of the tile itself
+ * @param layer Render queue layer
+ */
+void tileset_queue_tile(Tileset * tileset, int tile_id, bool local_tile_id, int x, int y, bool animated, uint16_t layer) {
+    DrawFlip flip;
+    TileInfo * info = tileset_resolve_tile(tileset, tile_id, local_tile_id, animated, &flip);
+    if (info == NULL) {
+        return;
+    }
+    SDL_Rect dest = tileset_tile_dest(info, flip, x, y);
+    tileset_push(tileset, info, flip, &dest, layer);
 }
 
 void tileset_free(Tileset * tiles) {
-    // Free tileset tiles
-    for (int i = 0; i < tiles->num_tiles; i++) {
-        free(tiles->tiles[i].image);
-        free(tiles->tiles[i].type);
-        // Free properties
-        for (int j = 0; j < tiles->tiles[i].property_count; j++) {
-            if (tiles->tiles[i].properties[j].name != NULL) {
-                free(tiles->tiles[i].properties[j].name);
-            }
-            if (tiles->tiles[i].properties[j].type != NULL) {
-                free(tiles->tiles[i].properties[j].type);
-            }
-            if (tiles->tiles[i].properties[j].propertytype != NULL) {
-                free(tiles->tiles[i].properties[j].propertytype);
-            }
-            if (tiles->tiles[i].properties[j].string_value != NULL) {
-                free(tiles->tiles[i].properties[j].string_value);
-            }
-        }
-        if (tiles->tiles[i].properties != NULL) {
-            free(tiles->tiles[i].properties);
-        }
-        // Free animation
-        if (tiles->tiles[i].animation != NULL) {
-            free(tiles->tiles[i].animation);
-        }
-        // Free objectgroup
-        if (tiles->tiles[i].objectgroup != NULL) {
-            for (int j = 0; j < tiles->tiles[i].objectgroup_count; j++) {
-                if (tiles->tiles[i].objectgroup[j].name != NULL) {
-                    free(tiles->tiles[i].objectgroup[j].name);
-                }
-                if (tiles->tiles[i].objectgroup[j].type != NULL) {
-                    free(tiles->tiles[i].objectgroup[j].type);
-                }
-            }
-            free(tiles->tiles[i].objectgroup);
+    for (uint32_t i = 0; i < tiles->num_tiles; i++) {
+        if (tiles->info[i].image != NULL) {
+            image_cache_forget(tiles->info[i].image);
         }
     }
-    SDL_DestroyTexture(tiles->texture);
-    free(tiles->tiles);
+    atlas_release(tiles->texture, &tiles->image);
+    arena_free(&tiles->arena);
     free(tiles);
-}
\ No newline at end of file
+}
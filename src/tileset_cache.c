@@ -0,0 +1,110 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tileset_cache.h"
+
+// Logging
+#include <log.h>
+
+typedef struct TilesetCacheEntry
+{
+    char filename[MAX_FILENAME_LENGTH];
+    Tileset *tileset;
+    int references;
+} TilesetCacheEntry;
+
+static App * tileset_cache_app;
+static TilesetCacheEntry * tileset_cache_entries;
+static size_t tileset_cache_count;
+static size_t tileset_cache_capacity;
+
+/**
+ * @brief Create the cache
+ *
+ * @param app Renderer the tileset textures are created with
+ */
+void tileset_cache_init(App * app) {
+    tileset_cache_app = app;
+}
+
+void tileset_cache_quit(void) {
+    for (size_t i = 0; i < tileset_cache_count; i++) {
+        log_warn("Tileset %s still has %d references", tileset_cache_entries[i].filename, tileset_cache_entries[i].references);
+        tileset_free(tileset_cache_entries[i].tileset);
+    }
+    free(tileset_cache_entries);
+    tileset_cache_entries = NULL;
+    tileset_cache_count = 0;
+    tileset_cache_capacity = 0;
+    tileset_cache_app = NULL;
+}
+
+/**
+ * @brief Get a reference to a tileset, loading it when no map uses it yet
+ *
+ * @param filename Path of the .tsj file
+ * @return Tileset* NULL when the cache was not initialized
+ */
+Tileset * tileset_cache_acquire(const char * filename) {
+    if (tileset_cache_app == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < tileset_cache_count; i++) {
+        if (strcmp(tileset_cache_entries[i].filename, filename) == 0) {
+            tileset_cache_entries[i].references++;
+            return tileset_cache_entries[i].tileset;
+        }
+    }
+    if (tileset_cache_count == tileset_cache_capacity) {
+        tileset_cache_capacity = tileset_cache_capacity ? tileset_cache_capacity * 2 : 8;
+        tileset_cache_entries = realloc(tileset_cache_entries, tileset_cache_capacity * sizeof(TilesetCacheEntry));
+        if (tileset_cache_entries == NULL) {
+            log_error("Failed to allocate tileset cache");
+            exit(1);
+        }
+    }
+    TilesetCacheEntry * entry = &tileset_cache_entries[tileset_cache_count++];
+    *entry = (TilesetCacheEntry){.references = 1};
+    snprintf(entry->filename, sizeof(entry->filename), "%s", filename);
+    entry->tileset = tileset_load(tileset_cache_app, filename);
+    return entry->tileset;
+}
+
+/**
+ * @brief Drop a reference, the last one frees the tileset
+ *
+ * @param tileset Tileset from tileset_cache_acquire(), NULL is ignored
+ */
+void tileset_cache_release(Tileset * tileset) {
+    if (tileset == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < tileset_cache_count; i++) {
+        TilesetCacheEntry * entry = &tileset_cache_entries[i];
+        if (entry->tileset != tileset) {
+            continue;
+        }
+        if (--entry->references == 0) {
+            log_debug("Freeing tileset %s", entry->filename);
+            tileset_free(entry->tileset);
+            *entry = tileset_cache_entries[--tileset_cache_count];
+        }
+        return;
+    }
+    log_warn("Released a tileset that is not cached");
+}
+
+/**
+ * @brief Advance the animations of every loaded tileset, call once per frame
+ *
+ * @param ticks Milliseconds on the animation clock
+ * @return true An animation moved on to another frame
+ */
+bool tileset_cache_update_animations(uint64_t ticks) {
+    bool changed = false;
+    for (size_t i = 0; i < tileset_cache_count; i++) {
+        changed |= tileset_update_animations(tileset_cache_entries[i].tileset, ticks);
+    }
+    return changed;
+}
@@ -0,0 +1,177 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "draw.h"
+#include "map_cache.h"
+#include "warp.h"
+
+// Logging
+#include <log.h>
+
+static char warp_filename[MAX_FILENAME_LENGTH]; // Destination of the pending warp
+static SDL_atomic_t warp_active; // A warp is pending, read by the renderer while the simulation starts warps
+static bool warp_cached; // The destination was requested from the map cache, on the main thread
+static Map warp_loaded; // Destination taken from the map cache with its tilesets attached
+static bool warp_ready; // warp_loaded holds the destination
+static int warp_x;
+static int warp_y;
+static Uint64 warp_requested;
+static float warp_fade; // 0 transparent to 1 black
+static Uint32 warp_fade_tick;
+static bool warp_fade_out; // The warp was pending on the last frame drawn
+
+/**
+ * @brief Start a warp, ignored while another warp is pending
+ *
+ * Only records the destination, the simulation thread starts warps and the
+ * map cache belongs to the main thread. warp_finish() requests the map.
+ *
+ * @param filename Path of the destination map
+ * @param x Player position on the destination map
+ * @param y
+ */
+void warp_start(const char * filename, int x, int y) {
+    if (warp_pending()) {
+        return;
+    }
+    log_debug("Warping to map: %s x: %d y: %d", filename, x, y);
+    snprintf(warp_filename, sizeof(warp_filename), "%s", filename);
+    warp_cached = false;
+    warp_x = x;
+    warp_y = y;
+    warp_requested = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&warp_active, 1);
+}
+
+bool warp_pending(void) {
+    return SDL_AtomicGet(&warp_active) != 0;
+}
+
+/**
+ * @brief Check whether the fade is visible, the scene is redrawn every frame until it is gone
+ */
+bool warp_fading(void) {
+    return warp_pending() || warp_fade > 0.0f;
+}
+
+/**
+ * @brief Get the path of the destination map of the pending warp
+ */
+const char * warp_destination(void) {
+    return warp_filename;
+}
+
+/**
+ * @brief End the pending warp on a destination map that is already in use
+ *
+ * The caller switches to the map it holds, the map cache has no copy to hand out.
+ *
+ * @param player Moved to the warp destination
+ */
+void warp_arrive(struct Entity * player) {
+    if (warp_cached) {
+        map_cache_cancel(warp_filename);
+    }
+    SDL_AtomicSet(&warp_active, 0);
+    player->x = warp_x;
+    player->y = warp_y;
+    draw_mark_dirty();
+    log_info("Warped to %s: already loaded", warp_filename);
+}
+
+/**
+ * @brief Request the destination of a pending warp and take it once it is loaded
+ *
+ * Attaching the tilesets of the destination can load tileset images, call it
+ * on the main thread before taking the simulation lock so warp_finish() only
+ * swaps the map.
+ */
+void warp_prepare(void) {
+    if (!warp_pending() || warp_ready) {
+        return;
+    }
+    if (!warp_cached) {
+        map_cache_request(warp_filename);
+        warp_cached = true;
+    }
+    if (map_cache_take(warp_filename, &warp_loaded)) {
+        // Attach before the current map goes back so tilesets both maps use stay loaded
+        map_attach_tilesets(&warp_loaded);
+        warp_ready = true;
+    }
+}
+
+/**
+ * @brief Swap in the destination map once it is loaded
+ *
+ * Call at a frame boundary, the old map goes back into the map cache.
+ *
+ * @param map Current map, replaced by the destination map
+ * @param player Moved to the warp destination
+ * @return true The map was swapped
+ */
+bool warp_finish(Map * map, struct Entity * player) {
+    if (!warp_pending()) {
+        return false;
+    }
+    // Warps within the map only move the player
+    if (strcmp(map->filename, warp_filename) == 0) {
+        warp_arrive(player);
+        return true;
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    warp_prepare();
+    if (!warp_ready) {
+        return false;
+    }
+    SDL_AtomicSet(&warp_active, 0);
+    map_cache_put(map);
+    *map = warp_loaded;
+    warp_loaded = (Map){0};
+    warp_ready = false;
+    player->x = warp_x;
+    player->y = warp_y;
+    draw_mark_dirty();
+    Uint64 end = SDL_GetPerformanceCounter();
+    double frequency = SDL_GetPerformanceFrequency();
+    log_info("Warped to %s: loaded in %.2f ms, frame stall %.3f ms", map->filename,
+             (start - warp_requested) * 1000.0 / frequency, (end - start) * 1000.0 / frequency);
+    return true;
+}
+
+/**
+ * @brief Fade to black while a warp is loading and back in after the swap
+ *
+ * @param app
+ */
+void warp_draw(App * app) {
+    Uint32 tick = SDL_GetTicks();
+    bool pending = warp_pending();
+    if (pending && !warp_fade_out) {
+        // The fade only advances on frames that are drawn, a warp started since the last one fades from now
+        warp_fade_tick = tick;
+    }
+    warp_fade_out = pending;
+    float step = (float)(tick - warp_fade_tick) / WARP_FADE_MS;
+    warp_fade_tick = tick;
+    warp_fade = SDL_clamp(warp_fade + (pending ? step : -step), 0.0f, 1.0f);
+    if (warp_fade <= 0.0f) {
+        return;
+    }
+    SDL_Rect rect = {0, 0, app->camera->target_width, app->camera->target_height};
+    SDL_SetRenderDrawBlendMode(app->renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, warp_fade * 255);
+    SDL_RenderFillRect(app->renderer, &rect);
+}
+
+void warp_cancel(void) {
+    if (warp_pending()) {
+        if (warp_ready) {
+            map_cache_put(&warp_loaded);
+            warp_ready = false;
+        } else if (warp_cached) {
+            map_cache_cancel(warp_filename);
+        }
+        SDL_AtomicSet(&warp_active, 0);
+    }
+}
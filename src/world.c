@@ -0,0 +1,369 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "json.h"
+#include "map_cache.h"
+#include "warp.h"
+#include "world.h"
+
+// Logging
+#include <log.h>
+
+static void world_parse_map(JsonReader * reader, WorldMap * world_map, const char * directory) {
+    const char * key;
+    char * filename = NULL;
+    json_object_begin(reader);
+    while (json_object_next(reader, &key)) {
+        if (strcmp(key, "fileName") == 0) {
+            json_read_string(reader, &filename);
+        } else if (strcmp(key, "x") == 0) {
+            json_read_int(reader, &world_map->rect.x);
+        } else if (strcmp(key, "y") == 0) {
+            json_read_int(reader, &world_map->rect.y);
+        } else if (strcmp(key, "width") == 0) {
+            json_read_int(reader, &world_map->rect.w);
+        } else if (strcmp(key, "height") == 0) {
+            json_read_int(reader, &world_map->rect.h);
+        } else {
+            json_skip(reader);
+        }
+    }
+    if (filename == NULL || world_map->rect.w <= 0 || world_map->rect.h <= 0) {
+        log_error("Failed to parse world map");
+        exit(1);
+    }
+    // Map file names are relative to the world file
+    snprintf(world_map->path, sizeof(world_map->path), "%s%s", directory, filename);
+}
+
+static void world_unload(World * world, WorldMap * world_map) {
+    if (world_map->state == WORLD_MAP_LOADING) {
+        map_cache_cancel(world_map->path);
+    } else if (world_map->state == WORLD_MAP_LOADED) {
+        log_debug("Unloading %s", world_map->path);
+        map_cache_put(&world_map->map);
+        world->memory_used -= world_map->memory_size;
+    }
+    world_map->state = WORLD_MAP_UNLOADED;
+}
+
+static WorldMap * world_find(World * world, const char * path) {
+    for (size_t i = 0; i < world->map_count; i++) {
+        if (strcmp(world->maps[i].path, path) == 0) {
+            return &world->maps[i];
+        }
+    }
+    return NULL;
+}
+
+// A warp loaded another map into the current slot
+static bool world_attached(World * world) {
+    return strcmp(world->current->map.filename, world->current->path) == 0;
+}
+
+static SDL_Rect world_grow_rect(SDL_Rect rect, int distance) {
+    return (SDL_Rect){rect.x - distance, rect.y - distance, rect.w + distance * 2, rect.h + distance * 2};
+}
+
+static long world_distance(SDL_Rect * a, SDL_Rect * b) {
+    long dx = (a->x + a->w / 2) - (b->x + b->w / 2);
+    long dy = (a->y + a->h / 2) - (b->y + b->h / 2);
+    return dx * dx + dy * dy;
+}
+
+/**
+ * @brief Load a world file and its start map
+ *
+ * @param world
+ * @param filename .world file
+ * @param start_map Path of the map the player starts on, as it is referenced from the world file
+ * @return 0 on success
+ */
+int world_load(World * world, const char * filename, const char * start_map) {
+    *world = (World){
+        .load_distance = WORLD_LOAD_DISTANCE,
+        .memory_budget = WORLD_MEMORY_BUDGET,
+    };
+    size_t size;
+    char * string = json_read_file(filename, &size);
+    if (string == NULL) {
+        log_error("Failed to open world file");
+        exit(1);
+    }
+    char directory[MAX_FILENAME_LENGTH] = "";
+    const char * separator = strrchr(filename, '/');
+    if (separator != NULL) {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(separator - filename + 1), filename);
+    }
+
+    JsonReader reader;
+    json_reader_init(&reader, string, size);
+    size_t capacity = 0;
+    const char * key;
+    json_object_begin(&reader);
+    while (json_object_next(&reader, &key)) {
+        if (strcmp(key, "maps") == 0) {
+            json_array_begin(&reader);
+            while (json_array_next(&reader)) {
+                WorldMap * world_map = json_array_push(NULL, (void **)&world->maps, &world->map_count, &capacity, sizeof(WorldMap));
+                world_parse_map(&reader, world_map, directory);
+            }
+        } else if (strcmp(key, "patterns") == 0) {
+            log_warn("World patterns are not supported");
+            json_skip(&reader);
+        } else {
+            json_skip(&reader);
+        }
+    }
+    if (reader.error) {
+        log_error("Failed to parse world json");
+        exit(1);
+    }
+    free(string);
+
+    world->current = world_find(world, start_map);
+    if (world->current == NULL) {
+        log_error("Start map %s is not part of world %s", start_map, filename);
+        exit(1);
+    }
+    map_cache_load(world->current->path, &world->current->map);
+    map_attach_tilesets(&world->current->map);
+    world->current->state = WORLD_MAP_LOADED;
+    world->current->memory_size = map_memory_size(&world->current->map);
+    world->memory_used = world->current->memory_size;
+    log_info("Loaded world %s with %zu maps", filename, world->map_count);
+    return 0;
+}
+
+/**
+ * @brief Get the map the player is on
+ */
+Map * world_get_map(World * world) {
+    return &world->current->map;
+}
+
+/**
+ * @brief Finish a pending warp, switching over when the world holds the destination map
+ *
+ * Maps the world holds are in use and never loaded a second time, warps to
+ * any other map go through warp_finish().
+ *
+ * @param world
+ * @param player Moved to the warp destination
+ * @return true The player is on the destination map
+ */
+bool world_warp(World * world, struct Entity * player) {
+    WorldMap * target = warp_pending() ? world_find(world, warp_destination()) : NULL;
+    if (target == NULL || target->state != WORLD_MAP_LOADED || strcmp(target->map.filename, target->path) != 0) {
+        return warp_finish(&world->current->map, player);
+    }
+    WorldMap * current = world->current;
+    if (!world_attached(world)) {
+        // The player was on a map from outside of the world, it goes back to the cache
+        map_cache_put(&current->map);
+        world->memory_used -= current->memory_size;
+        current->state = WORLD_MAP_UNLOADED;
+    }
+    world->current = target;
+    warp_arrive(player);
+    return true;
+}
+
+/**
+ * @brief Move the player between maps and keep the bounds of the current map up to date
+ *
+ * Changes what the simulation works on, call with the simulation lock held
+ * after the player moved.
+ *
+ * @param world
+ * @param camera
+ * @param player Player in current map coordinates
+ */
+void world_enter(World * world, Camera * camera, struct Entity * player) {
+    WorldMap * current = world->current;
+    if (!world_attached(world)) {
+        // Warped, move the map into its world slot or stop streaming when it is not part of the world
+        WorldMap * target = world_find(world, current->map.filename);
+        if (target == NULL) {
+            return;
+        }
+        world_unload(world, target);
+        world->memory_used -= current->memory_size;
+        target->map = current->map;
+        target->state = WORLD_MAP_LOADED;
+        target->memory_size = map_memory_size(&target->map);
+        world->memory_used += target->memory_size;
+        current->map = (Map){0};
+        current->state = WORLD_MAP_UNLOADED;
+        world->current = current = target;
+    }
+
+    // Hand the player over when it walks into a neighboring map
+    SDL_Point center = {current->rect.x + player->x + player->width / 2, current->rect.y + player->y + player->height / 2};
+    if (!SDL_PointInRect(&center, &current->rect)) {
+        WorldMap * target = NULL;
+        for (size_t i = 0; i < world->map_count; i++) {
+            if (world->maps[i].state == WORLD_MAP_LOADED && SDL_PointInRect(&center, &world->maps[i].rect)) {
+                target = &world->maps[i];
+                break;
+            }
+        }
+        if (target != NULL) {
+            int dx = current->rect.x - target->rect.x;
+            int dy = current->rect.y - target->rect.y;
+            player->x += dx;
+            player->y += dy;
+            player->previous_x += dx;
+            player->previous_y += dy;
+            camera->x += dx;
+            camera->y += dy;
+            camera->previous_x += dx;
+            camera->previous_y += dy;
+            world->current = current = target;
+            log_debug("Entered %s", current->path);
+        } else {
+            // Nothing loaded there, keep the player on the current map
+            player->x = SDL_clamp(player->x, 0, current->rect.w - player->width);
+            player->y = SDL_clamp(player->y, 0, current->rect.h - player->height);
+        }
+    }
+
+    // The player and camera can move onto every loaded map
+    SDL_Rect bounds = current->rect;
+    for (size_t i = 0; i < world->map_count; i++) {
+        if (world->maps[i].state == WORLD_MAP_LOADED) {
+            SDL_UnionRect(&bounds, &world->maps[i].rect, &bounds);
+        }
+    }
+    bounds.x -= current->rect.x;
+    bounds.y -= current->rect.y;
+    current->map.bounds = bounds;
+}
+
+/**
+ * @brief Stream neighboring maps in and out around the camera
+ *
+ * Only touches the maps the player is not on, call without the simulation
+ * lock. world_enter() picks up the changes on the next frame.
+ *
+ * @param world
+ * @param camera Camera in current map coordinates
+ */
+void world_stream(World * world, const Camera * camera) {
+    WorldMap * current = world->current;
+    if (!world_attached(world)) {
+        return;
+    }
+    // Adopt maps the loader thread finished
+    for (size_t i = 0; i < world->map_count; i++) {
+        WorldMap * world_map = &world->maps[i];
+        if (world_map->state != WORLD_MAP_LOADING || !map_cache_take(world_map->path, &world_map->map)) {
+            continue;
+        }
+        map_attach_tilesets(&world_map->map);
+        world_map->state = WORLD_MAP_LOADED;
+        world_map->memory_size = map_memory_size(&world_map->map);
+        world->memory_used += world_map->memory_size;
+        draw_mark_dirty();
+        log_info("Streamed in %s (%zu bytes)", world_map->path, world_map->memory_size);
+    }
+
+    // Load maps near the camera, unload the ones far away
+    SDL_Rect view = {current->rect.x + (int)camera->x, current->rect.y + (int)camera->y, camera->width, camera->height};
+    SDL_Rect near = world_grow_rect(view, world->load_distance);
+    SDL_Rect far = world_grow_rect(view, world->load_distance * 2);
+    for (size_t i = 0; i < world->map_count; i++) {
+        WorldMap * world_map = &world->maps[i];
+        if (world_map == current) {
+            continue;
+        }
+        if (SDL_HasIntersection(&world_map->rect, &near)) {
+            if (world_map->state == WORLD_MAP_UNLOADED && world->memory_used + world_map->memory_size <= world->memory_budget) {
+                map_cache_request(world_map->path);
+                world_map->state = WORLD_MAP_LOADING;
+            }
+        } else if (!SDL_HasIntersection(&world_map->rect, &far)) {
+            world_unload(world, world_map);
+        }
+    }
+
+    // Stay within the memory budget, the farthest maps that are not in view go first
+    while (world->memory_used > world->memory_budget) {
+        WorldMap * farthest = NULL;
+        for (size_t i = 0; i < world->map_count; i++) {
+            WorldMap * world_map = &world->maps[i];
+            if (world_map == current || world_map->state != WORLD_MAP_LOADED || SDL_HasIntersection(&world_map->rect, &view)) {
+                continue;
+            }
+            if (farthest == NULL || world_distance(&world_map->rect, &view) > world_distance(&farthest->rect, &view)) {
+                farthest = world_map;
+            }
+        }
+        if (farthest == NULL) {
+            break;
+        }
+        world_unload(world, farthest);
+    }
+}
+
+/**
+ * @brief Stream maps in and out around the camera and move the player between maps
+ *
+ * Call once per frame after the player moved, on a single thread.
+ *
+ * @param world
+ * @param camera
+ * @param player Player in current map coordinates
+ */
+void world_update(World * world, Camera * camera, struct Entity * player) {
+    world_stream(world, camera);
+    world_enter(world, camera, player);
+}
+
+/**
+ * @brief Draw all loaded maps in view at their world position
+ *
+ * @param app
+ * @param world
+ * @param map Map the camera coordinates are local to, the one of the snapshot that is drawn
+ */
+void world_draw(App * app, World * world, Map * map) {
+    WorldMap * current = NULL;
+    for (size_t i = 0; i < world->map_count && current == NULL; i++) {
+        if (&world->maps[i].map == map && strcmp(map->filename, world->maps[i].path) == 0) {
+            current = &world->maps[i];
+        }
+    }
+    // Maps from outside of the world are drawn on their own
+    if (current == NULL) {
+        map_draw(app, map);
+        return;
+    }
+    Camera * camera = app->camera;
+    SDL_Rect view = {current->rect.x + (int)camera->x, current->rect.y + (int)camera->y, camera->width, camera->height};
+    for (size_t i = 0; i < world->map_count; i++) {
+        WorldMap * world_map = &world->maps[i];
+        if (world_map->state != WORLD_MAP_LOADED || !SDL_HasIntersection(&world_map->rect, &view)) {
+            continue;
+        }
+        // Draw with the camera moved into the coordinates of the map
+        Camera local = *camera;
+        local.x += current->rect.x - world_map->rect.x;
+        local.y += current->rect.y - world_map->rect.y;
+        app->camera = &local;
+        map_draw(app, &world_map->map);
+        app->camera = camera;
+    }
+}
+
+void world_free(World * world) {
+    for (size_t i = 0; i < world->map_count; i++) {
+        world_unload(world, &world->maps[i]);
+    }
+    free(world->maps);
+    world->maps = NULL;
+    world->map_count = 0;
+    world->current = NULL;
+}
@@ -0,0 +1,427 @@
+#include <SDL2/SDL.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "atom.h"
+#include "map.h"
+#include "zmap.h"
+
+// Logging
+#include <log.h>
+
+typedef struct ZmapBuffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} ZmapBuffer;
+
+static size_t zmap_align(size_t size) {
+    return (size + ZMAP_ALIGNMENT - 1) & ~((size_t)ZMAP_ALIGNMENT - 1);
+}
+
+static void zmap_buffer_append(ZmapBuffer * buffer, const void * data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+        buffer->data = realloc(buffer->data, capacity);
+        if (buffer->data == NULL) {
+            log_error("Failed to allocate zmap buffer");
+            exit(1);
+        }
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static uint32_t zmap_buffer_add_string(ZmapBuffer * strings, const char * string) {
+    if (string == NULL) {
+        return ZMAP_NO_STRING;
+    }
+    uint32_t offset = strings->size;
+    zmap_buffer_append(strings, string, strlen(string) + 1);
+    return offset;
+}
+
+static char * zmap_string(const ZmapSection * section, const uint8_t * base, uint32_t offset) {
+    if (offset == ZMAP_NO_STRING || offset >= section->size) {
+        return NULL;
+    }
+    return (char *)(base + section->offset + offset);
+}
+
+static const ZmapSection * zmap_find_section(const ZmapSection * sections, int section_count, ZmapSectionType type, size_t entry_size, size_t file_size) {
+    for (int i = 0; i < section_count; i++) {
+        const ZmapSection * section = &sections[i];
+        if (section->type != type) {
+            continue;
+        }
+        if (section->offset > file_size || section->size > file_size - section->offset) {
+            log_error("Compiled map section %d out of range", type);
+            return NULL;
+        }
+        if (entry_size != 0 && (uint64_t)section->count * entry_size > section->size) {
+            log_error("Compiled map section %d is truncated", type);
+            return NULL;
+        }
+        return section;
+    }
+    log_error("Compiled map is missing section %d", type);
+    return NULL;
+}
+
+/**
+ * @brief Find the compiled version of a map file
+ *
+ * A .zmap filename is returned as is. For any other map the .zmap file next to
+ * it is returned, but only when it exists and is at least as new as the source.
+ *
+ * @return true A compiled map was found and written to compiled
+ */
+bool zmap_find_compiled(const char * filename, char * compiled, size_t size) {
+    const char * extension = strrchr(filename, '.');
+    if (extension != NULL && strcmp(extension, ZMAP_EXTENSION) == 0) {
+        snprintf(compiled, size, "%s", filename);
+        return true;
+    }
+    size_t base_length = extension != NULL ? (size_t)(extension - filename) : strlen(filename);
+    if (base_length + strlen(ZMAP_EXTENSION) + 1 > size) {
+        return false;
+    }
+    snprintf(compiled, size, "%.*s%s", (int)base_length, filename, ZMAP_EXTENSION);
+
+    struct stat source_stat;
+    struct stat compiled_stat;
+    if (stat(compiled, &compiled_stat) != 0) {
+        return false;
+    }
+    if (stat(filename, &source_stat) == 0 && compiled_stat.st_mtime < source_stat.st_mtime) {
+        log_warn("Compiled map %s is older than %s, ignoring it", compiled, filename);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Load a compiled map by mapping it into memory
+ *
+ * Layer data and property strings point straight into the mapping, names and
+ * types are interned and only the layer, object and property tables are
+ * allocated in the map arena. The mapping is private so tile edits at runtime
+ * never reach the file.
+ *
+ * @return 0 on success, -1 when the file is not a valid compiled map
+ */
+int zmap_load(Map * map, const char * filename) {
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    log_error("Compiled maps are little-endian and can not be loaded on this host: %s", filename);
+    return -1;
+#endif
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        log_error("Failed to open compiled map %s", filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ZmapHeader)) {
+        log_error("Compiled map %s is too small", filename);
+        close(fd);
+        return -1;
+    }
+    size_t file_size = st.st_size;
+    uint8_t * base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        log_error("Failed to map compiled map %s", filename);
+        return -1;
+    }
+
+    const ZmapHeader * header = (const ZmapHeader *)base;
+    if (header->magic != ZMAP_MAGIC || header->version != ZMAP_VERSION) {
+        log_error("Compiled map %s has an unsupported format", filename);
+        munmap(base, file_size);
+        return -1;
+    }
+    if (sizeof(ZmapHeader) + (uint64_t)header->section_count * sizeof(ZmapSection) > file_size) {
+        log_error("Compiled map %s has a truncated section table", filename);
+        munmap(base, file_size);
+        return -1;
+    }
+    const ZmapSection * sections = (const ZmapSection *)(base + sizeof(ZmapHeader));
+    const ZmapSection * s_layers = zmap_find_section(sections, header->section_count, ZMAP_SECTION_LAYERS, sizeof(ZmapLayer), file_size);
+    const ZmapSection * s_objects = zmap_find_section(sections, header->section_count, ZMAP_SECTION_OBJECTS, sizeof(ZmapObject), file_size);
+    const ZmapSection * s_properties = zmap_find_section(sections, header->section_count, ZMAP_SECTION_PROPERTIES, sizeof(ZmapProperty), file_size);
+    const ZmapSection * s_strings = zmap_find_section(sections, header->section_count, ZMAP_SECTION_STRINGS, 0, file_size);
+    const ZmapSection * s_gids = zmap_find_section(sections, header->section_count, ZMAP_SECTION_GIDS, sizeof(uint32_t), file_size);
+    const ZmapSection * s_tilesets = zmap_find_section(sections, header->section_count, ZMAP_SECTION_TILESETS, sizeof(ZmapTileset), file_size);
+    if (s_layers == NULL || s_objects == NULL || s_properties == NULL || s_strings == NULL || s_gids == NULL || s_tilesets == NULL) {
+        munmap(base, file_size);
+        return -1;
+    }
+    // Every string offset is safe to use once the string table is terminated
+    if (s_strings->size > 0 && base[s_strings->offset + s_strings->size - 1] != 0) {
+        log_error("Compiled map %s has an unterminated string table", filename);
+        munmap(base, file_size);
+        return -1;
+    }
+    if (s_layers->count != header->layer_count) {
+        log_error("Compiled map %s has an invalid layer count", filename);
+        munmap(base, file_size);
+        return -1;
+    }
+
+    const ZmapLayer * z_layers = (const ZmapLayer *)(base + s_layers->offset);
+    const ZmapObject * z_objects = (const ZmapObject *)(base + s_objects->offset);
+    const ZmapProperty * z_properties = (const ZmapProperty *)(base + s_properties->offset);
+    uint32_t * gids = (uint32_t *)(base + s_gids->offset);
+    const ZmapTileset * z_tilesets = (const ZmapTileset *)(base + s_tilesets->offset);
+
+    map->mapping = base;
+    map->mapping_size = file_size;
+    map->width = header->width;
+    map->height = header->height;
+    map->tilewidth = header->tilewidth;
+    map->tileheight = header->tileheight;
+    map->infinite = (header->flags & ZMAP_FLAG_INFINITE) != 0;
+    map->layer_count = header->layer_count;
+    map->render_cache = NULL;
+    map->gid_tilesets = NULL;
+    map->gid_count = 0;
+    map->collision = NULL;
+    map->tile_overhang = (SDL_Point){0, 0};
+    arena_init(&map->arena);
+    map->tileset_count = s_tilesets->count;
+    map->tilesets = arena_alloc(&map->arena, map->tileset_count * sizeof(MapTileset));
+    for (uint32_t i = 0; i < map->tileset_count; i++) {
+        map->tilesets[i].first_gid = z_tilesets[i].first_gid;
+        map->tilesets[i].source = zmap_string(s_strings, base, z_tilesets[i].source);
+    }
+    map->layers = arena_alloc(&map->arena, map->layer_count * sizeof(Layer));
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        const ZmapLayer * z_layer = &z_layers[i];
+        Layer * layer = &map->layers[i];
+        layer->id = z_layer->id;
+        layer->type = atom_intern(zmap_string(s_strings, base, z_layer->type));
+        layer->name = atom_intern(zmap_string(s_strings, base, z_layer->name));
+        layer->width = z_layer->width;
+        layer->height = z_layer->height;
+        uint64_t tile_count = (uint64_t)z_layer->width * z_layer->height;
+        if (tile_count > 0) {
+            if (z_layer->gid_offset > s_gids->count || tile_count > s_gids->count - z_layer->gid_offset) {
+                log_error("Compiled map %s layer %d data out of range", filename, i);
+                map_free(map);
+                return -1;
+            }
+            layer->data = gids + z_layer->gid_offset;
+        }
+        if (z_layer->object_first > s_objects->count || z_layer->object_count > s_objects->count - z_layer->object_first) {
+            log_error("Compiled map %s layer %d objects out of range", filename, i);
+            map_free(map);
+            return -1;
+        }
+        layer->object_count = z_layer->object_count;
+        if (layer->object_count == 0) {
+            continue;
+        }
+        layer->objects = arena_alloc(&map->arena, layer->object_count * sizeof(Object));
+        for (size_t j = 0; j < layer->object_count; j++) {
+            const ZmapObject * z_object = &z_objects[z_layer->object_first + j];
+            Object * object = &layer->objects[j];
+            object->x = z_object->x;
+            object->y = z_object->y;
+            object->width = z_object->width;
+            object->height = z_object->height;
+            object->id = z_object->id;
+            object->gid = z_object->gid;
+            object->name = atom_intern(zmap_string(s_strings, base, z_object->name));
+            object->type = atom_intern(zmap_string(s_strings, base, z_object->type));
+            if (z_object->property_first > s_properties->count || z_object->property_count > s_properties->count - z_object->property_first) {
+                log_error("Compiled map %s object %d properties out of range", filename, z_object->id);
+                map_free(map);
+                return -1;
+            }
+            object->property_count = z_object->property_count;
+            if (object->property_count == 0) {
+                continue;
+            }
+            object->properties = arena_alloc(&map->arena, object->property_count * sizeof(Property));
+            for (size_t k = 0; k < object->property_count; k++) {
+                const ZmapProperty * z_property = &z_properties[z_object->property_first + k];
+                Property * property = &object->properties[k];
+                property->name = atom_intern(zmap_string(s_strings, base, z_property->name));
+                property->type = property_type_from_atom(atom_intern(zmap_string(s_strings, base, z_property->type)));
+                property->propertytype = atom_intern(zmap_string(s_strings, base, z_property->propertytype));
+                switch (z_property->kind) {
+                    case ZMAP_PROPERTY_STRING:
+                        property->string_value = zmap_string(s_strings, base, z_property->string_value);
+                        break;
+                    case ZMAP_PROPERTY_NUMBER:
+                        property->number_value = z_property->number_value;
+                        break;
+                    case ZMAP_PROPERTY_BOOL:
+                        property->bool_value = z_property->number_value != 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            object->property_mask = property_mask_build(object->properties, object->property_count);
+        }
+    }
+    map_build_occupancy(map);
+    // Tile data is read right away when the map is drawn
+    uint64_t page_start = s_gids->offset & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise(base + page_start, s_gids->offset + s_gids->size - page_start, MADV_WILLNEED);
+    log_info("Loaded compiled map %s size: %zu bytes", filename, file_size);
+    return 0;
+}
+
+void zmap_unload(Map * map) {
+    if (map->mapping != NULL) {
+        munmap(map->mapping, map->mapping_size);
+    }
+    map->mapping = NULL;
+    map->mapping_size = 0;
+}
+
+/**
+ * @brief Write a loaded map as a compiled .zmap file
+ *
+ * @return 0 on success, -1 when the file could not be written
+ */
+int zmap_write(Map * map, const char * filename) {
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    log_error("Compiled maps can only be written on little-endian hosts");
+    return -1;
+#endif
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        if (map->layers[i].array_count > 0) {
+            log_error("Chunked layers of infinite maps can not be compiled");
+            return -1;
+        }
+    }
+    ZmapBuffer layers = {0};
+    ZmapBuffer objects = {0};
+    ZmapBuffer properties = {0};
+    ZmapBuffer strings = {0};
+    ZmapBuffer gids = {0};
+    ZmapBuffer tilesets = {0};
+
+    for (uint32_t i = 0; i < map->tileset_count; i++) {
+        ZmapTileset z_tileset = {
+            .first_gid = map->tilesets[i].first_gid,
+            .source = zmap_buffer_add_string(&strings, map->tilesets[i].source),
+        };
+        zmap_buffer_append(&tilesets, &z_tileset, sizeof(z_tileset));
+    }
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        Layer * layer = &map->layers[i];
+        ZmapLayer z_layer = {
+            .id = layer->id,
+            .type = zmap_buffer_add_string(&strings, atom_name(layer->type)),
+            .name = zmap_buffer_add_string(&strings, atom_name(layer->name)),
+            .object_first = objects.size / sizeof(ZmapObject),
+            .object_count = layer->object_count,
+        };
+        if (layer->data != NULL) {
+            z_layer.width = layer->width;
+            z_layer.height = layer->height;
+            z_layer.gid_offset = gids.size / sizeof(uint32_t);
+            zmap_buffer_append(&gids, layer->data, (size_t)layer->width * layer->height * sizeof(uint32_t));
+        }
+        for (size_t j = 0; j < layer->object_count; j++) {
+            Object * object = &layer->objects[j];
+            ZmapObject z_object = {
+                .x = object->x,
+                .y = object->y,
+                .width = object->width,
+                .height = object->height,
+                .id = object->id,
+                .gid = object->gid,
+                .name = zmap_buffer_add_string(&strings, atom_name(object->name)),
+                .type = zmap_buffer_add_string(&strings, atom_name(object->type)),
+                .property_first = properties.size / sizeof(ZmapProperty),
+                .property_count = object->property_count,
+            };
+            for (size_t k = 0; k < object->property_count; k++) {
+                Property * property = &object->properties[k];
+                ZmapProperty z_property = {
+                    .name = zmap_buffer_add_string(&strings, atom_name(property->name)),
+                    .type = zmap_buffer_add_string(&strings, atom_name(property_type_atom(property->type))),
+                    .propertytype = zmap_buffer_add_string(&strings, atom_name(property->propertytype)),
+                    .string_value = ZMAP_NO_STRING,
+                    .kind = ZMAP_PROPERTY_NONE,
+                };
+                if (property->type == PROPERTY_TYPE_BOOL) {
+                    z_property.kind = ZMAP_PROPERTY_BOOL;
+                    z_property.number_value = property->bool_value;
+                } else if (property->type == PROPERTY_TYPE_INT || property->type == PROPERTY_TYPE_FLOAT || property->type == PROPERTY_TYPE_OBJECT) {
+                    z_property.kind = ZMAP_PROPERTY_NUMBER;
+                    z_property.number_value = property->number_value;
+                } else if (property_has_string(property) && property->string_value != NULL) {
+                    z_property.kind = ZMAP_PROPERTY_STRING;
+                    z_property.string_value = zmap_buffer_add_string(&strings, property->string_value);
+                }
+                zmap_buffer_append(&properties, &z_property, sizeof(z_property));
+            }
+            zmap_buffer_append(&objects, &z_object, sizeof(z_object));
+        }
+        zmap_buffer_append(&layers, &z_layer, sizeof(z_layer));
+    }
+
+    ZmapHeader header = {
+        .magic = ZMAP_MAGIC,
+        .version = ZMAP_VERSION,
+        .section_count = ZMAP_SECTION_COUNT,
+        .flags = map->infinite ? ZMAP_FLAG_INFINITE : 0,
+        .width = map->width,
+        .height = map->height,
+        .tilewidth = map->tilewidth,
+        .tileheight = map->tileheight,
+        .layer_count = map->layer_count,
+    };
+    ZmapBuffer * buffers[ZMAP_SECTION_COUNT] = {&layers, &objects, &properties, &strings, &gids, &tilesets};
+    size_t entry_sizes[ZMAP_SECTION_COUNT] = {sizeof(ZmapLayer), sizeof(ZmapObject), sizeof(ZmapProperty), 1, sizeof(uint32_t), sizeof(ZmapTileset)};
+    ZmapSection sections[ZMAP_SECTION_COUNT];
+    size_t offset = zmap_align(sizeof(header) + sizeof(sections));
+    for (int i = 0; i < ZMAP_SECTION_COUNT; i++) {
+        sections[i].type = ZMAP_SECTION_LAYERS + i;
+        sections[i].count = buffers[i]->size / entry_sizes[i];
+        sections[i].offset = offset;
+        sections[i].size = buffers[i]->size;
+        offset = zmap_align(offset + buffers[i]->size);
+    }
+
+    int rc = 0;
+    FILE * fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        log_error("Failed to open %s for writing", filename);
+        rc = -1;
+    } else {
+        static const uint8_t padding[ZMAP_ALIGNMENT] = {0};
+        bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = ok && fwrite(sections, sizeof(sections), 1, fp) == 1;
+        size_t position = sizeof(header) + sizeof(sections);
+        for (int i = 0; i < ZMAP_SECTION_COUNT && ok; i++) {
+            size_t padding_size = sections[i].offset - position;
+            ok = padding_size == 0 || fwrite(padding, padding_size, 1, fp) == 1;
+            ok = ok && (buffers[i]->size == 0 || fwrite(buffers[i]->data, buffers[i]->size, 1, fp) == 1);
+            position = sections[i].offset + buffers[i]->size;
+        }
+        if (fclose(fp) != 0 || !ok) {
+            log_error("Failed to write compiled map %s", filename);
+            rc = -1;
+        }
+    }
+    for (int i = 0; i < ZMAP_SECTION_COUNT; i++) {
+        free(buffers[i]->data);
+    }
+    return rc;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+int main() {
+    Arena arena;
+    int rc = 0;
+    arena_init(&arena);
+
+    // Allocations are zeroed and aligned
+    char * first = arena_alloc(&arena, 3);
+    double * second = arena_alloc(&arena, sizeof(double));
+    if (first[0] != 0 || (size_t)second % sizeof(double) != 0 || (char *)second == first) {
+        printf("Allocations are not zeroed or aligned\n");
+        rc = 1;
+    }
+
+    // The last allocation grows and shrinks in place
+    int * values = arena_alloc(&arena, 4 * sizeof(int));
+    values[3] = 42;
+    int * grown = arena_realloc(&arena, values, 4 * sizeof(int), 64 * sizeof(int));
+    if (grown != values || grown[3] != 42 || grown[63] != 0) {
+        printf("Last allocation was not grown in place\n");
+        rc = 1;
+    }
+    int * shrunk = arena_realloc(&arena, grown, 64 * sizeof(int), 8 * sizeof(int));
+    int * next = arena_alloc(&arena, sizeof(int));
+    if (shrunk != grown || next != shrunk + 8) {
+        printf("Last allocation was not shrunk in place\n");
+        rc = 1;
+    }
+
+    // Other allocations are copied
+    int * moved = arena_realloc(&arena, shrunk, 8 * sizeof(int), 16 * sizeof(int));
+    if (moved == shrunk || moved[3] != 42) {
+        printf("Allocation was not moved\n");
+        rc = 1;
+    }
+
+    // Large allocations get their own block and leave the current one in use
+    size_t size = arena.size;
+    char * large = arena_alloc(&arena, ARENA_BLOCK_SIZE * 2);
+    char * small = arena_alloc(&arena, 1);
+    if (large == NULL || arena.size < size + ARENA_BLOCK_SIZE * 2 || small < first || small > first + ARENA_BLOCK_SIZE) {
+        printf("Large allocation did not get a block of its own\n");
+        rc = 1;
+    }
+
+    char * copy = arena_strdup(&arena, "warp");
+    if (strcmp(copy, "warp") != 0) {
+        printf("String was not copied\n");
+        rc = 1;
+    }
+
+    arena_free(&arena);
+    if (arena.blocks != NULL || arena.size != 0) {
+        printf("Arena was not freed\n");
+        rc = 1;
+    }
+    return rc;
+}
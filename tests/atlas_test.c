@@ -0,0 +1,109 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "atlas.h"
+
+static bool atlas_test_overlap(SDL_Rect * rects, int count) {
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (SDL_HasIntersection(&rects[i], &rects[j])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int main() {
+    int rc = 0;
+
+    // Packed rectangles stay on the page and never overlap
+    AtlasPage page = {.width = 256, .height = 256};
+    SDL_Rect rects[64];
+    int count = 0;
+    int sizes[][2] = {{100, 40}, {60, 90}, {30, 30}, {128, 16}, {16, 128}, {50, 50}, {200, 10}, {20, 20}};
+    while (count < 64 && atlas_page_pack(&page, sizes[count % 8][0], sizes[count % 8][1], &rects[count])) {
+        SDL_Rect bounds = {0, 0, page.width, page.height};
+        SDL_Rect inside;
+        if (!SDL_IntersectRect(&rects[count], &bounds, &inside) || !SDL_RectEquals(&inside, &rects[count])) {
+            printf("Rectangle %d is outside of the page\n", count);
+            rc = 1;
+        }
+        count++;
+    }
+    if (count < 8 || count == 64 || page.images != count || atlas_test_overlap(rects, count)) {
+        printf("Rectangles were not packed\n");
+        rc = 1;
+    }
+
+    // Released space is reused on a full page, neighbors merge into room for a larger rectangle
+    SDL_Rect reused;
+    atlas_page_free(&page, &rects[2]);
+    if (!atlas_page_pack(&page, rects[2].w, rects[2].h, &reused) || !SDL_RectEquals(&reused, &rects[2]) || page.images != count) {
+        printf("Released space was not reused\n");
+        rc = 1;
+    }
+    AtlasPage strip = {.width = 64, .height = 16};
+    SDL_Rect halves[2];
+    atlas_page_pack(&strip, 32, 16, &halves[0]);
+    atlas_page_pack(&strip, 32, 16, &halves[1]);
+    atlas_page_free(&strip, &halves[0]);
+    atlas_page_free(&strip, &halves[1]);
+    if (!atlas_page_pack(&strip, 64, 16, &reused) || strip.images != 1) {
+        printf("Released neighbors were not merged\n");
+        rc = 1;
+    }
+    free(strip.skyline);
+    free(strip.free_rects);
+    free(page.skyline);
+    free(page.free_rects);
+
+    // Images of tilesets share a page texture
+    SDL_Surface * target = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer * renderer = SDL_CreateSoftwareRenderer(target);
+    SDL_Surface * tiles = SDL_CreateRGBSurfaceWithFormat(0, 96, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Surface * sprites = SDL_CreateRGBSurfaceWithFormat(0, 32, 128, 32, SDL_PIXELFORMAT_RGBA32);
+    if (renderer == NULL || tiles == NULL || sprites == NULL) {
+        printf("Failed to create renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_Rect tiles_rect;
+    SDL_Rect sprites_rect;
+    SDL_Texture * tiles_texture = atlas_add(renderer, tiles, &tiles_rect);
+    SDL_Texture * sprites_texture = atlas_add(renderer, sprites, &sprites_rect);
+    if (tiles_texture != sprites_texture || tiles_rect.w != 96 || sprites_rect.h != 128) {
+        printf("Images were not packed into one page\n");
+        rc = 1;
+    }
+    // Padding keeps images apart
+    SDL_Rect grown = {tiles_rect.x - ATLAS_PADDING, tiles_rect.y - ATLAS_PADDING, tiles_rect.w + ATLAS_PADDING * 2, tiles_rect.h + ATLAS_PADDING * 2};
+    if (SDL_HasIntersection(&grown, &sprites_rect) || tiles_rect.x < ATLAS_PADDING || tiles_rect.y < ATLAS_PADDING) {
+        printf("Images are not padded\n");
+        rc = 1;
+    }
+
+    // An image added again takes the space it was released from
+    SDL_Rect released = tiles_rect;
+    atlas_release(tiles_texture, &tiles_rect);
+    tiles_texture = atlas_add(renderer, tiles, &tiles_rect);
+    if (tiles_texture != sprites_texture || !SDL_RectEquals(&tiles_rect, &released)) {
+        printf("Space of a released image was not reused\n");
+        rc = 1;
+    }
+
+    // Releasing every image frees the page, the next image starts a new one
+    atlas_release(tiles_texture, &tiles_rect);
+    atlas_release(sprites_texture, &sprites_rect);
+    sprites_texture = atlas_add(renderer, sprites, &sprites_rect);
+    if (sprites_rect.x != ATLAS_PADDING || sprites_rect.y != ATLAS_PADDING) {
+        printf("Page was not freed\n");
+        rc = 1;
+    }
+    atlas_release(sprites_texture, &sprites_rect);
+    atlas_quit();
+
+    SDL_FreeSurface(sprites);
+    SDL_FreeSurface(tiles);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(target);
+    return rc;
+}
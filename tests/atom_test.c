@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atom.h"
+#include "map.h"
+
+int main() {
+    int rc = 0;
+
+    // Builtin atoms are fixed, other strings get an atom on first use
+    Atom solid = atom_intern("solid");
+    Atom door = atom_intern("door");
+    char copy[] = "door";
+    if (solid != ATOM_SOLID || door < ATOM_BUILTIN_COUNT || atom_intern(copy) != door || atom_intern(NULL) != ATOM_NONE) {
+        printf("Strings were not interned\n");
+        rc = 1;
+    }
+    if (strcmp(atom_name(door), "door") != 0 || strcmp(atom_name(ATOM_WARP), "warp") != 0 || atom_name(ATOM_NONE) != NULL) {
+        printf("Atom names do not match\n");
+        rc = 1;
+    }
+
+    // Properties are found through the mask of their owner
+    Map map;
+    map_load(&map, "../assets/home.tmj");
+    int warps = 0;
+    for (uint32_t i = 0; i < map.layer_count; i++) {
+        Layer * layer = &map.layers[i];
+        for (size_t j = 0; j < layer->object_count; j++) {
+            Object * object = &layer->objects[j];
+            Property * warp = property_find(object->properties, object->property_count, object->property_mask, ATOM_WARP);
+            if (warp != NULL && warp->type == PROPERTY_TYPE_STRING && warp->string_value != NULL) {
+                warps++;
+            }
+            if (property_find(object->properties, object->property_count, object->property_mask, door) != NULL) {
+                printf("Found a property that does not exist\n");
+                rc = 1;
+            }
+        }
+        if (layer->type != ATOM_TILELAYER && layer->type != ATOM_OBJECTGROUP) {
+            printf("Layer type %s was not interned\n", atom_name(layer->type));
+            rc = 1;
+        }
+    }
+    if (warps == 0) {
+        printf("No warp properties found\n");
+        rc = 1;
+    }
+    map_free(&map);
+
+    atom_quit();
+    return rc;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chunk.h"
+#include "map.h"
+#include "map_writer.h"
+
+// Logging
+#include <log.h>
+
+#define CHUNK_TEST_FILE "chunk_test.tmj"
+#define CHUNK_SIZE 16
+
+static void write_chunk(FILE * file, const uint32_t * gids, int x, int y, const char * compression) {
+    fprintf(file, "{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"data\":", x, y, CHUNK_SIZE, CHUNK_SIZE);
+    map_writer_data(file, gids, CHUNK_SIZE * CHUNK_SIZE, compression);
+    fputc('}', file);
+}
+
+// Split a tile layer into chunks, layers cycle through csv, zlib and base64 data
+static void write_chunked_layer(FILE * file, Layer * layer, void * data) {
+    const char * compressions[] = {NULL, "zlib", ""};
+    int * layer_count = data;
+    const char * compression = compressions[(*layer_count)++ % 3];
+    fprintf(file, ",\"chunks\":[");
+    uint32_t gids[CHUNK_SIZE * CHUNK_SIZE];
+    // One chunk left and above of the origin
+    for (int j = 0; j < CHUNK_SIZE * CHUNK_SIZE; j++) {
+        gids[j] = 5;
+    }
+    write_chunk(file, gids, -CHUNK_SIZE, -CHUNK_SIZE, compression);
+    for (int y = 0; y < layer->height; y += CHUNK_SIZE) {
+        for (int x = 0; x < layer->width; x += CHUNK_SIZE) {
+            for (int j = 0; j < CHUNK_SIZE * CHUNK_SIZE; j++) {
+                int col = x + j % CHUNK_SIZE;
+                int row = y + j / CHUNK_SIZE;
+                gids[j] = col < layer->width && row < layer->height ? layer->data[col + row * layer->width] : 0;
+            }
+            fputc(',', file);
+            write_chunk(file, gids, x, y, compression);
+        }
+    }
+    fputc(']', file);
+    map_writer_encoding(file, compression);
+}
+
+static int count_resident(Map * map) {
+    int count = 0;
+    for (uint32_t i = 0; i < map->layer_count; i++) {
+        for (uint32_t j = 0; j < map->layers[i].array_count; j++) {
+            count += map->layers[i].array[j].data != NULL;
+        }
+    }
+    return count;
+}
+
+int main() {
+    Map source = {0};
+    Map chunked = {0};
+    if (map_load_tmj(&source, "../assets/home.tmj") != 0) {
+        printf("Failed to load the map\n");
+        return 1;
+    }
+    int layer_count = 0;
+    map_writer_write(CHUNK_TEST_FILE, &source, true, write_chunked_layer, &layer_count);
+    if (map_load_tmj(&chunked, CHUNK_TEST_FILE) != 0) {
+        printf("Failed to load the chunked map\n");
+        return 1;
+    }
+    remove(CHUNK_TEST_FILE);
+
+    int rc = 0;
+    if (count_resident(&chunked) != 0) {
+        printf("Chunks are decoded before the camera reaches them\n");
+        rc = 1;
+    }
+
+    // Every tile matches the dense layers
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < source.layer_count && rc == 0; i++) {
+        Layer * layer = &source.layers[i];
+        if (layer->data == NULL) {
+            continue;
+        }
+        Layer * chunked_layer = &chunked.layers[j];
+        for (int row = 0; row < layer->height; row++) {
+            for (int col = 0; col < layer->width; col++) {
+                if (map_get_tile_id_at_row_col(&chunked, j, col, row) != layer->data[col + row * layer->width]) {
+                    printf("Layer %d tile %d,%d does not match\n", i, col, row);
+                    rc = 1;
+                    break;
+                }
+            }
+        }
+        if (chunk_get_tile_id(chunked_layer, -1, -1) != 5) {
+            printf("Layer %d chunk left of the origin does not match\n", i);
+            rc = 1;
+        }
+        j++;
+    }
+
+    // Only the chunks around the camera stay resident, streaming logs every layer it touches
+    log_set_quiet(false);
+    log_set_level(LOG_TRACE);
+    Camera camera = {.width = 200, .height = 200, .x = 530, .y = 530};
+    chunk_stream(&chunked, &camera);
+    if (count_resident(&chunked) != 9 * (int)chunked.layer_count) {
+        printf("Expected nine resident chunks per layer, got %d\n", count_resident(&chunked));
+        rc = 1;
+    }
+    camera.x = 0;
+    camera.y = 0;
+    chunked.chunk_radius = 0;
+    chunk_stream(&chunked, &camera);
+    if (count_resident(&chunked) != (int)chunked.layer_count) {
+        printf("Expected one resident chunk per layer, got %d\n", count_resident(&chunked));
+        rc = 1;
+    }
+    if (chunk_find(&chunked.layers[0], 2, 2)->data != NULL) {
+        printf("Chunk outside of the radius was not evicted\n");
+        rc = 1;
+    }
+
+    map_free(&source);
+    map_free(&chunked);
+    return rc;
+}
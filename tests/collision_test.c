@@ -0,0 +1,88 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "assets.h"
+#include "atlas.h"
+#include "map.h"
+#include "render_queue.h"
+#include "tileset_cache.h"
+
+// The cell by cell check the grid replaces, leftmost column first
+static bool collision_test_cells(Map * map, SDL_Rect * box, SDL_Rect * intersection) {
+    for (int col = box->x / map->tilewidth; col <= (box->x + box->w) / map->tilewidth; col++) {
+        for (int row = box->y / map->tileheight; row <= (box->y + box->h) / map->tileheight; row++) {
+            if (map_check_tile_collision(map, col, row, box, intersection)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int main() {
+    int rc = 0;
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    App app = {.renderer = SDL_CreateSoftwareRenderer(surface)};
+    if (app.renderer == NULL) {
+        printf("Failed to create renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+    // Tileset images are found through assets.json, the test runs in the assets directory
+    if (asset_init() != 0) {
+        return 1;
+    }
+    tileset_cache_init(&app);
+    Map map = {0};
+    map_init(&map, "../assets/home.tmj");
+    if (map.collision == NULL) {
+        printf("No collision grid was built\n");
+        rc = 1;
+    }
+
+    // Every box collides with the same cell as the tiles it covers
+    int solid = 0;
+    SDL_Rect sizes[] = {{0, 0, 20, 12}, {0, 0, 32, 32}, {0, 0, 100, 70}};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && rc == 0; i++) {
+        for (int y = 0; y + sizes[i].h < map.bounds.h && rc == 0; y += 7) {
+            for (int x = 0; x + sizes[i].w < map.bounds.w; x += 5) {
+                SDL_Rect box = {x, y, sizes[i].w, sizes[i].h};
+                SDL_Rect expected = {0};
+                SDL_Rect found = {0};
+                bool cells = collision_test_cells(&map, &box, &expected);
+                bool grid = map_check_box_collision(&map, MAP_COLLISION_BIT(MAP_COLLISION_SOLID), &box, &found);
+                if (cells != grid || (cells && !SDL_RectEquals(&expected, &found))) {
+                    printf("Box %d,%d %dx%d collides differently\n", box.x, box.y, box.w, box.h);
+                    rc = 1;
+                    break;
+                }
+                solid += grid;
+            }
+        }
+    }
+    if (solid == 0) {
+        printf("Nothing on the map is solid\n");
+        rc = 1;
+    }
+
+    // Boxes outside of the map and channels without tiles never collide
+    SDL_Rect outside = {-500, -500, 100, 100};
+    SDL_Rect everything = map.bounds;
+    SDL_Rect intersection;
+    if (map_check_box_collision(&map, MAP_COLLISION_BIT(MAP_COLLISION_SOLID), &outside, &intersection) ||
+        map_check_box_collision(&map, MAP_COLLISION_BIT(MAP_COLLISION_WATER), &everything, &intersection)) {
+        printf("Collision outside of the solid tiles\n");
+        rc = 1;
+    }
+
+    map_free(&map);
+    if (map.collision != NULL || map_check_box_collision(&map, MAP_COLLISION_BIT(MAP_COLLISION_SOLID), &everything, &intersection)) {
+        printf("Collision grid outlived the tilesets\n");
+        rc = 1;
+    }
+    render_queue_free();
+    tileset_cache_quit();
+    atlas_quit();
+    asset_free();
+    SDL_DestroyRenderer(app.renderer);
+    SDL_FreeSurface(surface);
+    return rc;
+}
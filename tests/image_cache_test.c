@@ -0,0 +1,87 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "image_cache.h"
+
+// Update until the image is resident or failed, decoding happens on the worker thread
+static bool image_cache_test_wait(App * app, TileImage * image) {
+    SDL_Rect src;
+    for (int i = 0; i < 500 && image->texture == NULL && !image->failed; i++) {
+        SDL_Delay(10);
+        image_cache_update(app);
+        image_cache_texture(image, &src);
+    }
+    return image->texture != NULL;
+}
+
+int main() {
+    int rc = 0;
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    App app = {.renderer = SDL_CreateSoftwareRenderer(surface)};
+    if (app.renderer == NULL) {
+        printf("Failed to create renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+    TileImage player = {.path = "../assets/player_tiles.png"};
+    TileImage map = {.path = "../assets/map_tiles.png"};
+    TileImage missing = {.path = "../assets/missing.png"};
+    SDL_Rect src;
+
+    // Nothing is drawn before the cache is started
+    if (image_cache_texture(&player, &src) != NULL) {
+        printf("Image was drawn without a cache\n");
+        rc = 1;
+    }
+
+    // Room for one of the images, the 384x32 one takes 49152 bytes and the 256x416 one 425984
+    image_cache_init(&app, 400000);
+
+    // A placeholder is drawn until the image is decoded
+    SDL_Texture * placeholder = image_cache_texture(&player, &src);
+    if (placeholder == NULL || src.w != 1 || src.h != 1) {
+        printf("No placeholder while the image loads\n");
+        rc = 1;
+    }
+    if (!image_cache_test_wait(&app, &player) || image_cache_texture(&player, &src) == placeholder || src.w != 384 || src.h != 32) {
+        printf("Image was not streamed in\n");
+        rc = 1;
+    }
+
+    // Idle frames draw nothing, images the last redraw drew stay even over the budget
+    if (!image_cache_test_wait(&app, &map)) {
+        printf("Second image was not streamed in\n");
+        rc = 1;
+    }
+    for (int i = 0; i < 10; i++) {
+        image_cache_update(&app);
+    }
+    if (player.texture == NULL || map.texture == NULL) {
+        printf("Image was evicted on an idle frame\n");
+        rc = 1;
+    }
+
+    // The image a redraw leaves out is evicted once the budget is exceeded
+    image_cache_redraw();
+    image_cache_texture(&map, &src);
+    image_cache_update(&app);
+    if (player.texture != NULL || map.texture == NULL) {
+        printf("Least recently drawn image was not evicted\n");
+        rc = 1;
+    }
+
+    // Images that fail to load are not drawn and not requested again
+    image_cache_test_wait(&app, &missing);
+    if (!missing.failed || image_cache_texture(&missing, &src) != NULL || missing.job != NULL) {
+        printf("Missing image was drawn\n");
+        rc = 1;
+    }
+
+    // Forgetting an image with a pending decode drops the decoded surface
+    image_cache_texture(&player, &src);
+    image_cache_forget(&player);
+    image_cache_forget(&map);
+    image_cache_quit();
+
+    SDL_DestroyRenderer(app.renderer);
+    SDL_FreeSurface(surface);
+    return rc;
+}
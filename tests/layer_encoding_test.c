@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "map_writer.h"
+
+#define LAYER_ENCODING_TEST_FILE "layer_encoding_test.tmj"
+
+// Write a tile layer as base64 with the compression passed as data
+static void write_encoded_layer(FILE * file, Layer * layer, void * data) {
+    const char * compression = data;
+    fprintf(file, ",\"width\":%d,\"height\":%d", layer->width, layer->height);
+    map_writer_encoding(file, compression);
+    fprintf(file, ",\"data\":");
+    map_writer_data(file, layer->data, (size_t)layer->width * layer->height, compression);
+}
+
+int main() {
+    Map source = {0};
+    if (map_load_tmj(&source, "../assets/home.tmj") != 0) {
+        printf("Failed to load the map\n");
+        return 1;
+    }
+
+    // Encode the csv layers and compare the decoded result
+    int rc = 0;
+    const char * compressions[] = {"", "zlib", "gzip"};
+    for (size_t c = 0; c < sizeof(compressions) / sizeof(compressions[0]); c++) {
+        map_writer_write(LAYER_ENCODING_TEST_FILE, &source, false, write_encoded_layer, (void *)compressions[c]);
+        Map encoded = {0};
+        if (map_load_tmj(&encoded, LAYER_ENCODING_TEST_FILE) != 0) {
+            printf("Failed to load %s layers\n", compressions[c]);
+            return 1;
+        }
+        uint32_t j = 0;
+        for (uint32_t i = 0; i < source.layer_count; i++) {
+            Layer * a = &source.layers[i];
+            if (a->data == NULL) {
+                continue;
+            }
+            Layer * b = &encoded.layers[j++];
+            if (a->width != b->width || a->height != b->height || memcmp(a->data, b->data, a->width * a->height * sizeof(uint32_t)) != 0) {
+                printf("Layer %d with compression '%s' does not match\n", i, compressions[c]);
+                rc = 1;
+            }
+        }
+        map_free(&encoded);
+    }
+    remove(LAYER_ENCODING_TEST_FILE);
+
+    map_free(&source);
+    return rc;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+#include "atlas.h"
+#include "loader.h"
+#include "map_cache.h"
+#include "render_queue.h"
+#include "tileset_cache.h"
+
+#define MAP_CACHE_TEST_HOME "../assets/home.tmj"
+#define MAP_CACHE_TEST_HOUSE "../assets/house.tmj"
+
+// Take a map, giving the loader thread time to finish it
+static bool map_cache_test_wait(const char * filename, Map * map) {
+    for (int i = 0; i < 500; i++) {
+        if (map_cache_take(filename, map)) {
+            return true;
+        }
+        SDL_Delay(10);
+    }
+    return false;
+}
+
+int main() {
+    Map home = {0};
+    Map house = {0};
+    int rc = 0;
+    loader_init();
+
+    // Loading home prefetches the house it warps to
+    map_cache_init(MAP_CACHE_BUDGET);
+    map_cache_load(MAP_CACHE_TEST_HOME, &home);
+    if (!map_cache_test_wait(MAP_CACHE_TEST_HOUSE, &house) || house.width != 40) {
+        printf("Warp target was not prefetched\n");
+        rc = 1;
+    }
+
+    // Maps given back are cached
+    map_cache_put(&home);
+    if (home.layers != NULL || !map_cache_take(MAP_CACHE_TEST_HOME, &home) || home.width != 60) {
+        printf("Home was not cached\n");
+        rc = 1;
+    }
+    map_cache_put(&home);
+    map_cache_put(&house);
+    map_cache_quit();
+
+    // The least recently used map is dropped when the budget is exceeded
+    map_cache_init(1);
+    map_cache_load(MAP_CACHE_TEST_HOUSE, &house);
+    map_cache_load(MAP_CACHE_TEST_HOME, &home);
+    map_cache_put(&house);
+    map_cache_put(&home);
+    if (map_cache_take(MAP_CACHE_TEST_HOUSE, &house) || map_cache_take(MAP_CACHE_TEST_HOME, &home)) {
+        printf("Maps over the budget were kept\n");
+        rc = 1;
+    }
+    map_cache_quit();
+    map_cache_init(MAP_CACHE_BUDGET);
+    map_cache_load(MAP_CACHE_TEST_HOUSE, &house);
+    map_cache_load(MAP_CACHE_TEST_HOME, &home);
+    map_cache_quit();
+    map_cache_init(SDL_max(map_memory_size(&house), map_memory_size(&home)));
+    map_cache_put(&house);
+    map_cache_put(&home);
+    if (map_cache_take(MAP_CACHE_TEST_HOUSE, &house) || !map_cache_take(MAP_CACHE_TEST_HOME, &home)) {
+        printf("Least recently used map was not evicted\n");
+        rc = 1;
+    }
+    map_free(&home);
+    map_cache_quit();
+
+    // Maps given back keep their tilesets and collision grid, taking them again attaches nothing
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    App app = {.renderer = SDL_CreateSoftwareRenderer(surface)};
+    if (app.renderer == NULL || asset_init() != 0) {
+        printf("Failed to create renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+    tileset_cache_init(&app);
+    map_cache_init(MAP_CACHE_BUDGET);
+    map_cache_load(MAP_CACHE_TEST_HOME, &home);
+    map_attach_tilesets(&home);
+    uint16_t * gid_tilesets = home.gid_tilesets;
+    uint64_t * collision = home.collision;
+    map_cache_put(&home);
+    if (!map_cache_take(MAP_CACHE_TEST_HOME, &home) || gid_tilesets == NULL || home.gid_tilesets != gid_tilesets || home.collision != collision) {
+        printf("Cached map lost its tilesets\n");
+        rc = 1;
+    }
+    map_cache_put(&home);
+    map_cache_quit();
+    render_queue_free();
+    tileset_cache_quit();
+    atlas_quit();
+    asset_free();
+    SDL_DestroyRenderer(app.renderer);
+    SDL_FreeSurface(surface);
+
+    loader_quit();
+    return rc;
+}
@@ -14,11 +14,31 @@ int main() {
         return 1;
     }
 
-    // Perform operations on the map
+    // Every tile of a tile layer is in its occupancy index
+    for (uint32_t i = 0; i < map->layer_count && rc == 0; i++) {
+        Layer * layer = &map->layers[i];
+        if (layer->data == NULL) {
+            continue;
+        }
+        bool empty = true;
+        for (int j = 0; j < layer->width * layer->height; j++) {
+            bool occupied = layer->occupancy[(j / layer->width) * layer->occupancy_words + (j % layer->width) / 64] >> (j % layer->width % 64) & 1;
+            if (occupied != (layer->data[j] != 0)) {
+                printf("Layer %d tile %d is not indexed\n", i, j);
+                rc = 1;
+                break;
+            }
+            empty &= !occupied;
+        }
+        if (empty != layer->empty) {
+            printf("Layer %d empty flag does not match\n", i);
+            rc = 1;
+        }
+    }
 
     // Free the map
     map_free(map);
     free(map);
 
-    return 0;
+    return rc;
 }
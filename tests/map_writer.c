@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "map_writer.h"
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void map_writer_base64(FILE * file, const uint8_t * data, size_t size) {
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t block = data[i] << 16;
+        if (i + 1 < size) block |= data[i + 1] << 8;
+        if (i + 2 < size) block |= data[i + 2];
+        fputc(base64_chars[(block >> 18) & 0x3f], file);
+        fputc(base64_chars[(block >> 12) & 0x3f], file);
+        fputc(i + 1 < size ? base64_chars[(block >> 6) & 0x3f] : '=', file);
+        fputc(i + 2 < size ? base64_chars[block & 0x3f] : '=', file);
+    }
+}
+
+// Compress with zlib or gzip framing, returns the compressed size
+static size_t map_writer_compress(const uint8_t * data, size_t size, uint8_t * out, size_t capacity, bool gzip) {
+    z_stream stream = {0};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = out;
+    stream.avail_out = capacity;
+    deflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    deflateEnd(&stream);
+    return written;
+}
+
+/**
+ * @brief Write a map with every tile layer of the source map
+ *
+ * @param filename
+ * @param source Map the size and tile layers are taken from
+ * @param infinite
+ * @param write_layer Writes the data of every tile layer
+ * @param data Passed to write_layer
+ */
+void map_writer_write(const char * filename, Map * source, bool infinite, MapWriterLayer write_layer, void * data) {
+    FILE * file = fopen(filename, "w");
+    fprintf(file, "{\"width\":%d,\"height\":%d,\"tilewidth\":%d,\"tileheight\":%d,\"infinite\":%s,\"layers\":[",
+            source->width, source->height, source->tilewidth, source->tileheight, infinite ? "true" : "false");
+    bool first = true;
+    for (uint32_t i = 0; i < source->layer_count; i++) {
+        Layer * layer = &source->layers[i];
+        if (layer->data == NULL) {
+            continue;
+        }
+        fprintf(file, "%s{\"type\":\"tilelayer\",\"id\":%d,\"name\":\"%s\"", first ? "" : ",", layer->id, atom_name(layer->name));
+        write_layer(file, layer, data);
+        fputc('}', file);
+        first = false;
+    }
+    fprintf(file, "]}");
+    fclose(file);
+}
+
+/**
+ * @brief Write the encoding and compression members of a layer, starting with a comma
+ */
+void map_writer_encoding(FILE * file, const char * compression) {
+    fprintf(file, ",\"encoding\":\"%s\",\"compression\":\"%s\"", compression == NULL ? "csv" : "base64", compression == NULL ? "" : compression);
+}
+
+/**
+ * @brief Write tile data as a csv array or a base64 string
+ */
+void map_writer_data(FILE * file, const uint32_t * gids, size_t count, const char * compression) {
+    size_t size = count * sizeof(uint32_t);
+    if (compression == NULL) {
+        fputc('[', file);
+        for (size_t i = 0; i < count; i++) {
+            fprintf(file, "%s%u", i > 0 ? "," : "", gids[i]);
+        }
+        fputc(']', file);
+        return;
+    }
+    fputc('"', file);
+    if (strcmp(compression, "") == 0) {
+        map_writer_base64(file, (const uint8_t *)gids, size);
+    } else {
+        size_t capacity = compressBound(size) + 32;
+        uint8_t * compressed = malloc(capacity);
+        size_t compressed_size = map_writer_compress((const uint8_t *)gids, size, compressed, capacity, strcmp(compression, "gzip") == 0);
+        map_writer_base64(file, compressed, compressed_size);
+        free(compressed);
+    }
+    fputc('"', file);
+}
@@ -0,0 +1,24 @@
+#ifndef MAP_WRITER_H
+#define MAP_WRITER_H
+
+#include <stdio.h>
+#include "map.h"
+
+/**
+ * Test map writer
+ *
+ * Tests write the tile layers of a loaded map back out as a .tmj file in
+ * another encoding and load it again. The writer writes the map and the
+ * common members of every tile layer, the test writes the rest of the layer.
+ * Compression NULL writes csv data, "" uncompressed base64 and "zlib" or
+ * "gzip" compressed base64.
+ */
+
+// Writes the members of a layer after its type, id and name, starting with a comma
+typedef void (*MapWriterLayer)(FILE *file, Layer *layer, void *data);
+
+void map_writer_write(const char *filename, Map *source, bool infinite, MapWriterLayer write_layer, void *data);
+void map_writer_encoding(FILE *file, const char *compression);
+void map_writer_data(FILE *file, const uint32_t *gids, size_t count, const char *compression);
+
+#endif // MAP_WRITER_H
@@ -0,0 +1,113 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include "draw.h"
+#include "render_queue.h"
+
+int main() {
+    int rc = 0;
+    SDL_Surface * surface = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer * renderer = SDL_CreateSoftwareRenderer(surface);
+    SDL_Texture * tiles = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, 32, 32);
+    SDL_Texture * sprite = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, 32, 32);
+    if (renderer == NULL || tiles == NULL || sprite == NULL) {
+        printf("Failed to create renderer: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Tiles of two layers with a sprite pushed in between are drawn as two batches
+    SDL_Rect src = {0, 0, 16, 16};
+    draw_take_call_count();
+    for (int i = 0; i < 16; i++) {
+        SDL_Rect dest = {(i % 4) * 16, (i / 4) * 16, 16, 16};
+        render_queue_push(tiles, &src, &dest, DRAW_FLIP_NONE, i % 2, dest.y + dest.h);
+        if (i == 8) {
+            render_queue_push(sprite, NULL, &dest, DRAW_FLIP_HORIZONTAL, RENDER_QUEUE_SPRITE_LAYER, dest.y + dest.h);
+        }
+    }
+    render_queue_flush(renderer);
+    if (draw_take_call_count() != 2) {
+        printf("Tiles were not batched by texture\n");
+        rc = 1;
+    }
+
+    // A texture change between layers starts a new batch
+    SDL_Rect dest = {0, 0, 16, 16};
+    render_queue_push(tiles, &src, &dest, DRAW_FLIP_NONE, 0, 16);
+    render_queue_push(sprite, NULL, &dest, DRAW_FLIP_NONE, 1, 16);
+    render_queue_push(tiles, &src, &dest, DRAW_FLIP_NONE, 2, 16);
+    render_queue_flush(renderer);
+    if (draw_take_call_count() != 3) {
+        printf("Layers were not drawn in order\n");
+        rc = 1;
+    }
+
+    // Overlapping quads with different textures are drawn back to front, the lower quad covers the one above it
+    Uint8 red[32 * 32 * 4];
+    Uint8 blue[32 * 32 * 4];
+    for (int i = 0; i < 32 * 32 * 4; i++) {
+        red[i] = i % 4 == 0 || i % 4 == 3 ? 255 : 0;
+        blue[i] = i % 4 >= 2 ? 255 : 0;
+    }
+    SDL_UpdateTexture(tiles, NULL, red, 32 * 4);
+    SDL_UpdateTexture(sprite, NULL, blue, 32 * 4);
+    uint16_t overlapping[] = {1 | RENDER_QUEUE_OVERLAP, RENDER_QUEUE_SPRITE_LAYER};
+    for (size_t i = 0; i < sizeof(overlapping) / sizeof(overlapping[0]); i++) {
+        SDL_Rect front = {0, 8, 16, 16};
+        SDL_Rect back = {0, 0, 16, 16};
+        render_queue_push(tiles, &src, &front, DRAW_FLIP_NONE, overlapping[i], front.y + front.h);
+        render_queue_push(sprite, &src, &back, DRAW_FLIP_NONE, overlapping[i], back.y + back.h);
+        render_queue_flush(renderer);
+        Uint8 pixel[4];
+        SDL_Rect covered = {4, 12, 1, 1};
+        SDL_RenderReadPixels(renderer, &covered, SDL_PIXELFORMAT_RGBA32, pixel, 4);
+        if (SDL_memcmp(pixel, red, 4) != 0) {
+            printf("Overlapping quads of layer %x were drawn in texture order\n", overlapping[i]);
+            rc = 1;
+        }
+    }
+    draw_take_call_count();
+
+    // An empty queue draws nothing
+    render_queue_flush(renderer);
+    if (draw_take_call_count() != 0) {
+        printf("Empty queue was drawn\n");
+        rc = 1;
+    }
+
+    // A diagonal flip swaps x and y, with a horizontal flip on top it turns the tile clockwise
+    Uint8 texels[2 * 2 * 4] = {
+        255, 0, 0, 255,   0, 255, 0, 255,
+        0, 0, 255, 255,   255, 255, 255, 255,
+    };
+    SDL_Texture * corners = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, 2, 2);
+    SDL_UpdateTexture(corners, NULL, texels, 2 * 4);
+    struct {
+        DrawFlip flip;
+        int top_right; // Texel expected in the top right corner
+        int bottom_left;
+    } flips[] = {
+        {DRAW_FLIP_NONE, 1, 2},
+        {DRAW_FLIP_DIAGONAL, 2, 1},
+        {DRAW_FLIP_DIAGONAL | DRAW_FLIP_HORIZONTAL, 0, 3},
+    };
+    for (size_t i = 0; i < sizeof(flips) / sizeof(flips[0]); i++) {
+        SDL_Rect corner_dest = {0, 0, 8, 8};
+        render_queue_draw(renderer, corners, NULL, &corner_dest, flips[i].flip);
+        Uint8 pixels[8 * 8 * 4];
+        SDL_RenderReadPixels(renderer, &corner_dest, SDL_PIXELFORMAT_RGBA32, pixels, 8 * 4);
+        if (SDL_memcmp(&pixels[(1 * 8 + 6) * 4], &texels[flips[i].top_right * 4], 4) != 0 ||
+            SDL_memcmp(&pixels[(6 * 8 + 1) * 4], &texels[flips[i].bottom_left * 4], 4) != 0) {
+            printf("Flip %d was drawn wrong\n", flips[i].flip);
+            rc = 1;
+        }
+    }
+    draw_take_call_count();
+
+    render_queue_free();
+    SDL_DestroyTexture(corners);
+    SDL_DestroyTexture(sprite);
+    SDL_DestroyTexture(tiles);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    return rc;
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include "tileset.h"
+
+#define TILESET_TEST_FILE "tileset_test.tsj"
+
+// An image collection with a tree taller and wider than the 16x16 map grid
+static void write_collection(void) {
+    FILE * file = fopen(TILESET_TEST_FILE, "w");
+    fprintf(file, "{\"name\":\"trees\",\"tilewidth\":32,\"tileheight\":64,\"tilecount\":1,\"columns\":0,\"margin\":0,\"spacing\":0,"
+                  "\"tiles\":[{\"id\":0,\"image\":\"tree.png\",\"imagewidth\":32,\"imageheight\":64}]}");
+    fclose(file);
+}
+
+int main() {
+    int rc = 0;
+    App app = {0};
+    write_collection();
+    Tileset * tileset = tileset_load(&app, TILESET_TEST_FILE);
+    remove(TILESET_TEST_FILE);
+
+    // The tree stands on the bottom left of its cell and reaches into the rows above
+    SDL_Rect expected = {16, -32, 32, 64};
+    TilePlacement placement;
+    if (!tileset_place_tile(tileset, 0, true, 16, 16, 16, &placement) || !SDL_RectEquals(&placement.dest, &expected)) {
+        printf("Tall tile covers %d,%d %dx%d\n", placement.dest.x, placement.dest.y, placement.dest.w, placement.dest.h);
+        rc = 1;
+    }
+
+    // Flipped diagonally it lies on its side, still on the bottom of the cell
+    expected = (SDL_Rect){16, 0, 64, 32};
+    if (!tileset_place_tile(tileset, 1 | FLIPPED_DIAGONALLY_FLAG, false, 16, 16, 16, &placement) || !SDL_RectEquals(&placement.dest, &expected)) {
+        printf("Diagonally flipped tile covers %d,%d %dx%d\n", placement.dest.x, placement.dest.y, placement.dest.w, placement.dest.h);
+        rc = 1;
+    }
+
+    tileset_free(tileset);
+    return rc;
+}
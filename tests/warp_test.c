@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader.h"
+#include "map_cache.h"
+#include "warp.h"
+
+int main() {
+    Map map = {0};
+    struct Entity player = {.x = 10, .y = 20};
+    loader_init();
+    map_cache_init(MAP_CACHE_BUDGET);
+    map_load(&map, "../assets/home.tmj");
+
+    // The current map stays untouched until the warp finishes
+    int rc = 0;
+    warp_start("../assets/house.tmj", 607, 950);
+    warp_start("../assets/home.tmj", 1, 1);
+    if (!warp_pending() || strcmp(map.filename, "../assets/home.tmj") != 0 || player.x != 10) {
+        printf("Warp changed the map before it was loaded\n");
+        rc = 1;
+    }
+    int frames = 0;
+    while (!warp_finish(&map, &player) && frames < 500) {
+        SDL_Delay(10);
+        frames++;
+    }
+    if (warp_pending() || strcmp(map.filename, "../assets/house.tmj") != 0 || map.width != 40 || player.x != 607 || player.y != 950) {
+        printf("Warp did not swap in the destination map\n");
+        rc = 1;
+    }
+
+    // A warp within the map only moves the player
+    Layer * layers = map.layers;
+    warp_start("../assets/house.tmj", 5, 6);
+    if (!warp_finish(&map, &player) || map.layers != layers || player.x != 5 || player.y != 6) {
+        printf("Warp within the map loaded it again\n");
+        rc = 1;
+    }
+
+    // A cancelled warp leaves the map alone
+    warp_start("../assets/home.tmj", 1, 1);
+    warp_cancel();
+    if (warp_pending() || warp_finish(&map, &player) || strcmp(map.filename, "../assets/house.tmj") != 0) {
+        printf("Cancelled warp changed the map\n");
+        rc = 1;
+    }
+
+    map_free(&map);
+    map_cache_quit();
+    loader_quit();
+    return rc;
+}
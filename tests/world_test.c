@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader.h"
+#include "map_cache.h"
+#include "warp.h"
+#include "world.h"
+
+#define WORLD_TEST_HOME "../assets/home.tmj"
+#define WORLD_TEST_HOUSE "../assets/house.tmj"
+
+// Update until no map is loading anymore
+static void world_test_settle(World * world, Camera * camera, struct Entity * player) {
+    for (int i = 0; i < 500; i++) {
+        world_update(world, camera, player);
+        bool loading = false;
+        for (size_t j = 0; j < world->map_count; j++) {
+            loading |= world->maps[j].state == WORLD_MAP_LOADING;
+        }
+        if (!loading) {
+            return;
+        }
+        SDL_Delay(10);
+    }
+}
+
+static WorldMap * world_test_find(World * world, const char * path) {
+    for (size_t i = 0; i < world->map_count; i++) {
+        if (strcmp(world->maps[i].path, path) == 0) {
+            return &world->maps[i];
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    World world = {0};
+    loader_init();
+    map_cache_init(MAP_CACHE_BUDGET);
+    world_load(&world, "../assets/worldofzuul.world", WORLD_TEST_HOME);
+    WorldMap * home = world_test_find(&world, WORLD_TEST_HOME);
+    WorldMap * house = world_test_find(&world, WORLD_TEST_HOUSE);
+    int rc = 0;
+    if (world.map_count != 2 || home == NULL || house == NULL || house->rect.x != 1920) {
+        printf("World maps do not match the world file\n");
+        loader_quit();
+        return 1;
+    }
+
+    // The house is streamed in once the camera gets close
+    struct Entity player = {.x = 100, .y = 100, .width = 32, .height = 32};
+    Camera camera = {.x = 0, .y = 0, .width = 640, .height = 480};
+    world_test_settle(&world, &camera, &player);
+    if (house->state != WORLD_MAP_UNLOADED) {
+        printf("House loaded while it is far away\n");
+        rc = 1;
+    }
+    camera.x = 1200;
+    world_test_settle(&world, &camera, &player);
+    if (house->state != WORLD_MAP_LOADED || house->map.width != 40 || world.current->map.bounds.w != 1920 + 1280) {
+        printf("House was not streamed in\n");
+        rc = 1;
+    }
+
+    // Walking over the border moves the player onto the house
+    player.x = 1910;
+    world_update(&world, &camera, &player);
+    if (world.current != house || player.x != -10 || camera.x != 1200 - 1920) {
+        printf("Player was not handed over to the house\n");
+        rc = 1;
+    }
+
+    // Far away maps are unloaded
+    camera.x = 5000;
+    world_update(&world, &camera, &player);
+    if (home->state != WORLD_MAP_UNLOADED || world.memory_used != house->memory_size) {
+        printf("Home was not unloaded\n");
+        rc = 1;
+    }
+
+    // Maps outside of the view are dropped when the budget is exceeded
+    camera.x = 0;
+    world_test_settle(&world, &camera, &player);
+    world.memory_budget = house->memory_size;
+    world_update(&world, &camera, &player);
+    if (home->state != WORLD_MAP_UNLOADED || world.memory_used > world.memory_budget) {
+        printf("Memory budget was not enforced\n");
+        rc = 1;
+    }
+
+    // A warp into a world map moves it into its slot
+    world.memory_budget = WORLD_MEMORY_BUDGET;
+    map_cache_put(world_get_map(&world));
+    map_init(world_get_map(&world), WORLD_TEST_HOME);
+    player.x = 100;
+    world_update(&world, &camera, &player);
+    if (world.current != home || house->state == WORLD_MAP_LOADED || strcmp(world_get_map(&world)->filename, WORLD_TEST_HOME) != 0) {
+        printf("Warp did not move the map into the world\n");
+        rc = 1;
+    }
+
+    // A warp to a loaded neighbor switches over to it instead of loading a second copy
+    camera.x = 1200;
+    world_test_settle(&world, &camera, &player);
+    Layer * layers = house->map.layers;
+    warp_start(WORLD_TEST_HOUSE, 30, 40);
+    if (!world_warp(&world, &player) || world.current != house || house->map.layers != layers || player.x != 30 || player.y != 40 || warp_pending()) {
+        printf("Warp did not switch to the loaded neighbor\n");
+        rc = 1;
+    }
+    Map copy = {0};
+    for (int i = 0; i < 50 && copy.layers == NULL; i++) {
+        SDL_Delay(10);
+        map_cache_take(WORLD_TEST_HOUSE, &copy);
+    }
+    if (copy.layers != NULL) {
+        printf("Warp loaded a second copy of the neighbor\n");
+        map_free(&copy);
+        rc = 1;
+    }
+
+    world_free(&world);
+    map_cache_quit();
+    loader_quit();
+    return rc;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "zmap.h"
+
+#define ZMAP_TEST_FILE "zmap_test.zmap"
+
+int main() {
+    // Compile the map and load both versions
+    Map source = {0};
+    Map compiled = {0};
+    if (map_load_tmj(&source, "../assets/home.tmj") != 0) {
+        printf("Failed to load the map\n");
+        return 1;
+    }
+    if (zmap_write(&source, ZMAP_TEST_FILE) != 0 || map_load(&compiled, ZMAP_TEST_FILE) != 0) {
+        printf("Failed to compile the map\n");
+        return 1;
+    }
+    remove(ZMAP_TEST_FILE);
+
+    // Compare the maps
+    int rc = 0;
+    if (compiled.mapping == NULL || compiled.width != source.width || compiled.height != source.height || compiled.layer_count != source.layer_count) {
+        printf("Compiled map header does not match\n");
+        rc = 1;
+    }
+    if (source.tileset_count != 2 || compiled.tileset_count != source.tileset_count) {
+        printf("Compiled map tilesets do not match\n");
+        rc = 1;
+    }
+    for (uint32_t i = 0; i < source.tileset_count && rc == 0; i++) {
+        if (compiled.tilesets[i].first_gid != source.tilesets[i].first_gid || strcmp(compiled.tilesets[i].source, source.tilesets[i].source) != 0) {
+            printf("Tileset %d does not match\n", i);
+            rc = 1;
+        }
+    }
+    for (uint32_t i = 0; i < source.layer_count && rc == 0; i++) {
+        Layer * a = &source.layers[i];
+        Layer * b = &compiled.layers[i];
+        if (a->type != b->type || a->name != b->name || a->object_count != b->object_count) {
+            printf("Layer %d does not match\n", i);
+            rc = 1;
+            break;
+        }
+        if (a->data != NULL && (b->data == NULL || memcmp(a->data, b->data, a->width * a->height * sizeof(uint32_t)) != 0)) {
+            printf("Layer %d data does not match\n", i);
+            rc = 1;
+            break;
+        }
+        for (size_t j = 0; j < a->object_count; j++) {
+            Object * oa = &a->objects[j];
+            Object * ob = &b->objects[j];
+            if (oa->x != ob->x || oa->y != ob->y || oa->property_count != ob->property_count || oa->property_mask != ob->property_mask) {
+                printf("Layer %d object %zu does not match\n", i, j);
+                rc = 1;
+                break;
+            }
+            for (size_t k = 0; k < oa->property_count; k++) {
+                if (oa->properties[k].name != ob->properties[k].name || oa->properties[k].type != ob->properties[k].type ||
+                    strcmp(oa->properties[k].string_value, ob->properties[k].string_value) != 0) {
+                    printf("Layer %d object %zu property %zu does not match\n", i, j, k);
+                    rc = 1;
+                }
+            }
+        }
+    }
+
+    map_free(&source);
+    map_free(&compiled);
+    return rc;
+}
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "map.h"
+#include "zmap.h"
+
+// Logging
+#include <log.h>
+
+// Convert a Tiled .tmj map into a compiled .zmap map
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <map.tmj> <map.zmap>\n", argv[0]);
+        return 1;
+    }
+
+    Map map = {0};
+    if (map_load_tmj(&map, argv[1]) != 0) {
+        log_error("Failed to load map %s", argv[1]);
+        return 1;
+    }
+    int rc = zmap_write(&map, argv[2]);
+    map_free(&map);
+    if (rc != 0) {
+        return 1;
+    }
+    log_info("Compiled %s to %s", argv[1], argv[2]);
+    return 0;
+}